@@ -14,6 +14,7 @@
 #include <glib.h>
 
 #include <epan/packet.h>
+#include <wsutil/ws_assert.h>
 
 #include "cfile.h"
 
@@ -23,3 +24,119 @@ cap_file_init(capture_file *cf)
     /* Initialize the capture file struct */
     memset(cf, 0, sizeof(capture_file));
 }
+
+#define CF_READ_AHEAD   64
+
+struct cf_read_ahead {
+    capture_file           *cf;
+    cf_read_ahead_read_func read_func;
+    GThread                *thread;
+    cf_read_ahead_slot_t    slots[CF_READ_AHEAD];
+    GAsyncQueue            *free_slots;
+    GAsyncQueue            *requests;
+    GAsyncQueue            *results;
+    unsigned                pending;        /* Requested but not yet consumed */
+    uint32_t                next_framenum;  /* Next frame to request */
+    uint32_t                last_framenum;
+};
+
+static void *
+cf_read_ahead_worker(void *data)
+{
+    cf_read_ahead_t *reader = (cf_read_ahead_t *)data;
+    cf_read_ahead_slot_t *slot;
+
+    for (;;) {
+        slot = (cf_read_ahead_slot_t *)g_async_queue_pop(reader->requests);
+        if (slot->fdata == NULL)
+            break;
+        wtap_rec_reset(&slot->rec);
+        slot->err_info = NULL;
+        if (reader->read_func != NULL) {
+            slot->ok = reader->read_func(reader->cf, slot->fdata, &slot->rec,
+                    &slot->err, &slot->err_info);
+        } else {
+            slot->ok = wtap_seek_read(reader->cf->provider.wth, slot->fdata->file_off,
+                    &slot->rec, &slot->err, &slot->err_info);
+        }
+        g_async_queue_push(reader->results, slot);
+    }
+    return NULL;
+}
+
+cf_read_ahead_t *
+cf_read_ahead_start(capture_file *cf, uint32_t first_framenum,
+                    uint32_t last_framenum, cf_read_ahead_read_func read_func)
+{
+    cf_read_ahead_t *reader = g_new0(cf_read_ahead_t, 1);
+
+    reader->cf = cf;
+    reader->read_func = read_func;
+    reader->free_slots = g_async_queue_new();
+    reader->requests = g_async_queue_new();
+    reader->results = g_async_queue_new();
+    for (unsigned i = 0; i < CF_READ_AHEAD; i++) {
+        wtap_rec_init(&reader->slots[i].rec, 1514);
+        g_async_queue_push(reader->free_slots, &reader->slots[i]);
+    }
+    reader->next_framenum = first_framenum;
+    reader->last_framenum = last_framenum;
+    reader->thread = g_thread_new("Frame reader", cf_read_ahead_worker, reader);
+    return reader;
+}
+
+/*
+ * Requests frames as long as there are free slots, then returns the
+ * record of the oldest outstanding request.
+ */
+cf_read_ahead_slot_t *
+cf_read_ahead_next(cf_read_ahead_t *reader)
+{
+    cf_read_ahead_slot_t *slot;
+
+    while (reader->next_framenum <= reader->last_framenum &&
+            (slot = (cf_read_ahead_slot_t *)g_async_queue_try_pop(reader->free_slots)) != NULL) {
+        slot->fdata = frame_data_sequence_find(reader->cf->provider.frames,
+                reader->next_framenum);
+        g_async_queue_push(reader->requests, slot);
+        reader->next_framenum++;
+        reader->pending++;
+    }
+    ws_assert(reader->pending > 0);
+
+    slot = (cf_read_ahead_slot_t *)g_async_queue_pop(reader->results);
+    reader->pending--;
+    return slot;
+}
+
+void
+cf_read_ahead_release(cf_read_ahead_t *reader, cf_read_ahead_slot_t *slot)
+{
+    g_free(slot->err_info);
+    slot->err_info = NULL;
+    g_async_queue_push(reader->free_slots, slot);
+}
+
+void
+cf_read_ahead_finish(cf_read_ahead_t *reader)
+{
+    cf_read_ahead_slot_t stop = { 0 };
+    cf_read_ahead_slot_t *slot;
+
+    /* Wait for the reads that were already requested. */
+    while (reader->pending > 0) {
+        slot = (cf_read_ahead_slot_t *)g_async_queue_pop(reader->results);
+        cf_read_ahead_release(reader, slot);
+        reader->pending--;
+    }
+    g_async_queue_push(reader->requests, &stop);
+    g_thread_join(reader->thread);
+
+    for (unsigned i = 0; i < CF_READ_AHEAD; i++) {
+        wtap_rec_cleanup(&reader->slots[i].rec);
+    }
+    g_async_queue_unref(reader->free_slots);
+    g_async_queue_unref(reader->requests);
+    g_async_queue_unref(reader->results);
+    g_free(reader);
+}
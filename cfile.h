@@ -142,6 +142,35 @@ const uint8_t *cap_file_provider_get_process_uuid(struct packet_provider_data *p
 wtap_block_t cap_file_provider_get_modified_block(struct packet_provider_data *prov, const frame_data *fd);
 void cap_file_provider_set_modified_block(struct packet_provider_data *prov, frame_data *fd, const wtap_block_t new_block);
 
+/*
+ * Reading the records of a range of frames ahead of the caller on a
+ * separate thread, for code that dissects every frame of a capture file
+ * in order, so that reading and decompressing the file overlaps with
+ * dissection.
+ */
+typedef struct {
+    frame_data *fdata;      /* NULL tells the reader thread to exit */
+    wtap_rec    rec;
+    bool        ok;
+    int         err;
+    char       *err_info;
+} cf_read_ahead_slot_t;
+
+typedef struct cf_read_ahead cf_read_ahead_t;
+
+/* Reads the record of a frame; wtap_seek_read() on cf's wiretap handle if NULL. */
+typedef bool (*cf_read_ahead_read_func)(capture_file *cf, const frame_data *fdata,
+                                        wtap_rec *rec, int *err, char **err_info);
+
+/* Start reading the records of frames first_framenum to last_framenum. */
+extern cf_read_ahead_t *cf_read_ahead_start(capture_file *cf, uint32_t first_framenum,
+                                            uint32_t last_framenum, cf_read_ahead_read_func read_func);
+/* Get the next frame's record, in frame order; it must then be released. */
+extern cf_read_ahead_slot_t *cf_read_ahead_next(cf_read_ahead_t *reader);
+extern void cf_read_ahead_release(cf_read_ahead_t *reader, cf_read_ahead_slot_t *slot);
+/* Stop reading, discarding anything read but not consumed, and free the reader. */
+extern void cf_read_ahead_finish(cf_read_ahead_t *reader);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -61,6 +61,14 @@
 #include <sys/un.h>
 #endif
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#ifdef PACKET_FANOUT
+#define HAVE_PACKET_FANOUT
+#endif
+#endif
+
 #include <wsutil/clopts_common.h>
 #include <wsutil/privileges.h>
 
@@ -120,11 +128,14 @@ FILE *debug_log;   /* for logging debug messages to  */
 #include <stdarg.h> /* va_copy */
 #endif
 
-static GAsyncQueue *pcap_queue;
-static int64_t pcap_queue_bytes;
-static int64_t pcap_queue_packets;
+static GMutex pcap_ring_mutex;
+static GCond pcap_ring_cond;    /* signalled when a ring is no longer empty */
+static int pcap_writer_sleeping;
 static int64_t pcap_queue_byte_limit;
 static int64_t pcap_queue_packet_limit;
+#ifdef HAVE_PACKET_FANOUT
+static int32_t fanout_queues;   /* sockets per interface, if more than 1 */
+#endif
 
 static bool capture_child; /* false: standalone call, true: this is an Wireshark capture child */
 static const char *report_capture_filename; /* capture child file name */
@@ -278,6 +289,55 @@ typedef struct _pcapng_pipe_info {
 
 struct _loop_data; /* forward declaration so we can use it in the cap_pipe_dispatch function pointer */
 
+/*
+ * With use_threads, each capture thread hands what it reads to the main
+ * thread, which writes it out, through a ring of its own.  The ring is a
+ * preallocated single-producer, single-consumer byte buffer holding
+ * pcap_ring_entry headers, each followed by its packet data.  The capture
+ * thread publishes what it has added by advancing head once per batch
+ * rather than once per packet, and the writer frees space by advancing
+ * tail once per batch; neither side takes a lock unless the writer has
+ * gone to sleep with every ring empty.  A packet that doesn't fit in the
+ * ring, or would go over the packet or byte limit, is dropped and counted
+ * in queue_dropped.  The ring is sized up to a power of two, so the byte
+ * limit is enforced on its own, counting each packet's header and data
+ * whether or not the data is in the ring.
+ */
+#define PCAP_RING_MIN_SIZE      (64 * 1024)
+#define PCAP_RING_MAX_SIZE      (1024 * 1024 * 1024)
+#define PCAP_RING_DEFAULT_SIZE  (16 * 1024 * 1024)  /* if there's no byte limit */
+#define PCAP_RING_MAX_BYTES     PCAP_RING_MAX_SIZE  /* largest byte limit accepted */
+#define PCAP_RING_BATCH         64                  /* packets per hand-off */
+#define PCAP_RING_WRAP          UINT32_MAX          /* entry length meaning "continue at the start" */
+
+typedef struct _pcap_ring_entry {
+    uint32_t            len;    /**< Length of the packet data, or PCAP_RING_WRAP */
+    union {
+        struct pcap_pkthdr  phdr;
+        pcapng_block_header_t  bh;
+    } u;
+    uint8_t            *ext;    /**< Packet data too big to go in the ring, or NULL */
+} pcap_ring_entry;
+
+#define PCAP_RING_ALIGN(n)      (((n) + 7U) & ~7U)
+#define PCAP_RING_HDR_SIZE      PCAP_RING_ALIGN((unsigned)sizeof(pcap_ring_entry))
+/* What a packet counts against the byte limit */
+#define PCAP_RING_BYTES(len)    (PCAP_RING_HDR_SIZE + PCAP_RING_ALIGN(len))
+
+typedef struct _pcap_ring {
+    uint8_t    *buf;
+    unsigned    size;               /**< Size of buf; a power of 2 */
+    unsigned    head;               /**< Published by the capture thread */
+    unsigned    packets_in;         /**< Published by the capture thread */
+    unsigned    tail;               /**< Published by the writer */
+    unsigned    packets_out;        /**< Published by the writer */
+    unsigned    bytes_out;          /**< Published by the writer */
+    unsigned    head_pending;       /**< Capture thread only: head including unpublished entries */
+    unsigned    packets_pending;    /**< Capture thread only: packets_in including unpublished entries */
+    unsigned    bytes_pending;      /**< Capture thread only: bytes counted against the byte limit */
+    unsigned    tail_seen;          /**< Capture thread only: last value of tail read */
+} pcap_ring_t;
+
 /*
  * A source of packets from which we're capturing.
  */
@@ -285,6 +345,9 @@ typedef struct _capture_src {
     uint32_t                     received;
     uint32_t                     dropped;
     uint32_t                     flushed;
+    uint32_t                     queue_dropped;          /**< Dropped because the ring to the writer was full */
+    struct _capture_src         *fanout_primary;         /**< If another socket of a fanout group, the interface's own capture_src */
+    pcap_ring_t                  ring;                   /**< Packets read by the capture thread, if use_threads */
     pcap_t                      *pcap_h;
 #ifdef MUST_DO_SELECT
     int                          pcap_fd;                /**< pcap file descriptor */
@@ -367,15 +430,6 @@ typedef struct _loop_data {
     int      interval_s;
 } loop_data;
 
-typedef struct _pcap_queue_element {
-    capture_src        *pcap_src;
-    union {
-        struct pcap_pkthdr  phdr;
-        pcapng_block_header_t  bh;
-    } u;
-    uint8_t             *pd;
-} pcap_queue_element;
-
 /*
  * This needs to be static, so that the SIGINT handler can clear the "go"
  * flag and for saved_shb_idb_lock.
@@ -436,7 +490,7 @@ static void capture_loop_get_errmsg(char *errmsg, size_t errmsglen,
 
 static void report_new_capture_file(const char *filename);
 static void report_packet_count(unsigned int packet_count);
-static void report_packet_drops(uint32_t received, uint32_t pcap_drops, uint32_t drops, uint32_t flushed, uint32_t ps_ifdrop, char *name);
+static void report_packet_drops(uint32_t received, uint32_t pcap_drops, uint32_t drops, uint32_t queue_drops, uint32_t flushed, uint32_t ps_ifdrop, char *name);
 static void report_capture_error(const char *error_msg, const char *secondary_error_msg);
 static void report_cfilter_error(capture_options *capture_opts, unsigned i, const char *errmsg);
 
@@ -532,10 +586,15 @@ print_usage(FILE *output)
     fprintf(output, "\n");
 
     fprintf(output, "Miscellaneous:\n");
-    fprintf(output, "  -N <packet_limit>        maximum number of packets buffered within dumpcap\n");
+    fprintf(output, "  -N <packet_limit>        maximum number of packets buffered per interface\n");
     fprintf(output, "  -C <byte_limit>          maximum number of bytes used for buffering packets\n");
-    fprintf(output, "                           within dumpcap\n");
-    fprintf(output, "  -t                       use a separate thread per interface\n");
+    fprintf(output, "                           within dumpcap, per interface (at most 1 GiB)\n");
+    fprintf(output, "  -t                       use a separate thread per interface; without -C or\n");
+    fprintf(output, "                           -N, each buffers up to 1000 packets or 1000000 bytes\n");
+#ifdef HAVE_PACKET_FANOUT
+    fprintf(output, "  --fanout <queues>        spread each interface's packets over this many\n");
+    fprintf(output, "                           sockets, each read by its own thread\n");
+#endif
     fprintf(output, "  -q                       don't report packet capture counts\n");
     fprintf(output, "  -Q                       suppress all non-error status messages to stderr\n");
     fprintf(output, "  --application-flavor <flavor>\n");
@@ -3422,6 +3481,236 @@ capture_loop_init_filter(pcap_t *pcap_h, bool from_cap_pipe,
     return INITFILTER_NO_ERROR;
 }
 
+#ifdef HAVE_PACKET_FANOUT
+/*
+ * With --fanout, each network interface is captured by a group of
+ * AF_PACKET sockets across which the kernel spreads the interface's
+ * packets by flow (PACKET_FANOUT), so that each socket's ring can be
+ * read by a thread of its own.  The first socket of the group belongs
+ * to the interface's own capture_src; each of the others gets a
+ * capture_src that is added to the end of ld->pcaps, shares the
+ * interface's IDB and points back to the first with fanout_primary.
+ */
+static bool
+capture_loop_join_fanout(capture_src *pcap_src, unsigned *group_id,
+                         const char *name, char *errmsg, size_t errmsg_len)
+{
+    int fd = pcap_fileno(pcap_src->pcap_h);
+    int arg = (int)(*group_id | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16));
+    socklen_t len = sizeof arg;
+
+#ifdef PACKET_FANOUT_FLAG_UNIQUEID
+    /* Have the kernel allocate an ID no other group uses for the first
+       socket, and read it back for the others. */
+    if (*group_id == 0) {
+        arg |= PACKET_FANOUT_FLAG_UNIQUEID << 16;
+    }
+#endif
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof arg) < 0) {
+        snprintf(errmsg, errmsg_len,
+                 "Can't add a socket for %s to a fanout group (%s).",
+                 name, g_strerror(errno));
+        return false;
+    }
+    if (*group_id == 0) {
+        if (getsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, &len) < 0) {
+            snprintf(errmsg, errmsg_len,
+                     "Can't get the fanout group of %s (%s).",
+                     name, g_strerror(errno));
+            return false;
+        }
+        *group_id = (unsigned)arg & 0xffff;
+    }
+    return true;
+}
+
+static void
+capture_loop_discard_packet_cb(u_char *user _U_, const struct pcap_pkthdr *phdr _U_,
+                               const u_char *pd _U_)
+{
+}
+
+/*
+ * Until a socket joins its interface's fanout group, it gets a copy of
+ * every packet on the interface, as does the first socket of the group;
+ * throw away what it has queued by the time it has joined, so that
+ * those packets aren't captured twice.
+ */
+static bool
+capture_loop_drain_fanout(capture_src *pcap_src, const char *name,
+                          char *errmsg, size_t errmsg_len)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    int inpkts;
+
+    if (pcap_setnonblock(pcap_src->pcap_h, 1, errbuf) == -1) {
+        snprintf(errmsg, errmsg_len,
+                 "Can't set a fanout socket for %s to non-blocking mode (%s).",
+                 name, errbuf);
+        return false;
+    }
+    do {
+        inpkts = pcap_dispatch(pcap_src->pcap_h, -1, capture_loop_discard_packet_cb, NULL);
+    } while (inpkts > 0);
+    if (inpkts == -1) {
+        snprintf(errmsg, errmsg_len,
+                 "Can't read from a fanout socket for %s (%s).",
+                 name, pcap_geterr(pcap_src->pcap_h));
+        return false;
+    }
+    if (pcap_setnonblock(pcap_src->pcap_h, 0, errbuf) == -1) {
+        snprintf(errmsg, errmsg_len,
+                 "Can't set a fanout socket for %s to blocking mode (%s).",
+                 name, errbuf);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Only AF_PACKET sockets can be fanned out; libpcap uses other kinds
+ * of socket for, for example, usbmon, nflog, D-Bus and Bluetooth.
+ */
+static bool
+capture_src_is_af_packet(capture_src *pcap_src)
+{
+    int domain;
+    socklen_t len = sizeof domain;
+
+    if (getsockopt(pcap_fileno(pcap_src->pcap_h), SOL_SOCKET, SO_DOMAIN,
+                   &domain, &len) < 0) {
+        return false;
+    }
+    return domain == AF_PACKET;
+}
+
+static bool
+capture_loop_open_fanout(capture_options *capture_opts, loop_data *ld,
+                         char *errmsg, size_t errmsg_len,
+                         char *secondary_errmsg, size_t secondary_errmsg_len)
+{
+    cap_device_open_status open_status;
+    char                open_status_str[PCAP_ERRBUF_SIZE];
+    interface_options  *interface_opts;
+    capture_src        *pcap_src;
+    capture_src        *member;
+    unsigned            group_id;
+    unsigned            i;
+    int32_t             q;
+
+    for (i = 0; i < capture_opts->ifaces->len; i++) {
+        pcap_src = g_array_index(ld->pcaps, capture_src *, i);
+        interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+        if (pcap_src->from_cap_pipe) {
+            continue;
+        }
+
+        if (pcap_src->pcap_h == NULL || !capture_src_is_af_packet(pcap_src)) {
+            ws_warning("%s can't be captured with more than one socket; "
+                       "capturing it with a single socket.",
+                       interface_opts->display_name);
+            continue;
+        }
+
+#ifdef PACKET_FANOUT_FLAG_UNIQUEID
+        group_id = 0;
+#else
+        /* Fanout group IDs are shared by the whole system; pick ones
+           another dumpcap is unlikely to be using. */
+        group_id = ((unsigned)ws_getpid() + i) & 0xffff;
+#endif
+        if (!capture_loop_join_fanout(pcap_src, &group_id, interface_opts->name,
+                                      errmsg, errmsg_len)) {
+            return false;
+        }
+
+        for (q = 1; q < fanout_queues; q++) {
+            member = g_new0(capture_src, 1);
+#ifdef MUST_DO_SELECT
+            member->pcap_fd = -1;
+#endif
+            member->interface_id = pcap_src->interface_id;
+            member->idb_id = pcap_src->idb_id;
+            member->linktype = pcap_src->linktype;
+            member->cap_pipe_fd = -1;
+            member->cap_pipe_err = PIPOK;
+            member->fanout_primary = pcap_src;
+            g_array_append_val(ld->pcaps, member);
+
+            ws_debug("capture_loop_open_fanout : %s socket %d", interface_opts->name, q);
+            member->pcap_h = open_capture_device(capture_opts, interface_opts,
+                CAP_READ_TIMEOUT, &open_status, &open_status_str);
+            if (member->pcap_h == NULL) {
+                get_capture_device_open_failure_messages(open_status,
+                                                         open_status_str,
+                                                         interface_opts->name,
+                                                         errmsg,
+                                                         errmsg_len,
+                                                         secondary_errmsg,
+                                                         secondary_errmsg_len);
+                return false;
+            }
+            member->ts_nsec = have_high_resolution_timestamp(member->pcap_h);
+
+            if (!set_pcap_datalink(member->pcap_h, interface_opts->linktype,
+                                   interface_opts->name,
+                                   errmsg, errmsg_len,
+                                   secondary_errmsg, secondary_errmsg_len)) {
+                return false;
+            }
+            /* The filter already compiled for the first socket, so this can't be a syntax error. */
+            if (capture_loop_init_filter(member->pcap_h, false,
+                                         interface_opts->name,
+                                         interface_opts->cfilter?interface_opts->cfilter:"",
+                                         interface_opts->optimize) != INITFILTER_NO_ERROR) {
+                snprintf(errmsg, errmsg_len, "Can't install filter (%s).",
+                           pcap_geterr(member->pcap_h));
+                snprintf(secondary_errmsg, secondary_errmsg_len, "%s", please_report_bug());
+                return false;
+            }
+#ifdef MUST_DO_SELECT
+            member->pcap_fd = pcap_get_selectable_fd(member->pcap_h);
+#endif
+
+            if (!capture_loop_join_fanout(member, &group_id, interface_opts->name,
+                                          errmsg, errmsg_len) ||
+                !capture_loop_drain_fanout(member, interface_opts->name,
+                                           errmsg, errmsg_len)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+#endif /* HAVE_PACKET_FANOUT */
+
+/*
+ * Get the statistics for a capture device, including those of the other
+ * sockets of its fanout group, if any.
+ */
+static int
+capture_src_stats(capture_src *pcap_src, struct pcap_stat *stats)
+{
+    struct pcap_stat member_stats;
+    capture_src *member;
+    unsigned i;
+
+    if (pcap_stats(pcap_src->pcap_h, stats) < 0) {
+        return -1;
+    }
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        member = g_array_index(global_ld.pcaps, capture_src *, i);
+        if (member->fanout_primary == pcap_src && member->pcap_h != NULL &&
+            pcap_stats(member->pcap_h, &member_stats) >= 0) {
+            stats->ps_recv += member_stats.ps_recv;
+            stats->ps_drop += member_stats.ps_drop;
+            stats->ps_ifdrop += member_stats.ps_ifdrop;
+        }
+    }
+    return 0;
+}
+
 /*
  * Write the dumpcap pcapng SHB and IDBs if needed.
  * Called from capture_loop_init_output and do_file_switch_or_stop.
@@ -3621,13 +3910,13 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
         if (capture_opts->use_pcapng) {
             for (i = 0; i < global_ld.pcaps->len; i++) {
                 pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
-                if (!pcap_src->from_cap_pipe) {
+                if (!pcap_src->from_cap_pipe && pcap_src->fanout_primary == NULL) {
                     uint64_t isb_ifrecv, isb_ifdrop;
                     struct pcap_stat stats;
 
-                    if (pcap_stats(pcap_src->pcap_h, &stats) >= 0) {
+                    if (capture_src_stats(pcap_src, &stats) >= 0) {
                         isb_ifrecv = pcap_src->received;
-                        isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
+                        isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->queue_dropped + pcap_src->flushed;
                    } else {
                         isb_ifrecv = UINT64_MAX;
                         isb_ifdrop = UINT64_MAX;
@@ -4130,6 +4419,103 @@ do_file_switch_or_stop(capture_options *capture_opts)
     return true;
 }
 
+static void
+pcap_ring_init(pcap_ring_t *ring)
+{
+    uint64_t want;
+    unsigned size = PCAP_RING_MIN_SIZE;
+
+    want = pcap_queue_byte_limit > 0 ? (uint64_t)pcap_queue_byte_limit : PCAP_RING_DEFAULT_SIZE;
+    while (size < want && size < PCAP_RING_MAX_SIZE) {
+        size *= 2;
+    }
+    memset(ring, 0, sizeof *ring);
+    ring->buf = (uint8_t *)g_malloc(size);
+    ring->size = size;
+}
+
+static void
+pcap_ring_free(pcap_ring_t *ring)
+{
+    g_free(ring->buf);
+    ring->buf = NULL;
+}
+
+/* Let the writer see what the capture thread has added to the ring */
+static void
+pcap_ring_publish(pcap_ring_t *ring)
+{
+    if (ring->packets_pending == ring->packets_in) {
+        return;
+    }
+    g_atomic_int_set(&ring->head, ring->head_pending);
+    g_atomic_int_set(&ring->packets_in, ring->packets_pending);
+
+    if (g_atomic_int_get(&pcap_writer_sleeping)) {
+        g_mutex_lock(&pcap_ring_mutex);
+        g_cond_signal(&pcap_ring_cond);
+        g_mutex_unlock(&pcap_ring_mutex);
+    }
+}
+
+/* Add a packet to the ring; returns false if there's no room for it */
+static bool
+pcap_ring_put(pcap_ring_t *ring, const void *hdr, size_t hdr_len,
+              const uint8_t *pd, uint32_t len)
+{
+    pcap_ring_entry *entry;
+    unsigned         need, off, skip;
+    bool             in_ring;
+
+    if (pcap_queue_packet_limit > 0 &&
+        ring->packets_pending - g_atomic_int_get(&ring->packets_out) >= (uint64_t)pcap_queue_packet_limit) {
+        return false;
+    }
+    if (pcap_queue_byte_limit > 0 &&
+        (uint64_t)(ring->bytes_pending - g_atomic_int_get(&ring->bytes_out)) + PCAP_RING_BYTES(len) > (uint64_t)pcap_queue_byte_limit) {
+        return false;
+    }
+
+    /* Keep large packets (e.g. from pipes) out of line, so that one of them
+       doesn't take most of the ring. */
+    in_ring = len <= ring->size / 4;
+    need = PCAP_RING_HDR_SIZE + (in_ring ? PCAP_RING_ALIGN(len) : 0);
+
+    /* Entries don't wrap around the end of the buffer. */
+    off = ring->head_pending & (ring->size - 1);
+    skip = ring->size - off < need ? ring->size - off : 0;
+
+    if (ring->head_pending - ring->tail_seen + skip + need > ring->size) {
+        ring->tail_seen = g_atomic_int_get(&ring->tail);
+        if (ring->head_pending - ring->tail_seen + skip + need > ring->size) {
+            return false;
+        }
+    }
+
+    if (skip >= PCAP_RING_HDR_SIZE) {
+        ((pcap_ring_entry *)(void *)(ring->buf + off))->len = PCAP_RING_WRAP;
+    }
+    ring->head_pending += skip;
+    entry = (pcap_ring_entry *)(void *)(ring->buf + (ring->head_pending & (ring->size - 1)));
+    ring->head_pending += need;
+    ring->packets_pending++;
+    ring->bytes_pending += PCAP_RING_BYTES(len);
+
+    entry->len = len;
+    memcpy(&entry->u, hdr, hdr_len);
+    if (in_ring) {
+        entry->ext = NULL;
+        memcpy((uint8_t *)entry + PCAP_RING_HDR_SIZE, pd, len);
+    } else {
+        entry->ext = (uint8_t *)g_memdup2(pd, len);
+    }
+
+    if (ring->packets_pending - ring->packets_in >= PCAP_RING_BATCH) {
+        pcap_ring_publish(ring);
+    }
+    return true;
+}
+
 static void *
 pcap_read_handler(void* arg)
 {
@@ -4142,51 +4528,124 @@ pcap_read_handler(void* arg)
     while (global_ld.go && pcap_src->cap_pipe_err == PIPOK) {
         /* dispatch incoming packets */
         capture_loop_dispatch(&global_ld, errmsg, sizeof(errmsg), pcap_src);
+        pcap_ring_publish(&pcap_src->ring);
     }
+    pcap_ring_publish(&pcap_src->ring);
 
     ws_info("Stopped thread for interface %d.", pcap_src->interface_id);
     g_thread_exit(NULL);
     return (NULL);
 }
 
-/* Try to pop an item off the packet queue and if it exists, write it */
+/* Write out what the capture thread has handed over so far */
 static bool
-capture_loop_dequeue_packet(void) {
-    pcap_queue_element *queue_element;
-
-    g_async_queue_lock(pcap_queue);
-    queue_element = (pcap_queue_element *)g_async_queue_timeout_pop_unlocked(pcap_queue, WRITER_THREAD_TIMEOUT);
-    if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
-            pcap_queue_bytes -= queue_element->u.bh.block_total_length;
+pcap_ring_drain(capture_src *pcap_src)
+{
+    pcap_ring_t *ring = &pcap_src->ring;
+    unsigned     head = g_atomic_int_get(&ring->head);
+    unsigned     tail = ring->tail;
+    unsigned     packets = 0;
+    unsigned     bytes = ring->bytes_out;
+
+    if (tail == head) {
+        return false;
+    }
+
+    while (tail != head) {
+        unsigned         off = tail & (ring->size - 1);
+        pcap_ring_entry *entry;
+        uint8_t         *pd;
+
+        if (ring->size - off < PCAP_RING_HDR_SIZE) {
+            /* No room for an entry before the end; it's at the start. */
+            tail += ring->size - off;
+            continue;
+        }
+        entry = (pcap_ring_entry *)(void *)(ring->buf + off);
+        if (entry->len == PCAP_RING_WRAP) {
+            tail += ring->size - off;
+            continue;
+        }
+
+        if (entry->ext != NULL) {
+            pd = entry->ext;
+            tail += PCAP_RING_HDR_SIZE;
         } else {
-            pcap_queue_bytes -= queue_element->u.phdr.caplen;
+            pd = (uint8_t *)entry + PCAP_RING_HDR_SIZE;
+            tail += PCAP_RING_HDR_SIZE + PCAP_RING_ALIGN(entry->len);
+        }
+        if (pcap_src->from_pcapng) {
+            capture_loop_write_pcapng_cb(pcap_src, &entry->u.bh, pd);
+        } else {
+            capture_loop_write_packet_cb((uint8_t *) pcap_src, &entry->u.phdr, pd);
+        }
+        bytes += PCAP_RING_BYTES(entry->len);
+        g_free(entry->ext);
+
+        /* Give the space back a batch at a time. */
+        if (++packets % PCAP_RING_BATCH == 0) {
+            g_atomic_int_set(&ring->tail, tail);
+            g_atomic_int_set(&ring->packets_out, ring->packets_out + PCAP_RING_BATCH);
+            g_atomic_int_set(&ring->bytes_out, bytes);
         }
-        pcap_queue_packets -= 1;
     }
-    g_async_queue_unlock(pcap_queue);
-    if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
-            ws_info("Dequeued a block of type 0x%08x of length %d captured on interface %d.",
-                  queue_element->u.bh.block_type, queue_element->u.bh.block_total_length,
-                  queue_element->pcap_src->interface_id);
+    g_atomic_int_set(&ring->tail, tail);
+    g_atomic_int_set(&ring->packets_out, ring->packets_out + packets % PCAP_RING_BATCH);
+    g_atomic_int_set(&ring->bytes_out, bytes);
 
-            capture_loop_write_pcapng_cb(queue_element->pcap_src,
-                                        &queue_element->u.bh,
-                                        queue_element->pd);
-        } else {
-            ws_info("Dequeued a packet of length %d captured on interface %d.",
-                queue_element->u.phdr.caplen, queue_element->pcap_src->interface_id);
+    return true;
+}
+
+static bool
+pcap_rings_empty(void)
+{
+    capture_src *pcap_src;
+    unsigned     i;
 
-            capture_loop_write_packet_cb((uint8_t *) queue_element->pcap_src,
-                                        &queue_element->u.phdr,
-                                        queue_element->pd);
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        if (g_atomic_int_get(&pcap_src->ring.head) != pcap_src->ring.tail) {
+            return false;
         }
-        g_free(queue_element->pd);
-        g_free(queue_element);
+    }
+    return true;
+}
+
+/* Write out whatever the capture threads have handed over, waiting for
+   a while if there's nothing yet; returns false if there was nothing. */
+static bool
+capture_loop_dequeue_packets(void) {
+    capture_src *pcap_src;
+    bool         dequeued = false;
+    unsigned     i;
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        dequeued |= pcap_ring_drain(pcap_src);
+    }
+    if (dequeued) {
         return true;
     }
-    return false;
+
+    /*
+     * Every ring is empty.  Say we're going to sleep before checking
+     * again, so that a capture thread that publishes in the meantime
+     * wakes us.
+     */
+    g_mutex_lock(&pcap_ring_mutex);
+    g_atomic_int_set(&pcap_writer_sleeping, 1);
+    if (pcap_rings_empty()) {
+        g_cond_wait_until(&pcap_ring_cond, &pcap_ring_mutex,
+                          g_get_monotonic_time() + WRITER_THREAD_TIMEOUT);
+    }
+    g_atomic_int_set(&pcap_writer_sleeping, 0);
+    g_mutex_unlock(&pcap_ring_mutex);
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        dequeued |= pcap_ring_drain(pcap_src);
+    }
+    return dequeued;
 }
 
 /*
@@ -4302,6 +4761,14 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
         }
     }
 
+#ifdef HAVE_PACKET_FANOUT
+    if (fanout_queues > 1 &&
+        !capture_loop_open_fanout(capture_opts, &global_ld, errmsg, sizeof(errmsg),
+                                  secondary_errmsg, sizeof(secondary_errmsg))) {
+        goto error;
+    }
+#endif
+
     /* If we're supposed to write to a capture file, open it for output
        (temporary/specified name/ringbuffer) */
     if (capture_opts->saving_to_file) {
@@ -4366,11 +4833,9 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
     /* WOW, everything is prepared! */
     /* please fasten your seat belts, we will enter now the actual capture loop */
     if (use_threads) {
-        pcap_queue = g_async_queue_new();
-        pcap_queue_bytes = 0;
-        pcap_queue_packets = 0;
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+            pcap_ring_init(&pcap_src->ring);
             /* XXX - Add an interface name here? */
             pcap_src->tid = g_thread_new("Capture read", pcap_read_handler, pcap_src);
         }
@@ -4378,7 +4843,7 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
     while (global_ld.go) {
         /* dispatch incoming packets */
         if (use_threads) {
-            bool dequeued = capture_loop_dequeue_packet();
+            bool dequeued = capture_loop_dequeue_packets();
 
             if (dequeued) {
                 inpkts = 1;
@@ -4495,7 +4960,7 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
             ws_info("Thread of interface %u terminated.", pcap_src->interface_id);
         }
         while (1) {
-            bool dequeued = capture_loop_dequeue_packet();
+            bool dequeued = capture_loop_dequeue_packets();
             if (!dequeued) {
                 break;
             }
@@ -4503,6 +4968,19 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
                 ws_cwstream_flush(global_ld.pdh, NULL);
             }
         }
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+            pcap_ring_free(&pcap_src->ring);
+
+            /* Count what the other sockets of a fanout group saw
+               against the interface. */
+            if (pcap_src->fanout_primary != NULL) {
+                pcap_src->fanout_primary->received += pcap_src->received;
+                pcap_src->fanout_primary->dropped += pcap_src->dropped;
+                pcap_src->fanout_primary->queue_dropped += pcap_src->queue_dropped;
+                pcap_src->fanout_primary->flushed += pcap_src->flushed;
+            }
+        }
     }
 
 
@@ -4512,8 +4990,10 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
     if (autostop_duration_timer != NULL)
         g_timer_destroy(autostop_duration_timer);
 
-    /* did we have a pcap (input) error? */
-    for (i = 0; i < capture_opts->ifaces->len; i++) {
+    /* did we have a pcap (input) error?  The other sockets of a fanout
+       group follow the interfaces in global_ld.pcaps; an error on one of
+       them is reported against its interface. */
+    for (i = 0; i < global_ld.pcaps->len; i++) {
         pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
         if (pcap_src->pcap_err) {
             /* On Linux, if an interface goes down while you're capturing on it,
@@ -4548,7 +5028,9 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
             char *primary_msg;
             char *secondary_msg;
 
-            interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+            interface_opts = &g_array_index(capture_opts->ifaces, interface_options,
+                                            pcap_src->fanout_primary != NULL ?
+                                            pcap_src->fanout_primary->interface_id : i);
             cap_err_str = pcap_geterr(pcap_src->pcap_h);
             if (strcmp(cap_err_str, "The interface went down") == 0 ||
                 strcmp(cap_err_str, "recvfrom: Network is down") == 0) {
@@ -4685,7 +5167,7 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
         if (pcap_src->pcap_h != NULL) {
             ws_assert(!pcap_src->from_cap_pipe);
             /* Get the capture statistics, so we know how many packets were dropped. */
-            if (pcap_stats(pcap_src->pcap_h, stats) >= 0) {
+            if (capture_src_stats(pcap_src, stats) >= 0) {
                 *stats_known = true;
                 /* Let the parent process know. */
                 pcap_dropped += stats->ps_drop;
@@ -4696,7 +5178,7 @@ capture_loop_start(capture_options *capture_opts, bool *stats_known, struct pcap
                 report_capture_error(errmsg, please_report_bug());
             }
         }
-        report_packet_drops(received, pcap_dropped, pcap_src->dropped, pcap_src->flushed, stats->ps_ifdrop, interface_opts->display_name);
+        report_packet_drops(received, pcap_dropped, pcap_src->dropped, pcap_src->queue_dropped, pcap_src->flushed, stats->ps_ifdrop, interface_opts->display_name);
     }
 
     /* close the input file (pcap or capture pipe) */
@@ -4892,7 +5374,10 @@ capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
                                        bh->block_total_length,
                                        &global_ld.bytes_written, &err);
 
-        ws_cwstream_flush(global_ld.pdh, NULL);
+        /*
+         * Don't flush after every block; as with the pcap callback, the
+         * main loop flushes before telling our parent about new packets.
+         */
         if (!successful) {
             global_ld.go = false;
             global_ld.err = err;
@@ -4905,6 +5390,7 @@ capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
         } else if (bh->block_type == BLOCK_TYPE_SHB && report_capture_filename) {
             ws_debug("Sending SP_FILE on first SHB");
             /* SHB is now ready for capture parent to read on SP_FILE message */
+            ws_cwstream_flush(global_ld.pdh, NULL);
             sync_pipe_write_string_msg(sync_pipe_fd, SP_FILE, report_capture_filename);
             report_capture_filename = NULL;
         }
@@ -4970,8 +5456,6 @@ capture_loop_queue_packet_cb(uint8_t *pcap_src_p, const struct pcap_pkthdr *phdr
                              const uint8_t *pd)
 {
     capture_src        *pcap_src = (capture_src *) (void *) pcap_src_p;
-    pcap_queue_element *queue_element;
-    bool                limit_reached;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
@@ -4981,55 +5465,19 @@ capture_loop_queue_packet_cb(uint8_t *pcap_src_p, const struct pcap_pkthdr *phdr
         return;
     }
 
-    queue_element = g_new(pcap_queue_element, 1);
-    if (queue_element == NULL) {
-       pcap_src->dropped++;
-       return;
-    }
-    queue_element->pcap_src = pcap_src;
-    queue_element->u.phdr = *phdr;
-    queue_element->pd = (uint8_t *)g_malloc(phdr->caplen);
-    if (queue_element->pd == NULL) {
-        pcap_src->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, phdr->caplen);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = false;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += phdr->caplen;
-        pcap_queue_packets += 1;
+    if (pcap_ring_put(&pcap_src->ring, phdr, sizeof *phdr, pd, phdr->caplen)) {
+        pcap_src->received++;
     } else {
-        limit_reached = true;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
-        pcap_src->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
+        pcap_src->queue_dropped++;
         ws_info("Dropped a packet of length %d captured on interface %u.",
               phdr->caplen, pcap_src->interface_id);
-    } else {
-        pcap_src->received++;
-        ws_info("Queued a packet of length %d captured on interface %u.",
-              phdr->caplen, pcap_src->interface_id);
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
-    ws_info("Queue size is now %" PRId64 " bytes (%" PRId64 " packets)",
-          pcap_queue_bytes, pcap_queue_packets);
 }
 
 /* one pcapng block was captured, queue it */
 static void
 capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, uint8_t *pd)
 {
-    pcap_queue_element *queue_element;
-    bool                limit_reached;
-
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
        supposed to be saving any more packets. */
@@ -5038,46 +5486,13 @@ capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
         return;
     }
 
-    queue_element = g_new(pcap_queue_element, 1);
-    if (queue_element == NULL) {
-       pcap_src->dropped++;
-       return;
-    }
-    queue_element->pcap_src = pcap_src;
-    queue_element->u.bh = *bh;
-    queue_element->pd = (uint8_t *)g_malloc(bh->block_total_length);
-    if (queue_element->pd == NULL) {
-        pcap_src->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, bh->block_total_length);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = false;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += bh->block_total_length;
-        pcap_queue_packets += 1;
-    } else {
-        limit_reached = true;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
-        pcap_src->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
-        ws_info("Dropped a packet of length %d captured on interface %u.",
-              bh->block_total_length, pcap_src->interface_id);
-    } else {
+    if (pcap_ring_put(&pcap_src->ring, bh, sizeof *bh, pd, bh->block_total_length)) {
         pcap_src->received++;
-        ws_info("Queued a block of type 0x%08x of length %d captured on interface %u.",
+    } else {
+        pcap_src->queue_dropped++;
+        ws_info("Dropped a block of type 0x%08x of length %d captured on interface %u.",
               bh->block_type, bh->block_total_length, pcap_src->interface_id);
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
-    ws_info("Queue size is now %" PRId64 " bytes (%" PRId64 " packets)",
-          pcap_queue_bytes, pcap_queue_packets);
 }
 
 static int
@@ -5169,6 +5584,9 @@ gather_dumpcap_runtime_info(feature_list l)
 #ifdef _WIN32
 #define LONGOPT_SIGNAL_PIPE         LONGOPT_BASE_APPLICATION+5
 #endif
+#ifdef HAVE_PACKET_FANOUT
+#define LONGOPT_FANOUT              LONGOPT_BASE_APPLICATION+6
+#endif
 
 /* And now our feature presentation... [ fade to music ] */
 int
@@ -5187,6 +5605,9 @@ main(int argc, char *argv[])
         {"application-flavor", ws_required_argument, NULL, LONGOPT_APPLICATION_FLAVOR},
 #ifdef _WIN32
         {"signal-pipe", ws_required_argument, NULL, LONGOPT_SIGNAL_PIPE},
+#endif
+#ifdef HAVE_PACKET_FANOUT
+        {"fanout", ws_required_argument, NULL, LONGOPT_FANOUT},
 #endif
         {0, 0, 0, 0 }
     };
@@ -5671,6 +6092,14 @@ main(int argc, char *argv[])
             if (!get_positive_int64(ws_optarg, "packet_limit", &pcap_queue_packet_limit))
                 arg_error = true;
             break;
+#ifdef HAVE_PACKET_FANOUT
+        case LONGOPT_FANOUT:
+            if (!get_positive_int(ws_optarg, "number of fanout queues", &fanout_queues))
+                arg_error = true;
+            else if (fanout_queues > 1)
+                use_threads = true;
+            break;
+#endif
         default:
             /* wslog arguments are okay */
             if (ws_log_is_wslog_arg(opt))
@@ -5705,6 +6134,12 @@ main(int argc, char *argv[])
     if ((pcap_queue_byte_limit > 0) || (pcap_queue_packet_limit > 0)) {
         use_threads = true;
     }
+    if (pcap_queue_byte_limit > PCAP_RING_MAX_BYTES) {
+        ws_warning("The byte limit %" PRId64 " is larger than the maximum of %d; "
+                   "using %d bytes per interface.",
+                   pcap_queue_byte_limit, PCAP_RING_MAX_BYTES, PCAP_RING_MAX_BYTES);
+        pcap_queue_byte_limit = PCAP_RING_MAX_BYTES;
+    }
     if ((pcap_queue_byte_limit == 0) && (pcap_queue_packet_limit == 0)) {
         /* Use some default if the user hasn't specified some */
         /* XXX: Are these defaults good enough? */
@@ -6267,22 +6702,22 @@ report_capture_error(const char *error_msg, const char *secondary_error_msg)
 }
 
 static void
-report_packet_drops(uint32_t received, uint32_t pcap_drops, uint32_t drops, uint32_t flushed, uint32_t ps_ifdrop, char *name)
+report_packet_drops(uint32_t received, uint32_t pcap_drops, uint32_t drops, uint32_t queue_drops, uint32_t flushed, uint32_t ps_ifdrop, char *name)
 {
-    uint32_t total_drops = pcap_drops + drops + flushed;
+    uint32_t total_drops = pcap_drops + drops + queue_drops + flushed;
 
     if (capture_child) {
         char* tmp = ws_strdup_printf("%u:%s", total_drops, name);
 
-        ws_debug("Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/flushed:%u/ps_ifdrop:%u)",
-            name, received, total_drops, pcap_drops, drops, flushed, ps_ifdrop);
+        ws_debug("Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/queue:%u/flushed:%u/ps_ifdrop:%u)",
+            name, received, total_drops, pcap_drops, drops, queue_drops, flushed, ps_ifdrop);
         sync_pipe_write_string_msg(sync_pipe_fd, SP_DROPS, tmp);
         g_free(tmp);
     } else {
         if (!really_quiet) {
             fprintf(stderr,
-                "Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/flushed:%u/ps_ifdrop:%u) (%.1f%%)\n",
-                name, received, total_drops, pcap_drops, drops, flushed, ps_ifdrop,
+                "Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/queue:%u/flushed:%u/ps_ifdrop:%u) (%.1f%%)\n",
+                name, received, total_drops, pcap_drops, drops, queue_drops, flushed, ps_ifdrop,
                 received ? 100.0 * received / (received + total_drops) : 0.0);
             /* stderr could be line buffered */
             fflush(stderr);
@@ -29,6 +29,10 @@
 #include <glib.h>
 #include <gcrypt.h>
 
+#ifdef HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -87,20 +91,40 @@ struct select_item {
 
 /*
  * Duplicate frame detection
+ *
+ * The digests of the frames in the duplicate window are kept in fd_hash[],
+ * used as a ring, and indexed by their digest in dup_index[], an open
+ * addressing hash table of fd_hash[] slot numbers, so that looking for a
+ * duplicate doesn't mean comparing against every frame in the window.
  */
 typedef struct _fd_hash_t {
     uint8_t    digest[16];
     uint32_t   len;
     nstime_t   frame_time;
+    bool       indexed;     /* this slot is in dup_index[] */
 } fd_hash_t;
 
 #define DEFAULT_DUP_DEPTH       5   /* Used with -d */
 #define MAX_DUP_DEPTH     1000000   /* the maximum window (and actual size of fd_hash[]) for de-duplication */
 
+/*
+ * The digest doesn't need to be cryptographically strong, just unlikely to
+ * collide, so use a fast one if we have it.
+ */
+#if defined(HAVE_XXHASH) && XXH_VERSION_NUMBER >= 800
+#define DUP_DIGEST_NAME "XXH3-128"
+#else
+#define DUP_DIGEST_NAME "MD5"
+#endif
+
 static fd_hash_t fd_hash[MAX_DUP_DEPTH];
 static int       dup_window    = DEFAULT_DUP_DEPTH;
 static int       cur_dup_entry;
 
+#define DUP_INDEX_EMPTY -1
+static int32_t  *dup_index;       /* fd_hash[] slot numbers */
+static uint32_t  dup_index_mask;  /* number of dup_index[] buckets - 1 */
+
 static uint32_t  ignored_bytes;  /* Used with -I */
 
 #define ONE_BILLION 1000000000
@@ -666,11 +690,108 @@ set_unused_info(wtap_rec *rec) {
     }
 }
 
+static void
+dup_digest(uint8_t *digest, const uint8_t *data, uint32_t len)
+{
+#if defined(HAVE_XXHASH) && XXH_VERSION_NUMBER >= 800
+    XXH128_canonical_t canonical;
+
+    XXH128_canonicalFromHash(&canonical, XXH3_128bits(data, len));
+    memcpy(digest, canonical.digest, 16);
+#else
+    gcry_md_hash_buffer(GCRY_MD_MD5, digest, data, len);
+#endif
+}
+
+static void
+dup_index_init(void)
+{
+    uint32_t size = 16;
+
+    /* Keep the load factor at or below 1/2. */
+    while (size < 2 * (uint32_t)dup_window)
+        size *= 2;
+    dup_index = g_new(int32_t, size);
+    for (uint32_t i = 0; i < size; i++)
+        dup_index[i] = DUP_INDEX_EMPTY;
+    dup_index_mask = size - 1;
+}
+
+static inline uint32_t
+dup_index_bucket(const uint8_t *digest)
+{
+    uint32_t h;
+
+    /* Digests are uniformly distributed already. */
+    memcpy(&h, digest, sizeof h);
+    return h & dup_index_mask;
+}
+
+static void
+dup_index_insert(int slot)
+{
+    uint32_t pos = dup_index_bucket(fd_hash[slot].digest);
+
+    while (dup_index[pos] != DUP_INDEX_EMPTY)
+        pos = (pos + 1) & dup_index_mask;
+    dup_index[pos] = slot;
+    fd_hash[slot].indexed = true;
+}
+
+static void
+dup_index_remove(int slot)
+{
+    uint32_t pos = dup_index_bucket(fd_hash[slot].digest);
+    uint32_t next, home;
+
+    while (dup_index[pos] != slot) {
+        ws_assert(dup_index[pos] != DUP_INDEX_EMPTY);
+        pos = (pos + 1) & dup_index_mask;
+    }
+    fd_hash[slot].indexed = false;
+
+    /*
+     * Shift later entries of the probe sequence back into the hole,
+     * so that lookups don't need tombstones.
+     */
+    for (next = (pos + 1) & dup_index_mask;
+         dup_index[next] != DUP_INDEX_EMPTY;
+         next = (next + 1) & dup_index_mask) {
+        home = dup_index_bucket(fd_hash[dup_index[next]].digest);
+        /* Leave the entry alone if its home bucket is in (pos, next]. */
+        if (pos <= next ? (pos < home && home <= next) : (pos < home || home <= next))
+            continue;
+        dup_index[pos] = dup_index[next];
+        pos = next;
+    }
+    dup_index[pos] = DUP_INDEX_EMPTY;
+}
+
+/*
+ * Compute the digest of a frame into the next fd_hash[] slot, replacing
+ * the oldest frame in the window.
+ */
+static void
+dup_add_digest(const uint8_t *data, uint32_t digest_len, uint32_t len)
+{
+    cur_dup_entry++;
+    if (cur_dup_entry >= dup_window)
+        cur_dup_entry = 0;
+
+    if (fd_hash[cur_dup_entry].indexed)
+        dup_index_remove(cur_dup_entry);
+
+    dup_digest(fd_hash[cur_dup_entry].digest, data, digest_len);
+    fd_hash[cur_dup_entry].len = len;
+}
+
 static bool
 is_duplicate(wtap_rec *rec) {
     uint8_t* fd = ws_buffer_start_ptr(&rec->data);
     uint32_t len = rec->rec_header.packet_header.caplen;
+    uint32_t pos;
     int i;
+    bool duplicate = false;
     const struct ieee80211_radiotap_header* tap_header;
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
@@ -693,34 +814,31 @@ is_duplicate(wtap_rec *rec) {
     new_fd  = &fd[offset];
     new_len = len - (offset);
 
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
     /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
+    dup_add_digest(new_fd, new_len, len);
 
     /* Look for duplicates */
-    for (i = 0; i < dup_window; i++) {
-        if (i == cur_dup_entry)
-            continue;
-
+    for (pos = dup_index_bucket(fd_hash[cur_dup_entry].digest);
+         (i = dup_index[pos]) != DUP_INDEX_EMPTY;
+         pos = (pos + 1) & dup_index_mask) {
         if (fd_hash[i].len == fd_hash[cur_dup_entry].len
             && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return true;
+            duplicate = true;
+            break;
         }
     }
 
-    return false;
+    dup_index_insert(cur_dup_entry);
+    return duplicate;
 }
 
 static bool
 is_duplicate_rel_time(wtap_rec *rec, const nstime_t *current) {
     uint8_t* fd = ws_buffer_start_ptr(&rec->data);
     uint32_t len = rec->rec_header.packet_header.caplen;
+    uint32_t pos;
     int i;
+    bool duplicate = false;
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
     uint32_t offset = ignored_bytes;
@@ -734,101 +852,46 @@ is_duplicate_rel_time(wtap_rec *rec, const nstime_t *current) {
     new_fd  = &fd[offset];
     new_len = len - (offset);
 
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
     /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
+    dup_add_digest(new_fd, new_len, len);
     fd_hash[cur_dup_entry].frame_time.secs = current->secs;
     fd_hash[cur_dup_entry].frame_time.nsecs = current->nsecs;
 
     /*
-     * Look for relative time related duplicates.
-     * This is hopefully a reasonably efficient mechanism for
-     * finding duplicates by rel time in the fd_hash[] cache.
-     * We check starting from the most recently added hash
-     * entries and work backwards towards older packets.
-     * This approach allows the dup test to be terminated
-     * when the relative time of a cached entry is found to
-     * be beyond the dup time window.
+     * Look for relative time related duplicates: frames in the
+     * window with the same length and digest whose timestamp is
+     * no more than the dup time window before the current one.
      *
-     * Of course this assumes that the input trace file is
-     * "well-formed" in the sense that the packet timestamps are
-     * in strict chronologically increasing order (which is NOT
-     * always the case!!).
-     *
-     * The fd_hash[] table was deliberately created large (1,000,000).
-     * Looking for time related duplicates in large trace files with
-     * non-fractional dup time window values can potentially take
-     * a long time to complete.
+     * A negative delta implies that the current packet has an
+     * absolute timestamp less than the cached packet that it is
+     * being compared to.  This is NOT a normal situation since
+     * trace files usually have packets in chronological order
+     * (oldest to newest), and such packets aren't considered
+     * duplicates.
      */
-
-    for (i = cur_dup_entry - 1;; i--) {
+    for (pos = dup_index_bucket(fd_hash[cur_dup_entry].digest);
+         (i = dup_index[pos]) != DUP_INDEX_EMPTY;
+         pos = (pos + 1) & dup_index_mask) {
         nstime_t delta;
-        int cmp;
-
-        if (i < 0)
-            i = dup_window - 1;
 
-        if (i == cur_dup_entry) {
-            /*
-             * We've decremented back to where we started.
-             * Check no more!
-             */
-            break;
-        }
-
-        if (nstime_is_unset(&(fd_hash[i].frame_time))) {
-            /*
-             * We've decremented to an unused fd_hash[] entry.
-             * Check no more!
-             */
-            break;
+        if (fd_hash[i].len != fd_hash[cur_dup_entry].len
+            || memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) != 0) {
+            continue;
         }
 
         nstime_delta(&delta, current, &fd_hash[i].frame_time);
-
         if (delta.secs < 0 || delta.nsecs < 0) {
-            /*
-             * A negative delta implies that the current packet
-             * has an absolute timestamp less than the cached packet
-             * that it is being compared to.  This is NOT a normal
-             * situation since trace files usually have packets in
-             * chronological order (oldest to newest).
-             *
-             * There are several possible ways to deal with this:
-             * 1. 'continue' dup checking with the next cached frame.
-             * 2. 'break' from looking for a duplicate of the current frame.
-             * 3. Take the absolute value of the delta and see if that
-             * falls within the specified dup time window.
-             *
-             * Currently this code does option 1.  But it would pretty
-             * easy to add yet-another-editcap-option to select one of
-             * the other behaviors for dealing with out-of-sequence
-             * packets.
-             */
             continue;
         }
 
-        cmp = nstime_cmp(&delta, &relative_time_window);
-
-        if (cmp > 0) {
-            /*
-             * The delta time indicates that we are now looking at
-             * cached packets beyond the specified dup time window.
-             * Check no more!
-             */
+        if (nstime_cmp(&delta, &relative_time_window) <= 0) {
+            duplicate = true;
             break;
-        } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-                   && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return true;
         }
     }
 
-    return false;
+    dup_index_insert(cur_dup_entry);
+    return duplicate;
 }
 
 static void
@@ -943,7 +1006,7 @@ print_usage(FILE *output)
     fprintf(output, "  -D <dup window>        remove packet if duplicate; configurable <dup window>.\n");
     fprintf(output, "                         Valid <dup window> values are 0 to %d.\n", MAX_DUP_DEPTH);
     fprintf(output, "                         NOTE: A <dup window> of 0 with -V (verbose option) is\n");
-    fprintf(output, "                         useful to print MD5 hashes.\n");
+    fprintf(output, "                         useful to print packet hashes.\n");
     fprintf(output, "  -w <dup time window>   remove packet if duplicate packet is found EQUAL TO OR\n");
     fprintf(output, "                         LESS THAN <dup time window> prior to current packet.\n");
     fprintf(output, "                         A <dup time window> is specified in relative seconds\n");
@@ -991,7 +1054,7 @@ print_usage(FILE *output)
     fprintf(output, "                         the pseudo-random number generator. This allows one to\n");
     fprintf(output, "                         repeat a particular sequence of errors.\n");
     fprintf(output, "  -I <bytes to ignore>   ignore the specified number of bytes at the beginning\n");
-    fprintf(output, "                         of the frame during MD5 hash calculation, unless the\n");
+    fprintf(output, "                         of the frame during hash calculation, unless the\n");
     fprintf(output, "                         frame is too short, then the full frame is used.\n");
     fprintf(output, "                         Useful to remove duplicated packets taken on\n");
     fprintf(output, "                         several routers (different mac addresses for\n");
@@ -1049,7 +1112,7 @@ print_usage(FILE *output)
     fprintf(output, "  -V                     verbose output.\n");
     fprintf(output, "                         If -V is used with any of the 'Duplicate Packet\n");
     fprintf(output, "                         Removal' options (-d, -D or -w) then Packet lengths\n");
-    fprintf(output, "                         and MD5 hashes are printed to standard-error.\n");
+    fprintf(output, "                         and packet hashes are printed to standard-error.\n");
     fprintf(output, "  -v, --version          print version information and exit.\n");
 }
 
@@ -2204,7 +2267,9 @@ main(int argc, char *argv[])
             memset(&fd_hash[i].digest, 0, 16);
             fd_hash[i].len = 0;
             nstime_set_unset(&fd_hash[i].frame_time);
+            fd_hash[i].indexed = false;
         }
+        dup_index_init();
     }
 
     /* Set up an array of all IDBs seen */
@@ -2502,7 +2567,7 @@ main(int argc, char *argv[])
                 if (dup_detect) {
                     if (is_duplicate(&read_rec)) {
                         if (verbose) {
-                            fprintf(stderr, "Skipped: %" PRIu64 ", Len: %u, MD5 Hash: ",
+                            fprintf(stderr, "Skipped: %" PRIu64 ", Len: %u, " DUP_DIGEST_NAME " Hash: ",
                                     count,
                                     read_rec.rec_header.packet_header.caplen);
                             for (i = 0; i < 16; i++)
@@ -2515,7 +2580,7 @@ main(int argc, char *argv[])
                         continue;
                     } else {
                         if (verbose) {
-                            fprintf(stderr, "Packet: %" PRIu64 ", Len: %u, MD5 Hash: ",
+                            fprintf(stderr, "Packet: %" PRIu64 ", Len: %u, " DUP_DIGEST_NAME " Hash: ",
                                     count,
                                     read_rec.rec_header.packet_header.caplen);
                             for (i = 0; i < 16; i++)
@@ -2536,7 +2601,7 @@ main(int argc, char *argv[])
 
                         if (is_duplicate_rel_time(&read_rec, &current)) {
                             if (verbose) {
-                                fprintf(stderr, "Skipped: %" PRIu64 ", Len: %u, MD5 Hash: ",
+                                fprintf(stderr, "Skipped: %" PRIu64 ", Len: %u, " DUP_DIGEST_NAME " Hash: ",
                                         count,
                                         read_rec.rec_header.packet_header.caplen);
                                 for (i = 0; i < 16; i++)
@@ -2549,7 +2614,7 @@ main(int argc, char *argv[])
                             continue;
                         } else {
                             if (verbose) {
-                                fprintf(stderr, "Packet: %" PRIu64 ", Len: %u, MD5 Hash: ",
+                                fprintf(stderr, "Packet: %" PRIu64 ", Len: %u, " DUP_DIGEST_NAME " Hash: ",
                                         count,
                                         read_rec.rec_header.packet_header.caplen);
                                 for (i = 0; i < 16; i++)
@@ -2734,6 +2799,7 @@ clean_exit:
         }
         g_array_free(idbs_seen, TRUE);
     }
+    g_free(dup_index);
     g_free(params.idb_inf);
     wtap_dump_params_cleanup(&params);
     if (wth != NULL)
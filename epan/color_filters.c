@@ -59,6 +59,13 @@ static GSList *color_filter_list;
 static GSList *color_filter_deleted_list;
 static GSList *color_filter_valid_list;
 
+/* The enabled filters of color_filter_list, applied together so that
+ * they share the fields they read, and the color filter for each index
+ * of the set; rebuilt when the list or its filters change. */
+static dfilter_set_t *color_filter_set;
+static GPtrArray *color_filter_set_colorfs;
+static bool color_filter_set_stale = true;
+
 /* Color Filters can en-/disabled. */
 static bool filters_enabled = true;
 
@@ -199,6 +206,7 @@ color_filters_set_tmp(uint8_t filt_nr, const char *filter, bool disabled, char *
                 return false;
             } else {
                 g_free(colorf->filter_text);
+                color_filter_set_stale = true;
                 dfilter_free(colorf->c_colorfilter);
                 colorf->filter_text = g_strdup(tmpfilter);
                 colorf->c_colorfilter = compiled_filter;
@@ -362,6 +370,7 @@ bool
 color_filters_init(char** err_msg, color_filter_add_cb_func add_cb)
 {
     /* delete all currently existing filters */
+    color_filter_set_stale = true;
     color_filter_list_delete(&color_filter_list);
 
     /* now try to construct the filters list */
@@ -375,6 +384,7 @@ color_filters_reload(char** err_msg, color_filter_add_cb_func add_cb)
      * we must keep them until the dissection no longer needs them */
     color_filter_deleted_list = g_slist_concat(color_filter_deleted_list, color_filter_list);
     color_filter_list = NULL;
+    color_filter_set_stale = true;
 
     /* now try to construct the filters list */
     return color_filters_get(err_msg, add_cb);
@@ -385,6 +395,14 @@ color_filters_cleanup(void)
 {
     /* delete the previously deleted filters */
     color_filter_list_delete(&color_filter_deleted_list);
+
+    dfilter_set_free(color_filter_set);
+    color_filter_set = NULL;
+    if (color_filter_set_colorfs != NULL) {
+        g_ptr_array_free(color_filter_set_colorfs, true);
+        color_filter_set_colorfs = NULL;
+    }
+    color_filter_set_stale = true;
 }
 
 typedef struct _color_clone
@@ -473,6 +491,7 @@ color_filters_apply(GSList *tmp_cfl, GSList *edit_cfl, char** err_msg)
      * we must keep them until the dissection no longer needs them */
     color_filter_deleted_list = g_slist_concat(color_filter_deleted_list, color_filter_list);
     color_filter_list = NULL;
+    color_filter_set_stale = true;
 
     /* clone all list entries from tmp/edit to normal list */
     color_filter_list_delete(&color_filter_valid_list);
@@ -576,26 +595,45 @@ color_filters_use_proto(int proto_id)
     return (item != NULL);
 }
 
+/* Rebuild the set of enabled filters from 'color_filter_list'. */
+static void
+color_filters_build_set(void)
+{
+    GSList         *curr;
+    color_filter_t *colorf;
+
+    if (color_filter_set == NULL) {
+        color_filter_set = dfilter_set_new();
+        color_filter_set_colorfs = g_ptr_array_new();
+    } else {
+        dfilter_set_clear(color_filter_set);
+        g_ptr_array_set_size(color_filter_set_colorfs, 0);
+    }
+
+    for (curr = color_filter_list; curr != NULL; curr = g_slist_next(curr)) {
+        colorf = (color_filter_t *)curr->data;
+        if (!colorf->disabled && colorf->c_colorfilter != NULL) {
+            dfilter_set_add(color_filter_set, colorf->c_colorfilter);
+            g_ptr_array_add(color_filter_set_colorfs, colorf);
+        }
+    }
+    color_filter_set_stale = false;
+}
+
 /* * Return the color_t for later use */
 const color_filter_t *
 color_filters_colorize_packet(epan_dissect_t *edt)
 {
-    GSList         *curr;
-    color_filter_t *colorf;
+    int             match;
 
     /* If we have color filters, "search" for the matching one. */
     if ((edt->tree != NULL) && (color_filters_used())) {
-        curr = color_filter_list;
-
-        while(curr != NULL) {
-            colorf = (color_filter_t *)curr->data;
-            if ( (!colorf->disabled) &&
-                 (colorf->c_colorfilter != NULL) &&
-                 dfilter_apply_edt(colorf->c_colorfilter, edt)) {
-                return colorf;
-            }
-            curr = g_slist_next(curr);
-        }
+        if (color_filter_set_stale)
+            color_filters_build_set();
+
+        match = dfilter_set_apply_edt(color_filter_set, edt);
+        if (match >= 0)
+            return (color_filter_t *)g_ptr_array_index(color_filter_set_colorfs, match);
     }
 
     return NULL;
@@ -738,6 +776,7 @@ read_filters_file(const char *path, FILE *f, void *user_data, color_filter_add_c
                 /* internal call */
                 colorf->c_colorfilter = temp_dfilter;
                 *cfl = g_slist_append(*cfl, colorf);
+                color_filter_set_stale = true;
             } else {
                 /* external call */
                 /* just editing, don't need the compiled filter */
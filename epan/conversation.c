@@ -9,6 +9,7 @@
  */
 
 #include "config.h"
+#define WS_LOG_DOMAIN LOG_DOMAIN_EPAN
 
 #include <string.h>
 
@@ -16,6 +17,7 @@
 
 #include <wiretap/wtap.h>
 #include <wsutil/array.h>
+#include <wsutil/wslog.h>
 
 #include <epan/packet.h>
 #include "to_str.h"
@@ -198,6 +200,124 @@ static uint32_t new_index;
  */
 static address null_address_ = ADDRESS_INIT_NONE;
 
+/*
+ * Memo of recent find_conversation() results.
+ *
+ * A single packet typically looks up the same conversation several times
+ * (e.g. IP, TCP and then the application dissector), and each lookup hashes
+ * the whole element list and may probe every wildcard table. We remember the
+ * last few results for the current frame so that repeated lookups are cheap.
+ *
+ * Entries are tagged with the frame number and with conversation_generation,
+ * which is bumped whenever a conversation is added to or removed from a hash
+ * table, so a hit always returns what a full lookup would have.
+ */
+#define CONV_MEMO_SIZE      4   /* must be a power of 2 */
+#define CONV_MEMO_ADDR_LEN  16  /* large enough for an IPv6 address */
+
+typedef struct {
+    uint32_t frame_num;
+    uint32_t generation;
+    conversation_type ctype;
+    uint32_t port_a;
+    uint32_t port_b;
+    unsigned options;
+    int addr_a_type;
+    int addr_a_len;
+    int addr_b_type;
+    int addr_b_len;
+    uint8_t addr_a_data[CONV_MEMO_ADDR_LEN];
+    uint8_t addr_b_data[CONV_MEMO_ADDR_LEN];
+    conversation_t *conversation;
+} conversation_memo_t;
+
+static conversation_memo_t conversation_memo[CONV_MEMO_SIZE];
+
+/* Starts at 1 so that zero-initialized memo entries never match. */
+static uint32_t conversation_generation = 1;
+
+static uint64_t conversation_memo_hits;
+static uint64_t conversation_memo_misses;
+
+static inline unsigned
+conversation_memo_slot(const conversation_type ctype, const uint32_t port_a, const uint32_t port_b,
+        const unsigned options)
+{
+    /* Ports are symmetric so that both directions share a slot. */
+    return (ctype ^ port_a ^ port_b ^ options) & (CONV_MEMO_SIZE - 1);
+}
+
+static inline bool
+conversation_memo_addr_equal(const address *addr, const int type, const int len, const uint8_t *data)
+{
+    return addr->type == type && addr->len == len && (len == 0 || memcmp(addr->data, data, len) == 0);
+}
+
+static conversation_memo_t *
+conversation_memo_lookup(const uint32_t frame_num, const address *addr_a, const address *addr_b,
+        const conversation_type ctype, const uint32_t port_a, const uint32_t port_b, const unsigned options)
+{
+    conversation_memo_t *memo = &conversation_memo[conversation_memo_slot(ctype, port_a, port_b, options)];
+
+    if (memo->generation == conversation_generation &&
+            memo->frame_num == frame_num &&
+            memo->ctype == ctype &&
+            memo->port_a == port_a &&
+            memo->port_b == port_b &&
+            memo->options == options &&
+            conversation_memo_addr_equal(addr_a, memo->addr_a_type, memo->addr_a_len, memo->addr_a_data) &&
+            conversation_memo_addr_equal(addr_b, memo->addr_b_type, memo->addr_b_len, memo->addr_b_data)) {
+        return memo;
+    }
+    return NULL;
+}
+
+static void
+conversation_memo_store(const uint32_t frame_num, const address *addr_a, const address *addr_b,
+        const conversation_type ctype, const uint32_t port_a, const uint32_t port_b, const unsigned options,
+        conversation_t *conversation)
+{
+    conversation_memo_t *memo;
+
+    if (addr_a->len > CONV_MEMO_ADDR_LEN || addr_b->len > CONV_MEMO_ADDR_LEN) {
+        return;
+    }
+
+    memo = &conversation_memo[conversation_memo_slot(ctype, port_a, port_b, options)];
+    memo->frame_num = frame_num;
+    memo->generation = conversation_generation;
+    memo->ctype = ctype;
+    memo->port_a = port_a;
+    memo->port_b = port_b;
+    memo->options = options;
+    memo->addr_a_type = addr_a->type;
+    memo->addr_a_len = addr_a->len;
+    if (addr_a->len > 0) {
+        memcpy(memo->addr_a_data, addr_a->data, addr_a->len);
+    }
+    memo->addr_b_type = addr_b->type;
+    memo->addr_b_len = addr_b->len;
+    if (addr_b->len > 0) {
+        memcpy(memo->addr_b_data, addr_b->data, addr_b->len);
+    }
+    memo->conversation = conversation;
+}
+
+/*
+ * Invalidate every memo entry. Called whenever the contents of a conversation
+ * hash table change.
+ */
+static inline void
+conversation_memo_invalidate(void)
+{
+    conversation_generation++;
+    if (conversation_generation == 0) {
+        /* Wrapped around; make sure stale entries can't match again. */
+        memset(conversation_memo, 0, sizeof(conversation_memo));
+        conversation_generation = 1;
+    }
+}
+
 
 /* Element count including the terminating CE_CONVERSATION_TYPE */
 #define MAX_CONVERSATION_ELEMENTS 8 // Arbitrary.
@@ -589,9 +709,9 @@ conversation_init(void)
         { CE_CONVERSATION_TYPE, .conversation_type_val = CONVERSATION_NONE }
     };
     char *exact_map_key = conversation_element_list_name(wmem_epan_scope(), exact_elements);
-    conversation_hashtable_exact_addr_port = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
-                                                                    conversation_hash_element_list,
-                                                                    conversation_match_element_list);
+    conversation_hashtable_exact_addr_port = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                                         conversation_hash_element_list,
+                                                                         conversation_match_element_list);
     wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), exact_map_key),
                     conversation_hashtable_exact_addr_port);
 
@@ -601,9 +721,9 @@ conversation_init(void)
         { CE_CONVERSATION_TYPE, .conversation_type_val = CONVERSATION_NONE }
     };
     char *addrs_map_key = conversation_element_list_name(wmem_epan_scope(), addrs_elements);
-    conversation_hashtable_exact_addr = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
-                                                                    conversation_hash_element_list,
-                                                                    conversation_match_element_list);
+    conversation_hashtable_exact_addr = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                                         conversation_hash_element_list,
+                                                                         conversation_match_element_list);
     wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), addrs_map_key),
                     conversation_hashtable_exact_addr);
 
@@ -614,9 +734,9 @@ conversation_init(void)
         { CE_CONVERSATION_TYPE, .conversation_type_val = CONVERSATION_NONE }
     };
     char *no_addr2_map_key = conversation_element_list_name(wmem_epan_scope(), no_addr2_elements);
-    conversation_hashtable_no_addr2 = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
-                                                       conversation_hash_element_list,
-                                                       conversation_match_element_list);
+    conversation_hashtable_no_addr2 = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                            conversation_hash_element_list,
+                                                            conversation_match_element_list);
     wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), no_addr2_map_key),
                     conversation_hashtable_no_addr2);
 
@@ -627,9 +747,9 @@ conversation_init(void)
         { CE_CONVERSATION_TYPE, .conversation_type_val = CONVERSATION_NONE }
     };
     char *no_port2_map_key = conversation_element_list_name(wmem_epan_scope(), no_port2_elements);
-    conversation_hashtable_no_port2 = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
-                                                       conversation_hash_element_list,
-                                                       conversation_match_element_list);
+    conversation_hashtable_no_port2 = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                            conversation_hash_element_list,
+                                                            conversation_match_element_list);
     wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), no_port2_map_key),
                     conversation_hashtable_no_port2);
 
@@ -639,9 +759,9 @@ conversation_init(void)
         { CE_CONVERSATION_TYPE, .conversation_type_val = CONVERSATION_NONE }
     };
     char *no_addr2_or_port2_map_key = conversation_element_list_name(wmem_epan_scope(), no_addr2_or_port2_elements);
-    conversation_hashtable_no_addr2_or_port2 = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
-                                                                    conversation_hash_element_list,
-                                                                    conversation_match_element_list);
+    conversation_hashtable_no_addr2_or_port2 = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                                         conversation_hash_element_list,
+                                                                         conversation_match_element_list);
     wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), no_addr2_or_port2_map_key),
                     conversation_hashtable_no_addr2_or_port2);
 
@@ -650,9 +770,9 @@ conversation_init(void)
         { CE_CONVERSATION_TYPE, .conversation_type_val = CONVERSATION_NONE }
     };
     char *id_map_key = conversation_element_list_name(wmem_epan_scope(), id_elements);
-    conversation_hashtable_id = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
-                                                       conversation_hash_element_list,
-                                                       conversation_match_element_list);
+    conversation_hashtable_id = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                            conversation_hash_element_list,
+                                                            conversation_match_element_list);
     wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), id_map_key),
                     conversation_hashtable_id);
 
@@ -787,6 +907,30 @@ conversation_epan_reset(void)
      * Start the conversation indices over at 0.
      */
     new_index = 0;
+
+    /*
+     * The hash tables are emptied along with the file scope; forget
+     * any memoised lookups and start counting again.
+     */
+    if (conversation_memo_hits + conversation_memo_misses > 0) {
+        ws_debug("conversation lookups: %" PRIu64 " memo hits, %" PRIu64 " misses (%.1f%% hit rate)",
+                conversation_memo_hits, conversation_memo_misses,
+                100.0 * (double)conversation_memo_hits / (double)(conversation_memo_hits + conversation_memo_misses));
+    }
+    conversation_memo_invalidate();
+    conversation_memo_hits = 0;
+    conversation_memo_misses = 0;
+}
+
+void
+conversation_get_lookup_stats(uint64_t *hits, uint64_t *misses)
+{
+    if (hits) {
+        *hits = conversation_memo_hits;
+    }
+    if (misses) {
+        *misses = conversation_memo_misses;
+    }
 }
 
 /*
@@ -800,6 +944,8 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
     conversation_t *chain_head, *chain_tail, *cur, *prev;
 
+    conversation_memo_invalidate();
+
     chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
 
     if (NULL==chain_head) {
@@ -857,6 +1003,8 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
     conversation_t *chain_head, *cur, *prev;
 
+    conversation_memo_invalidate();
+
     chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
 
     if (conv == chain_head) {
@@ -915,7 +1063,7 @@ conversation_t *conversation_new_full(const uint32_t setup_frame, conversation_e
     char *el_list_map_key = conversation_element_list_name(wmem_epan_scope(), elements);
     wmem_map_t *el_list_map = (wmem_map_t *) wmem_map_lookup(conversation_hashtable_element_list, el_list_map_key);
     if (!el_list_map) {
-        el_list_map = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_element_list,
+        el_list_map = wmem_map_new_flat_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_element_list,
                 conversation_match_element_list);
         wmem_map_insert(conversation_hashtable_element_list, wmem_strdup(wmem_epan_scope(), el_list_map_key), el_list_map);
     }
@@ -1847,6 +1995,7 @@ find_conversation(const uint32_t frame_num, const address *addr_a, const address
         const uint32_t port_a, const uint32_t port_b, const unsigned options)
 {
     conversation_t *conversation, *other_conv;
+    conversation_memo_t *memo;
 
     if (!addr_a) {
         addr_a = &null_address_;
@@ -1856,12 +2005,24 @@ find_conversation(const uint32_t frame_num, const address *addr_a, const address
         addr_b = &null_address_;
     }
 
-    DINSTR(char *addr_a_str = address_to_str(NULL, addr_a));
-    DINSTR(char *addr_b_str = address_to_str(NULL, addr_b));
     /*
      * Verify that the correct options are used, if any.
      */
     DISSECTOR_ASSERT_HINT((options == 0) || (options & NO_MASK_B), "Use NO_ADDR_B and/or NO_PORT_B as option");
+
+    /*
+     * If we've already done this lookup for this frame, and no
+     * conversations have been added or removed since, reuse the result.
+     */
+    memo = conversation_memo_lookup(frame_num, addr_a, addr_b, ctype, port_a, port_b, options);
+    if (memo != NULL) {
+        conversation_memo_hits++;
+        return memo->conversation;
+    }
+    conversation_memo_misses++;
+
+    DINSTR(char *addr_a_str = address_to_str(NULL, addr_a));
+    DINSTR(char *addr_b_str = address_to_str(NULL, addr_b));
     /*
      * First try an exact match, if we have two addresses and ports.
      */
@@ -2239,6 +2400,7 @@ find_conversation(const uint32_t frame_num, const address *addr_a, const address
     conversation = NULL;
 
 end:
+    conversation_memo_store(frame_num, addr_a, addr_b, ctype, port_a, port_b, options, conversation);
     DINSTR(wmem_free(NULL, addr_a_str));
     DINSTR(wmem_free(NULL, addr_b_str));
     return conversation;
@@ -3372,6 +3534,56 @@ get_conversation_hashtables(void)
     return conversation_hashtable_element_list;
 }
 
+typedef struct {
+    uint32_t oldest_frame;
+    GPtrArray *idle;
+    unsigned evicted;
+} conversation_evict_info_t;
+
+static void
+conversation_collect_idle(void *key _U_, void *value, void *user_data)
+{
+    conversation_evict_info_t *info = (conversation_evict_info_t *)user_data;
+
+    for (conversation_t *conv = (conversation_t *)value; conv != NULL; conv = conv->next) {
+        if (conv->last_frame < info->oldest_frame) {
+            g_ptr_array_add(info->idle, conv);
+        }
+    }
+}
+
+static void
+conversation_evict_idle_from_table(void *key _U_, void *value, void *user_data)
+{
+    wmem_map_t *hashtable = (wmem_map_t *)value;
+    conversation_evict_info_t *info = (conversation_evict_info_t *)user_data;
+
+    g_ptr_array_set_size(info->idle, 0);
+    wmem_map_foreach(hashtable, conversation_collect_idle, info);
+    for (unsigned i = 0; i < info->idle->len; i++) {
+        conversation_remove_from_hashtable(hashtable, (conversation_t *)g_ptr_array_index(info->idle, i));
+    }
+    info->evicted += info->idle->len;
+}
+
+unsigned
+conversation_evict_idle(const uint32_t oldest_frame)
+{
+    conversation_evict_info_t info;
+
+    if (conversation_hashtable_element_list == NULL) {
+        return 0;
+    }
+
+    info.oldest_frame = oldest_frame;
+    info.idle = g_ptr_array_new();
+    info.evicted = 0;
+    wmem_map_foreach(conversation_hashtable_element_list, conversation_evict_idle_from_table, &info);
+    g_ptr_array_free(info.idle, TRUE);
+
+    return info.evicted;
+}
+
 const address*
 conversation_key_addr1(const conversation_element_t *key)
 {
@@ -293,6 +293,15 @@ extern void conversation_init(void);
  */
 extern void conversation_epan_reset(void);
 
+/**
+ * Get the number of find_conversation() calls since the last reset that
+ * were answered from the per-frame lookup memo (hits) and that needed a
+ * full hash table lookup (misses).
+ * @param hits If not NULL, set to the number of memo hits.
+ * @param misses If not NULL, set to the number of memo misses.
+ */
+WS_DLL_PUBLIC void conversation_get_lookup_stats(uint64_t *hits, uint64_t *misses);
+
 /**
  * Create a new conversation identified by a list of elements.
  * @param setup_frame The first frame in the conversation.
@@ -598,6 +607,22 @@ WS_DLL_PUBLIC void conversation_set_addr2(conversation_t *conv, const address *a
  */
 WS_DLL_PUBLIC wmem_map_t *get_conversation_hashtables(void);
 
+/**
+ * @brief Stop tracking conversations that haven't been seen since a given frame.
+ *
+ * Conversations whose last frame is before oldest_frame are removed from the
+ * conversation hash tables, so that later packets with the same addresses and
+ * ports start new conversations. The conversations themselves, and any data
+ * dissectors attached to them, remain allocated until the file scope ends.
+ *
+ * This is only meaningful when packets are dissected once, in order, as
+ * frames before oldest_frame can no longer find their conversations.
+ *
+ * @param oldest_frame The oldest frame number whose conversations are kept.
+ * @return The number of conversations removed.
+ */
+WS_DLL_PUBLIC unsigned conversation_evict_idle(const uint32_t oldest_frame);
+
 /* Temporary function to handle port_type to conversation_type conversion
    For now it's a 1-1 mapping, but the intention is to remove
    many of the port_type instances in favor of conversation_type
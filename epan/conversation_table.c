@@ -21,6 +21,8 @@
 
 #include "stat_tap_ui.h"
 
+#include <wsutil/ws_assert.h>
+
 struct register_ct {
     bool hide_ports;       /* hide TCP / UDP port columns */
     int proto_id;              /* protocol id (0-indexed) */
@@ -663,6 +665,45 @@ add_conversation_table_data(conv_hash_t *ch, const address *src, const address *
     add_conversation_table_data_with_conv_id(ch, src, dst, src_port, dst_port, CONV_ID_UNSET, num_frames, num_bytes, ts, abs_ts, ct_info, ctype);
 }
 
+/*
+ * Look a conversation up in either direction; *is_fwd_direction is set
+ * if it was found with the addresses and ports in the order given.
+ */
+static conv_item_t *
+find_conversation_table_item(conv_hash_t *ch, const address *src, const address *dst,
+        uint32_t src_port, uint32_t dst_port, conv_id_t conv_id, bool *is_fwd_direction)
+{
+    conv_key_t existing_key;
+    void *conversation_idx_hash_val;
+
+    *is_fwd_direction = false;
+    if (ch->conv_array == NULL) {
+        return NULL;
+    }
+
+    /* first, check in the fwd conversations */
+    existing_key.addr1 = *src;
+    existing_key.addr2 = *dst;
+    existing_key.port1 = src_port;
+    existing_key.port2 = dst_port;
+    existing_key.conv_id = conv_id;
+    if (g_hash_table_lookup_extended(ch->hashtable, &existing_key, NULL, &conversation_idx_hash_val)) {
+        /* a conversation was found in this same fwd direction */
+        *is_fwd_direction = true;
+        return &g_array_index(ch->conv_array, conv_item_t, GPOINTER_TO_UINT(conversation_idx_hash_val));
+    }
+
+    /* then, check in the rev conversations if not found in 'fwd' */
+    existing_key.addr1 = *dst;
+    existing_key.addr2 = *src;
+    existing_key.port1 = dst_port;
+    existing_key.port2 = src_port;
+    if (g_hash_table_lookup_extended(ch->hashtable, &existing_key, NULL, &conversation_idx_hash_val)) {
+        return &g_array_index(ch->conv_array, conv_item_t, GPOINTER_TO_UINT(conversation_idx_hash_val));
+    }
+    return NULL;
+}
+
 conv_item_t *
 add_conversation_table_data_with_conv_id(
     conv_hash_t *ch,
@@ -691,31 +732,8 @@ add_conversation_table_data_with_conv_id(
                                               NULL);              /* value_destroy_func */
 
     } else { /* try to find it among the existing known conversations */
-        /* first, check in the fwd conversations */
-        conv_key_t existing_key;
-        void *conversation_idx_hash_val;
-
-        existing_key.addr1 = *src;
-        existing_key.addr2 = *dst;
-        existing_key.port1 = src_port;
-        existing_key.port2 = dst_port;
-        existing_key.conv_id = conv_id;
-        if (g_hash_table_lookup_extended(ch->hashtable, &existing_key, NULL, &conversation_idx_hash_val)) {
-            conv_item = &g_array_index(ch->conv_array, conv_item_t, GPOINTER_TO_UINT(conversation_idx_hash_val));
-        }
-        if (conv_item == NULL) {
-            /* then, check in the rev conversations if not found in 'fwd' */
-            existing_key.addr1 = *dst;
-            existing_key.addr2 = *src;
-            existing_key.port1 = dst_port;
-            existing_key.port2 = src_port;
-            if (g_hash_table_lookup_extended(ch->hashtable, &existing_key, NULL, &conversation_idx_hash_val)) {
-                conv_item = &g_array_index(ch->conv_array, conv_item_t, GPOINTER_TO_UINT(conversation_idx_hash_val));
-            }
-        } else {
-            /* a conversation was found in this same fwd direction */
-            is_fwd_direction = true;
-        }
+        conv_item = find_conversation_table_item(ch, src, dst, src_port, dst_port,
+                conv_id, &is_fwd_direction);
     }
 
     /* if we still don't know what conversation this is it has to be a new one
@@ -1079,6 +1097,131 @@ add_hostlist_table_data(conv_hash_t *ch, const address *addr, uint32_t port, boo
     add_endpoint_table_data(ch, addr, port, sender, num_frames, num_bytes, et_info, etype);
 }
 
+void
+merge_conversation_table_data(conv_hash_t *dst, const conv_hash_t *src)
+{
+    unsigned i;
+
+    if (src->conv_array == NULL) {
+        return;
+    }
+
+    for (i = 0; i < src->conv_array->len; i++) {
+        const conv_item_t *src_item = &g_array_index(src->conv_array, conv_item_t, i);
+        conv_item_t *dst_item;
+        bool is_new, is_fwd_direction;
+
+        /* Look the conversation up, in either direction, the way the
+         * taps do, creating it if dst has not seen it.  Adding it
+         * would also clear an existing item's "filtered" flag, so
+         * only add it if it isn't there. */
+        dst_item = find_conversation_table_item(dst,
+                &src_item->src_address, &src_item->dst_address,
+                src_item->src_port, src_item->dst_port, src_item->conv_id,
+                &is_fwd_direction);
+        is_new = (dst_item == NULL);
+        if (is_new) {
+            dst_item = add_conversation_table_data_with_conv_id(dst,
+                    &src_item->src_address, &src_item->dst_address,
+                    src_item->src_port, src_item->dst_port, src_item->conv_id,
+                    0, 0, NULL, NULL, src_item->dissector_info, src_item->ctype);
+            is_fwd_direction = true;
+        }
+
+        if (is_fwd_direction) {
+            dst_item->tx_frames += src_item->tx_frames;
+            dst_item->tx_bytes += src_item->tx_bytes;
+            dst_item->rx_frames += src_item->rx_frames;
+            dst_item->rx_bytes += src_item->rx_bytes;
+            dst_item->tx_frames_total += src_item->tx_frames_total;
+            dst_item->tx_bytes_total += src_item->tx_bytes_total;
+            dst_item->rx_frames_total += src_item->rx_frames_total;
+            dst_item->rx_bytes_total += src_item->rx_bytes_total;
+        } else {
+            dst_item->tx_frames += src_item->rx_frames;
+            dst_item->tx_bytes += src_item->rx_bytes;
+            dst_item->rx_frames += src_item->tx_frames;
+            dst_item->rx_bytes += src_item->tx_bytes;
+            dst_item->tx_frames_total += src_item->rx_frames_total;
+            dst_item->tx_bytes_total += src_item->rx_bytes_total;
+            dst_item->rx_frames_total += src_item->tx_frames_total;
+            dst_item->rx_bytes_total += src_item->tx_bytes_total;
+        }
+
+        if (is_new) {
+            dst_item->filtered = src_item->filtered;
+            dst_item->ext_tcp = src_item->ext_tcp;
+        } else {
+            dst_item->filtered = dst_item->filtered && src_item->filtered;
+            dst_item->ext_tcp.flows += src_item->ext_tcp.flows;
+        }
+
+        if (!nstime_is_unset(&src_item->start_time)) {
+            if (nstime_is_unset(&dst_item->start_time) ||
+                nstime_cmp(&src_item->start_time, &dst_item->start_time) < 0) {
+                dst_item->start_time = src_item->start_time;
+                dst_item->start_abs_time = src_item->start_abs_time;
+            }
+        }
+        if (!nstime_is_unset(&src_item->stop_time)) {
+            if (nstime_is_unset(&dst_item->stop_time) ||
+                nstime_cmp(&src_item->stop_time, &dst_item->stop_time) > 0) {
+                dst_item->stop_time = src_item->stop_time;
+            }
+        }
+    }
+}
+
+void
+merge_endpoint_table_data(conv_hash_t *dst, const conv_hash_t *src)
+{
+    unsigned i;
+
+    if (src->conv_array == NULL) {
+        return;
+    }
+
+    for (i = 0; i < src->conv_array->len; i++) {
+        const endpoint_item_t *src_item = &g_array_index(src->conv_array, endpoint_item_t, i);
+        endpoint_item_t *dst_item;
+        endpoint_key_t key;
+        void *endpoint_idx_hash_val = NULL;
+        bool is_new;
+
+        /* Look the endpoint up, creating it if dst has not seen it;
+         * as for conversations, adding an existing one would clear
+         * its "filtered" flag. */
+        copy_address_shallow(&key.myaddress, &src_item->myaddress);
+        key.port = src_item->port;
+        is_new = (dst->conv_array == NULL ||
+                  !g_hash_table_lookup_extended(dst->hashtable, &key, NULL, &endpoint_idx_hash_val));
+        if (is_new) {
+            add_endpoint_table_data(dst, &src_item->myaddress, src_item->port, true,
+                    0, 0, src_item->dissector_info, src_item->etype);
+            if (!g_hash_table_lookup_extended(dst->hashtable, &key, NULL, &endpoint_idx_hash_val)) {
+                ws_assert_not_reached();
+            }
+        }
+        dst_item = &g_array_index(dst->conv_array, endpoint_item_t, GPOINTER_TO_UINT(endpoint_idx_hash_val));
+        dst_item->modified = true;
+
+        dst_item->tx_frames += src_item->tx_frames;
+        dst_item->tx_bytes += src_item->tx_bytes;
+        dst_item->rx_frames += src_item->rx_frames;
+        dst_item->rx_bytes += src_item->rx_bytes;
+        dst_item->tx_frames_total += src_item->tx_frames_total;
+        dst_item->tx_bytes_total += src_item->tx_bytes_total;
+        dst_item->rx_frames_total += src_item->rx_frames_total;
+        dst_item->rx_bytes_total += src_item->rx_bytes_total;
+
+        if (is_new) {
+            dst_item->filtered = src_item->filtered;
+        } else {
+            dst_item->filtered = dst_item->filtered && src_item->filtered;
+        }
+    }
+}
+
 /*
  * Editor modelines
  *
@@ -442,6 +442,26 @@ WS_DLL_PUBLIC void add_endpoint_table_data(conv_hash_t *ch, const address *addr,
 WS_DLL_PUBLIC void add_endpoint_table_data_ipv4_subnet(conv_hash_t *ch, const address *addr,
     uint32_t port, bool sender, int num_frames, int num_bytes, et_dissector_info_t *et_info, endpoint_type etype);
 
+/** Merge the contents of one conversation table into another, e.g. when
+ *  separate shards of a capture have been tapped independently.
+ *
+ * Conversations are matched in either direction on the same key the table
+ * uses, including the conversation ID; those that only src has are added
+ * to dst.  Relative times are compared as they are, so both tables must
+ * have been built relative to the same reference time.
+ *
+ * @param dst the table to merge into
+ * @param src the table to merge from; it is not modified
+ */
+WS_DLL_PUBLIC void merge_conversation_table_data(conv_hash_t *dst, const conv_hash_t *src);
+
+/** Merge the contents of one endpoint table into another.
+ *
+ * @param dst the table to merge into
+ * @param src the table to merge from; it is not modified
+ */
+WS_DLL_PUBLIC void merge_endpoint_table_data(conv_hash_t *dst, const conv_hash_t *src);
+
 /* For backwards source and binary compatibility */
 G_DEPRECATED_FOR(add_endpoint_table_data)
 WS_DLL_PUBLIC void add_hostlist_table_data(conv_hash_t *ch, const address *addr,
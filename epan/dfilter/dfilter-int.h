@@ -48,6 +48,9 @@ struct epan_dfilter {
 	GSList		*function_stack;
 	GSList		*set_stack;
 	ftenum_t	 ret_type;
+	/* Field values shared with the other filters of a dfilter_set_t
+	 * while it's being applied, or NULL. */
+	GHashTable	*field_cache;
 };
 
 typedef struct {
@@ -707,6 +707,70 @@ dfilter_apply_full(dfilter_t *df, proto_tree *tree, GPtrArray **fvals)
 	return dfvm_apply_full(df, tree, fvals);
 }
 
+struct epan_dfilter_set {
+	GPtrArray	*filters;
+	/* hfinfo -> GPtrArray of the field's values, for the current packet */
+	GHashTable	*field_cache;
+};
+
+dfilter_set_t *
+dfilter_set_new(void)
+{
+	dfilter_set_t *set;
+
+	set = g_new(dfilter_set_t, 1);
+	set->filters = g_ptr_array_new();
+	set->field_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					NULL, (GDestroyNotify)g_ptr_array_unref);
+	return set;
+}
+
+void
+dfilter_set_free(dfilter_set_t *set)
+{
+	if (!set)
+		return;
+
+	g_ptr_array_free(set->filters, true);
+	g_hash_table_destroy(set->field_cache);
+	g_free(set);
+}
+
+unsigned
+dfilter_set_add(dfilter_set_t *set, dfilter_t *df)
+{
+	g_ptr_array_add(set->filters, df);
+	return set->filters->len - 1;
+}
+
+void
+dfilter_set_clear(dfilter_set_t *set)
+{
+	g_ptr_array_set_size(set->filters, 0);
+}
+
+int
+dfilter_set_apply_edt(dfilter_set_t *set, epan_dissect_t *edt)
+{
+	dfilter_t	*df;
+	bool		passed;
+	int		match = -1;
+
+	for (unsigned i = 0; i < set->filters->len; i++) {
+		df = g_ptr_array_index(set->filters, i);
+		df->field_cache = set->field_cache;
+		passed = dfvm_apply(df, edt->tree);
+		df->field_cache = NULL;
+		if (passed) {
+			match = i;
+			break;
+		}
+	}
+	/* The values belong to this packet's tree. */
+	g_hash_table_remove_all(set->field_cache);
+	return match;
+}
+
 void
 dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree)
 {
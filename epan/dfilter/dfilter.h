@@ -126,6 +126,37 @@ dfilter_apply_edt(dfilter_t *df, struct epan_dissect *edt);
 bool
 dfilter_apply(dfilter_t *df, proto_tree *tree);
 
+/* A list of compiled dfilters that are applied to a packet in turn, such
+ * as coloring rules. Field values read from the tree by one filter are
+ * reused by the following ones instead of being read again. */
+typedef struct epan_dfilter_set dfilter_set_t;
+
+WS_DLL_PUBLIC
+dfilter_set_t *
+dfilter_set_new(void);
+
+/* Frees the set, but not the dfilters in it. */
+WS_DLL_PUBLIC
+void
+dfilter_set_free(dfilter_set_t *set);
+
+/* Appends a dfilter to the set and returns its index. The dfilter is
+ * not copied, and must not be freed while it's in the set. */
+WS_DLL_PUBLIC
+unsigned
+dfilter_set_add(dfilter_set_t *set, dfilter_t *df);
+
+/* Removes all the dfilters from the set. */
+WS_DLL_PUBLIC
+void
+dfilter_set_clear(dfilter_set_t *set);
+
+/* Applies the dfilters of the set in order, and returns the index
+ * of the first one that matches, or -1 if none does. */
+WS_DLL_PUBLIC
+int
+dfilter_set_apply_edt(dfilter_set_t *set, struct epan_dissect *edt);
+
 /* Apply compiled dfilter and return final set of fvalues (if they
  * exist) in addition to true/false determination. */
 bool
@@ -72,10 +72,29 @@ dfvm_opcode_tostr(dfvm_opcode_t code)
 		case DFVM_STACK_POP:		return "STACK_POP";
 		case DFVM_NOT_ALL_ZERO:		return "NOT_ALL_ZERO";
 		case DFVM_NO_OP:		return "NO_OP";
+		case DFVM_FIELD_CMP:		return "FIELD_CMP";
 	}
 	return "(fix-opcode-string)";
 }
 
+static void
+set_free(df_set_t *set)
+{
+	df_set_range_t *r;
+
+	if (set->index)
+		g_hash_table_destroy(set->index);
+	g_ptr_array_free(set->unindexed, true);
+	g_ptr_array_unref(set->elements);
+	for (unsigned i = 0; i < set->ranges->len; i++) {
+		r = &g_array_index(set->ranges, df_set_range_t, i);
+		fvalue_free(r->low);
+		fvalue_free(r->high);
+	}
+	g_array_free(set->ranges, true);
+	g_free(set);
+}
+
 static void
 dfvm_value_free(dfvm_value_t *v)
 {
@@ -89,6 +108,9 @@ dfvm_value_free(dfvm_value_t *v)
 		case PCRE:
 			ws_regex_free(v->value.pcre);
 			break;
+		case FVALUE_SET:
+			set_free(v->value.set);
+			break;
 		case EMPTY:
 		case HFINFO:
 		case RAW_HFINFO:
@@ -243,6 +265,189 @@ dfvm_value_new_uint(unsigned num)
 	return v;
 }
 
+static unsigned
+set_hash(const void *key)
+{
+	return fvalue_hash(key);
+}
+
+static gboolean
+set_equal(const void *a, const void *b)
+{
+	return fvalue_equal(a, b);
+}
+
+/* Values of these types hash consistently with fvalue_eq(). */
+static bool
+set_fvalue_hashable(fvalue_t *fv)
+{
+	ftenum_t ft = fvalue_type_ftenum(fv);
+
+	if (FT_IS_INTEGER(ft) || FT_IS_STRING(ft))
+		return true;
+
+	switch (ft) {
+		case FT_BYTES:
+		case FT_UINT_BYTES:
+		case FT_ETHER:
+		case FT_EUI64:
+		case FT_GUID:
+			return true;
+		case FT_IPv4:
+			/* Comparison applies the smallest netmask of both
+			 * operands, only host addresses can be hashed. */
+			return fvalue_get_ipv4(fv)->nmask == UINT32_MAX;
+		case FT_IPv6:
+			return fvalue_get_ipv6(fv)->prefix == 128;
+		default:
+			break;
+	}
+	return false;
+}
+
+/* Whether a value of type 'a' can be looked up in a set indexed by
+ * type 'b'. Integers of the same signedness share the same hash. */
+static bool
+set_ftype_compatible(ftenum_t a, ftenum_t b)
+{
+	if (a == b)
+		return true;
+	if (FT_IS_UINT(a) && FT_IS_UINT(b))
+		return true;
+	if (FT_IS_INT(a) && FT_IS_INT(b))
+		return true;
+	return false;
+}
+
+static int
+set_range_cmp(const void *a, const void *b)
+{
+	const df_set_range_t *ra = a;
+	const df_set_range_t *rb = b;
+
+	if (fvalue_lt(ra->low, rb->low) == FT_TRUE)
+		return -1;
+	if (fvalue_gt(ra->low, rb->low) == FT_TRUE)
+		return 1;
+	return 0;
+}
+
+/* Sort the ranges by lower bound and record the running maximum of
+ * the upper bounds, so that membership can be decided with a binary
+ * search even if the ranges overlap. Only done for types with a
+ * total order. */
+static void
+set_sort_ranges(df_set_t *set)
+{
+	df_set_range_t *r;
+	fvalue_t *high_max = NULL;
+	ftenum_t ft;
+
+	if (set->ranges->len == 0)
+		return;
+
+	r = &g_array_index(set->ranges, df_set_range_t, 0);
+	ft = fvalue_type_ftenum(r->low);
+	if (!FT_IS_INTEGER(ft) && !FT_IS_TIME(ft))
+		return;
+	for (unsigned i = 0; i < set->ranges->len; i++) {
+		r = &g_array_index(set->ranges, df_set_range_t, i);
+		if (!set_ftype_compatible(fvalue_type_ftenum(r->low), ft) ||
+				!set_ftype_compatible(fvalue_type_ftenum(r->high), ft))
+			return;
+	}
+
+	g_array_sort(set->ranges, set_range_cmp);
+
+	for (unsigned i = 0; i < set->ranges->len; i++) {
+		r = &g_array_index(set->ranges, df_set_range_t, i);
+		if (high_max == NULL || fvalue_gt(r->high, high_max) == FT_TRUE)
+			high_max = r->high;
+		r->high_max = high_max;
+	}
+	set->ranges_sorted = true;
+	set->ranges_ftype = ft;
+}
+
+/* Takes ownership of the fvalues. 'ranges' holds pairs of lower and
+ * upper bounds. */
+dfvm_value_t*
+dfvm_value_new_set(GPtrArray *elements, GPtrArray *ranges)
+{
+	dfvm_value_t *v = dfvm_value_new(FVALUE_SET);
+	df_set_t *set;
+	df_set_range_t r;
+	fvalue_t *fv;
+
+	ws_assert(ranges->len % 2 == 0);
+
+	set = g_new0(df_set_t, 1);
+	set->elements = g_ptr_array_new_full(elements->len, (GDestroyNotify)fvalue_free);
+	set->unindexed = g_ptr_array_new();
+	set->ranges = g_array_sized_new(false, true, sizeof(df_set_range_t), ranges->len / 2);
+
+	for (unsigned i = 0; i < elements->len; i++) {
+		fv = elements->pdata[i];
+		g_ptr_array_add(set->elements, fv);
+		if (set_fvalue_hashable(fv)) {
+			if (set->index == NULL) {
+				set->index = g_hash_table_new(set_hash, set_equal);
+				set->index_ftype = fvalue_type_ftenum(fv);
+			}
+			if (fvalue_type_ftenum(fv) == set->index_ftype) {
+				g_hash_table_add(set->index, fv);
+				continue;
+			}
+		}
+		g_ptr_array_add(set->unindexed, fv);
+	}
+
+	for (unsigned i = 0; i < ranges->len; i += 2) {
+		r.low = ranges->pdata[i];
+		r.high = ranges->pdata[i + 1];
+		r.high_max = NULL;
+		g_array_append_val(set->ranges, r);
+	}
+	set_sort_ranges(set);
+
+	g_ptr_array_free(elements, true);
+	g_ptr_array_free(ranges, true);
+
+	v->value.set = set;
+	return v;
+}
+
+static char *
+set_tostr(df_set_t *set)
+{
+	wmem_strbuf_t *buf;
+	df_set_range_t *r;
+	char *s;
+
+	buf = wmem_strbuf_new(NULL, "{");
+	for (unsigned i = 0; i < set->elements->len; i++) {
+		if (i > 0)
+			wmem_strbuf_append_c(buf, ' ');
+		s = fvalue_to_debug_repr(NULL, set->elements->pdata[i]);
+		wmem_strbuf_append(buf, s);
+		g_free(s);
+	}
+	for (unsigned i = 0; i < set->ranges->len; i++) {
+		r = &g_array_index(set->ranges, df_set_range_t, i);
+		if (i > 0 || set->elements->len > 0)
+			wmem_strbuf_append_c(buf, ' ');
+		s = fvalue_to_debug_repr(NULL, r->low);
+		wmem_strbuf_append(buf, s);
+		g_free(s);
+		wmem_strbuf_append(buf, "..");
+		s = fvalue_to_debug_repr(NULL, r->high);
+		wmem_strbuf_append(buf, s);
+		g_free(s);
+	}
+	wmem_strbuf_append_c(buf, '}');
+	return wmem_strbuf_finalize(buf);
+}
+
 static char *
 dfvm_value_tostr(dfvm_value_t *v)
 {
@@ -270,6 +475,9 @@ dfvm_value_tostr(dfvm_value_t *v)
 		case PCRE:
 			s = ws_strdup(ws_regex_pattern(v->value.pcre));
 			break;
+		case FVALUE_SET:
+			s = set_tostr(v->value.set);
+			break;
 		case REGISTER:
 			s = ws_strdup_printf("R%"PRIu32, v->value.numeric);
 			break;
@@ -552,8 +760,14 @@ append_op_args(wmem_strbuf_t *buf, dfvm_insn_t *insn, GSList **stack_print,
 		case DFVM_SET_ANY_IN:
 		case DFVM_SET_ALL_NOT_IN:
 		case DFVM_SET_ANY_NOT_IN:
-			wmem_strbuf_append_printf(buf, "%s%s",
+			if (arg2) {
+				wmem_strbuf_append_printf(buf, "%s%s in %s",
+						arg1_str, arg1_str_type, arg2_str);
+			}
+			else {
+				wmem_strbuf_append_printf(buf, "%s%s",
 						arg1_str, arg1_str_type);
+			}
 			break;
 
 		case DFVM_SET_ADD:
@@ -625,6 +839,13 @@ append_op_args(wmem_strbuf_t *buf, dfvm_insn_t *insn, GSList **stack_print,
 			}
 			break;
 
+		case DFVM_FIELD_CMP:
+			wmem_strbuf_append_printf(buf, "%s%s %s %s%s",
+						arg1_str, arg1_str_type,
+						dfvm_opcode_tostr(arg3->value.numeric),
+						arg2_str, arg2_str_type);
+			break;
+
 		case DFVM_NOT:
 		case DFVM_SET_CLEAR:
 		case DFVM_NULL:
@@ -917,6 +1138,29 @@ read_tree_finfos(df_cell_t *rp, proto_tree *tree,
 	return true;
 }
 
+/*
+ * Returns the values of a field, as READ_TREE would load them without a
+ * range, from the cache shared by the filters of a dfilter_set_t, reading
+ * them from the tree if no filter in the set has done so yet.
+ */
+static GPtrArray *
+field_cache_lookup(dfilter_t *df, proto_tree *tree, header_field_info *hfinfo)
+{
+	df_cell_t	cell = { NULL };
+	GPtrArray	*values;
+
+	values = g_hash_table_lookup(df->field_cache, hfinfo);
+	if (values != NULL)
+		return values;
+
+	df_cell_init(&cell, false);
+	for (header_field_info *hf = hfinfo; hf != NULL; hf = hf->same_name_next) {
+		read_tree_finfos(&cell, tree, hf, NULL, false, false);
+	}
+	g_hash_table_insert(df->field_cache, hfinfo, cell.array);
+	return cell.array;
+}
+
 /* Reads a field from the proto_tree and loads the fvalues into a register,
  * if that field has not already been read. */
 static bool
@@ -945,6 +1189,12 @@ read_tree(dfilter_t *df, proto_tree *tree,
 		return !df_cell_is_empty(rp);
 	}
 
+	/* Already loaded by another filter in the set? */
+	if (df->field_cache != NULL && !raw && !val_str && range == NULL) {
+		rp->array = g_ptr_array_ref(field_cache_lookup(df, tree, hfinfo));
+		return !df_cell_is_empty(rp);
+	}
+
 	if (raw || val_str) {
 		df_cell_init(rp, true);
 	}
@@ -1067,6 +1317,80 @@ cmp_test_internal(enum match_how how, DFVMCompareFunc match_func,
 	return want_all;
 }
 
+/*
+ * Compares the values of a field in the tree directly with a constant,
+ * without loading them into a register first; see fuse_field_cmp() in
+ * gencode.c. Returns false if the field is not present, like READ_TREE.
+ */
+static bool
+field_cmp(dfilter_t *df, proto_tree *tree, dfvm_value_t *arg1,
+			dfvm_value_t *arg2, dfvm_value_t *arg3)
+{
+	header_field_info *hfinfo = arg1->value.hfinfo;
+	const fvalue_t	*fv2 = dfvm_value_get_fvalue(arg2);
+	DFVMCompareFunc	match_func = NULL;
+	enum match_how	how = MATCH_ANY;
+	GPtrArray	*finfos;
+	GPtrArray	*values;
+	field_info	*finfo;
+	ft_bool_t	have_match;
+	bool		found = false;
+
+	switch (arg3->value.numeric) {
+		case DFVM_ALL_EQ:	match_func = fvalue_eq; how = MATCH_ALL; break;
+		case DFVM_ANY_EQ:	match_func = fvalue_eq; how = MATCH_ANY; break;
+		case DFVM_ALL_NE:	match_func = fvalue_ne; how = MATCH_ALL; break;
+		case DFVM_ANY_NE:	match_func = fvalue_ne; how = MATCH_ANY; break;
+		case DFVM_ALL_GT:	match_func = fvalue_gt; how = MATCH_ALL; break;
+		case DFVM_ANY_GT:	match_func = fvalue_gt; how = MATCH_ANY; break;
+		case DFVM_ALL_GE:	match_func = fvalue_ge; how = MATCH_ALL; break;
+		case DFVM_ANY_GE:	match_func = fvalue_ge; how = MATCH_ANY; break;
+		case DFVM_ALL_LT:	match_func = fvalue_lt; how = MATCH_ALL; break;
+		case DFVM_ANY_LT:	match_func = fvalue_lt; how = MATCH_ANY; break;
+		case DFVM_ALL_LE:	match_func = fvalue_le; how = MATCH_ALL; break;
+		case DFVM_ANY_LE:	match_func = fvalue_le; how = MATCH_ANY; break;
+		case DFVM_ALL_CONTAINS:	match_func = fvalue_contains; how = MATCH_ALL; break;
+		case DFVM_ANY_CONTAINS:	match_func = fvalue_contains; how = MATCH_ANY; break;
+		default:
+			ASSERT_DFVM_OP_NOT_REACHED(arg3->value.numeric);
+	}
+
+	if (df->field_cache != NULL) {
+		values = field_cache_lookup(df, tree, hfinfo);
+		for (unsigned i = 0; i < values->len; i++) {
+			found = true;
+			have_match = match_func(g_ptr_array_index(values, i), fv2);
+			if (how == MATCH_ALL && have_match == FT_FALSE) {
+				return false;
+			}
+			else if (how == MATCH_ANY && have_match == FT_TRUE) {
+				return true;
+			}
+		}
+		return how == MATCH_ALL && found;
+	}
+
+	while (hfinfo) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+		for (unsigned i = 0; finfos != NULL && i < finfos->len; i++) {
+			finfo = g_ptr_array_index(finfos, i);
+			if (finfo->value == NULL)
+				continue;
+			found = true;
+			have_match = match_func(finfo->value, fv2);
+			if (how == MATCH_ALL && have_match == FT_FALSE) {
+				return false;
+			}
+			else if (how == MATCH_ANY && have_match == FT_TRUE) {
+				return true;
+			}
+		}
+		hfinfo = hfinfo->same_name_next;
+	}
+	/* An absent field fails the test, as the read would have. */
+	return how == MATCH_ALL && found;
+}
+
 static bool
 all_zero(dfilter_t *df, dfvm_value_t *arg1)
 {
@@ -1200,28 +1524,85 @@ test_in_internal(fvalue_t *fv, GPtrArray *range[2])
 }
 
 static bool
-any_in(dfilter_t *df, dfvm_value_t *arg1)
+set_contains(df_set_t *set, fvalue_t *fv)
+{
+	ftenum_t ft = fvalue_type_ftenum(fv);
+	GPtrArray *scan = set->elements;
+	df_set_range_t *r;
+	unsigned lo, hi, mid;
+
+	if (set->index && set_ftype_compatible(ft, set->index_ftype) &&
+					set_fvalue_hashable(fv)) {
+		if (g_hash_table_contains(set->index, fv))
+			return true;
+		scan = set->unindexed;
+	}
+	for (unsigned i = 0; i < scan->len; i++) {
+		if (fvalue_eq(fv, scan->pdata[i]) == FT_TRUE)
+			return true;
+	}
+
+	if (set->ranges->len == 0)
+		return false;
+
+	if (set->ranges_sorted && set_ftype_compatible(ft, set->ranges_ftype)) {
+		/* Find the last range with a lower bound <= fv. */
+		lo = 0;
+		hi = set->ranges->len;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			r = &g_array_index(set->ranges, df_set_range_t, mid);
+			if (fvalue_le(r->low, fv) == FT_TRUE)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == 0)
+			return false;
+		r = &g_array_index(set->ranges, df_set_range_t, lo - 1);
+		return fvalue_le(fv, r->high_max) == FT_TRUE;
+	}
+
+	for (unsigned i = 0; i < set->ranges->len; i++) {
+		r = &g_array_index(set->ranges, df_set_range_t, i);
+		if (fvalue_ge(fv, r->low) == FT_TRUE &&
+				fvalue_le(fv, r->high) == FT_TRUE)
+			return true;
+	}
+	return false;
+}
+
+/* Test membership in the constant set 'arg2' if present, otherwise in the
+ * set stack. */
+static bool
+test_in(dfilter_t *df, dfvm_value_t *arg2, fvalue_t *fv)
+{
+	GSList *stack;
+
+	if (arg2) {
+		return set_contains(arg2->value.set, fv);
+	}
+
+	for (stack = df->set_stack; stack != NULL; stack = stack->next) {
+		if (test_in_internal(fv, stack->data)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+any_in(dfilter_t *df, dfvm_value_t *arg1, dfvm_value_t *arg2)
 {
 	df_cell_t *rp = &df->registers[arg1->value.numeric];
 	GPtrArray *value;
-	GSList *stack;
-	bool ok;
 
 	/* If the read failed we jump over the membership test. */
 	ws_assert(!df_cell_is_empty(rp));
 	value = df_cell_ptr(rp);
 
 	for (size_t i = 0; i < value->len; i++) {
-		stack = df->set_stack;
-		ok = false;
-		while (stack) {
-			if (test_in_internal(value->pdata[i], stack->data)) {
-				ok = true;
-				break;
-			}
-			stack = stack->next;
-		}
-		if (ok) {
+		if (test_in(df, arg2, value->pdata[i])) {
 			return true;
 		}
 	}
@@ -1229,28 +1610,17 @@ any_in(dfilter_t *df, dfvm_value_t *arg1)
 }
 
 static bool
-all_in(dfilter_t *df, dfvm_value_t *arg1)
+all_in(dfilter_t *df, dfvm_value_t *arg1, dfvm_value_t *arg2)
 {
 	df_cell_t *rp = &df->registers[arg1->value.numeric];
 	GPtrArray *value;
-	GSList *stack;
-	bool ok;
 
 	/* If the read failed we jump over the membership test. */
 	ws_assert(!df_cell_is_empty(rp));
 	value = df_cell_ptr(rp);
 
 	for (size_t i = 0; i < value->len; i++) {
-		stack = df->set_stack;
-		ok = false;
-		while (stack) {
-			if (test_in_internal(value->pdata[i], stack->data)) {
-				ok = true;
-				break;
-			}
-			stack = stack->next;
-		}
-		if (!ok) {
+		if (!test_in(df, arg2, value->pdata[i])) {
 			return false;
 		}
 	}
@@ -1568,15 +1938,27 @@ check_exists_finfos(proto_tree *tree, header_field_info *hfinfo, drange_t *range
 }
 
 static bool
-check_exists(proto_tree *tree, dfvm_value_t *arg1, dfvm_value_t *arg2)
+check_exists(dfilter_t *df, proto_tree *tree, dfvm_value_t *arg1, dfvm_value_t *arg2)
 {
 	header_field_info	*hfinfo;
 	drange_t		*range = NULL;
+	GPtrArray		*values;
 
 	hfinfo = arg1->value.hfinfo;
 	if (arg2)
 		range = arg2->value.drange;
 
+	/*
+	 * Don't read the field just for this, but use it if it's been read.
+	 * (Fields without a value don't show up there, so an empty list of
+	 * values doesn't mean that the field isn't present.)
+	 */
+	if (df->field_cache != NULL && range == NULL) {
+		values = g_hash_table_lookup(df->field_cache, hfinfo);
+		if (values != NULL && values->len > 0)
+			return true;
+	}
+
 	while (hfinfo) {
 		if (check_exists_finfos(tree, hfinfo, range)) {
 			return true;
@@ -1611,11 +1993,15 @@ dfvm_apply_full(dfilter_t *df, proto_tree *tree, GPtrArray **fvals)
 
 		switch (insn->op) {
 			case DFVM_CHECK_EXISTS:
-				accum = check_exists(tree, arg1, NULL);
+				accum = check_exists(df, tree, arg1, NULL);
 				break;
 
 			case DFVM_CHECK_EXISTS_R:
-				accum = check_exists(tree, arg1, arg2);
+				accum = check_exists(df, tree, arg1, arg2);
+				break;
+
+			case DFVM_FIELD_CMP:
+				accum = field_cmp(df, tree, arg1, arg2, arg3);
 				break;
 
 			case DFVM_READ_TREE:
@@ -1759,19 +2145,19 @@ dfvm_apply_full(dfilter_t *df, proto_tree *tree, GPtrArray **fvals)
 				break;
 
 			case DFVM_SET_ALL_IN:
-				accum = all_in(df, arg1);
+				accum = all_in(df, arg1, arg2);
 				break;
 
 			case DFVM_SET_ANY_IN:
-				accum = any_in(df, arg1);
+				accum = any_in(df, arg1, arg2);
 				break;
 
 			case DFVM_SET_ALL_NOT_IN:
-				accum = !all_in(df, arg1);
+				accum = !all_in(df, arg1, arg2);
 				break;
 
 			case DFVM_SET_ANY_NOT_IN:
-				accum = !any_in(df, arg1);
+				accum = !any_in(df, arg1, arg2);
 				break;
 
 			case DFVM_SET_CLEAR:
@@ -31,8 +31,29 @@ typedef enum {
 	DRANGE,
 	FUNCTION_DEF,
 	PCRE,
+	FVALUE_SET,
 } dfvm_value_type_t;
 
+/* Range element of a constant set. */
+typedef struct {
+	fvalue_t	*low;
+	fvalue_t	*high;
+	fvalue_t	*high_max;	/* Largest upper bound of this and all previous ranges */
+} df_set_range_t;
+
+/* A set whose members are all constants, built once at compile time.
+ * Hashable members are looked up in a hash table and ranges are sorted
+ * by lower bound for a binary search; anything else is scanned linearly. */
+typedef struct {
+	GPtrArray	*elements;	/* All single elements */
+	GHashTable	*index;		/* Hashable subset of elements, or NULL */
+	ftenum_t	index_ftype;
+	GPtrArray	*unindexed;	/* Elements not in the index */
+	GArray		*ranges;	/* Of df_set_range_t */
+	bool		ranges_sorted;
+	ftenum_t	ranges_ftype;
+} df_set_t;
+
 typedef struct {
 	dfvm_value_type_t	type;
 
@@ -43,6 +64,7 @@ typedef struct {
 		header_field_info	*hfinfo;
 		df_func_def_t		*funcdef;
 		ws_regex_t		*pcre;
+		df_set_t		*set;
 	} value;
 
 	int ref_count;
@@ -100,6 +122,7 @@ typedef enum {
 	DFVM_STACK_POP,
 	DFVM_NOT_ALL_ZERO,
 	DFVM_NO_OP,
+	DFVM_FIELD_CMP,
 } dfvm_opcode_t;
 
 const char *
@@ -152,6 +175,9 @@ dfvm_value_new_pcre(ws_regex_t *re);
 dfvm_value_t*
 dfvm_value_new_uint(unsigned num);
 
+dfvm_value_t*
+dfvm_value_new_set(GPtrArray *elements, GPtrArray *ranges);
+
 void
 dfvm_dump(FILE *f, dfilter_t *df, uint16_t flags);
 
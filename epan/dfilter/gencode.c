@@ -444,8 +444,53 @@ fixup_jumps(void *data, void *user_data)
 	}
 }
 
-/* Generate the code for the in operator. Pushes set values into a stack
- * and then evaluates membership in a single instruction. */
+static bool
+set_is_constant(GSList *nodelist)
+{
+	stnode_t	*node1, *node2;
+
+	while (nodelist) {
+		node1 = nodelist->data;
+		nodelist = g_slist_next(nodelist);
+		node2 = nodelist->data;
+		nodelist = g_slist_next(nodelist);
+
+		if (stnode_type_id(node1) != STTYPE_FVALUE)
+			return false;
+		if (node2 && stnode_type_id(node2) != STTYPE_FVALUE)
+			return false;
+	}
+	return true;
+}
+
+static dfvm_value_t *
+gen_constant_set(GSList *nodelist)
+{
+	GPtrArray	*elements, *ranges;
+	stnode_t	*node1, *node2;
+
+	elements = g_ptr_array_new();
+	ranges = g_ptr_array_new();
+	while (nodelist) {
+		node1 = nodelist->data;
+		nodelist = g_slist_next(nodelist);
+		node2 = nodelist->data;
+		nodelist = g_slist_next(nodelist);
+
+		if (node2) {
+			g_ptr_array_add(ranges, stnode_steal_data(node1));
+			g_ptr_array_add(ranges, stnode_steal_data(node2));
+		}
+		else {
+			g_ptr_array_add(elements, stnode_steal_data(node1));
+		}
+	}
+	return dfvm_value_new_set(elements, ranges);
+}
+
+/* Generate the code for the in operator. If all the set members are
+ * constants the set is built at compile time. Otherwise pushes set values
+ * into a stack and then evaluates membership in a single instruction. */
 static void
 gen_relation_in(dfwork_t *dfw, dfvm_opcode_t op, stmatch_t how,
 				stnode_t *st_arg1, stnode_t *st_arg2)
@@ -460,8 +505,23 @@ gen_relation_in(dfwork_t *dfw, dfvm_opcode_t op, stmatch_t how,
 	/* Create code for the LHS of the relation */
 	val1 = gen_entity(dfw, st_arg1, &jumps);
 
-	/* Create code to populate the set stack */
 	nodelist_head = nodelist = stnode_steal_data(st_arg2);
+
+	if (set_is_constant(nodelist_head)) {
+		/* Build the set once instead of pushing its elements
+		 * on every run. */
+		insn = dfvm_insn_new(select_opcode(op, how));
+		insn->arg1 = dfvm_value_ref(val1);
+		insn->arg2 = dfvm_value_ref(gen_constant_set(nodelist_head));
+		dfw_append_insn(dfw, insn);
+		set_nodelist_free(nodelist_head);
+
+		g_slist_foreach(jumps, fixup_jumps, dfw);
+		g_slist_free(jumps);
+		return;
+	}
+
+	/* Create code to populate the set stack */
 	while (nodelist) {
 		node1 = nodelist->data;
 		nodelist = g_slist_next(nodelist);
@@ -897,6 +957,136 @@ optimize(dfwork_t *dfw)
 	}
 }
 
+static bool
+is_fusable_cmp(dfvm_opcode_t op)
+{
+	switch (op) {
+		case DFVM_ALL_EQ:
+		case DFVM_ANY_EQ:
+		case DFVM_ALL_NE:
+		case DFVM_ANY_NE:
+		case DFVM_ALL_GT:
+		case DFVM_ANY_GT:
+		case DFVM_ALL_GE:
+		case DFVM_ANY_GE:
+		case DFVM_ALL_LT:
+		case DFVM_ANY_LT:
+		case DFVM_ALL_LE:
+		case DFVM_ANY_LE:
+		case DFVM_ALL_CONTAINS:
+		case DFVM_ANY_CONTAINS:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+static void
+count_register_use(unsigned *uses, dfvm_value_t *arg)
+{
+	if (arg && arg->type == REGISTER)
+		uses[arg->value.numeric]++;
+}
+
+/*
+ * Returns true if insns[id] starts the sequence generated for a relation
+ * between a field and a constant:
+ *
+ *   READ_TREE      field -> Rn
+ *   IF_FALSE_GOTO  (past the comparison)
+ *   ANY_EQ         Rn == constant
+ */
+static bool
+is_field_cmp_sequence(dfwork_t *dfw, int id)
+{
+	dfvm_insn_t	*read, *jump, *cmp;
+
+	if (id + 2 >= (int)dfw->insns->len)
+		return false;
+
+	read = g_ptr_array_index(dfw->insns, id);
+	jump = g_ptr_array_index(dfw->insns, id + 1);
+	cmp = g_ptr_array_index(dfw->insns, id + 2);
+
+	return read->op == DFVM_READ_TREE && read->arg1->type == HFINFO &&
+		jump->op == DFVM_IF_FALSE_GOTO &&
+		is_fusable_cmp(cmp->op) &&
+		cmp->arg1->type == REGISTER &&
+		cmp->arg1->value.numeric == read->arg2->value.numeric &&
+		cmp->arg2->type == FVALUE;
+}
+
+/*
+ * Replace "read field into register, skip if absent, compare register with
+ * a constant" with a single FIELD_CMP instruction that compares the field
+ * values in the tree directly. This avoids building and freeing a register
+ * array for every packet for the most common kind of filter.
+ *
+ * The register must not be used anywhere else. If the field is absent
+ * FIELD_CMP falls through to the next instruction with accum false instead
+ * of jumping; optimize() only redirects jumps to an equivalent target, so
+ * the result is the same.
+ */
+static void
+fuse_field_cmp(dfwork_t *dfw)
+{
+	int		id, length;
+	dfvm_insn_t	*insn, *cmp;
+	unsigned	*uses, *fusable_uses;
+	bool		*jump_target;
+
+	length = dfw->insns->len;
+	if (dfw->next_register == 0)
+		return;
+
+	uses = g_new0(unsigned, dfw->next_register);
+	fusable_uses = g_new0(unsigned, dfw->next_register);
+	jump_target = g_new0(bool, length);
+
+	for (id = 0; id < length; id++) {
+		insn = g_ptr_array_index(dfw->insns, id);
+		if (insn->op == DFVM_IF_TRUE_GOTO || insn->op == DFVM_IF_FALSE_GOTO) {
+			if (insn->arg1->value.numeric < (unsigned)length)
+				jump_target[insn->arg1->value.numeric] = true;
+			continue;
+		}
+		count_register_use(uses, insn->arg1);
+		count_register_use(uses, insn->arg2);
+		count_register_use(uses, insn->arg3);
+	}
+
+	for (id = 0; id < length; id++) {
+		if (is_field_cmp_sequence(dfw, id)) {
+			insn = g_ptr_array_index(dfw->insns, id);
+			fusable_uses[insn->arg2->value.numeric] += 2;
+		}
+	}
+
+	for (id = 0; id < length; id++) {
+		if (!is_field_cmp_sequence(dfw, id) ||
+				jump_target[id + 1] || jump_target[id + 2])
+			continue;
+
+		insn = g_ptr_array_index(dfw->insns, id);
+		if (uses[insn->arg2->value.numeric] != fusable_uses[insn->arg2->value.numeric])
+			continue;
+
+		cmp = g_ptr_array_index(dfw->insns, id + 2);
+		dfvm_value_unref(insn->arg2);
+		insn->op = DFVM_FIELD_CMP;
+		insn->arg2 = dfvm_value_ref(cmp->arg2);
+		insn->arg3 = dfvm_value_ref(dfvm_value_new_uint(cmp->op));
+		dfvm_insn_replace_no_op(g_ptr_array_index(dfw->insns, id + 1));
+		dfvm_insn_replace_no_op(cmp);
+		id += 2;
+	}
+
+	g_free(uses);
+	g_free(fusable_uses);
+	g_free(jump_target);
+}
+
 void
 dfw_gencode(dfwork_t *dfw)
 {
@@ -910,6 +1100,7 @@ dfw_gencode(dfwork_t *dfw)
 	dfw_append_insn(dfw, insn);
 	if (dfw->flags & DF_OPTIMIZE) {
 		optimize(dfw);
+		fuse_field_cmp(dfw);
 	}
 }
 
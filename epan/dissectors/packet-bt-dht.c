@@ -819,6 +819,8 @@ void
 proto_reg_handoff_bt_dht(void)
 {
   heur_dissector_add("udp", dissect_bt_dht_heur, "BitTorrent DHT over UDP", "bittorrent_dht_udp", proto_bt_dht, HEURISTIC_ENABLE);
+  /* All KRPC messages are bencoded dictionaries; see test_bt_dht() */
+  heur_dissector_set_signature("bittorrent_dht_udp", DHT_MIN_LEN, 0, (const uint8_t *)"d", 1);
 
   // If this is ever streamed (transported over TCP) we need to add recursion checks.
   dissector_add_for_decode_as_with_preference("udp.port", bt_dht_handle);
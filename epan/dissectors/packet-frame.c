@@ -862,7 +862,7 @@ dissect_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *parent_tree, void*
 		}
 		if (do_frame_dissection) {
 			item = proto_tree_add_time(fh_tree, hf_frame_shift_offset, tvb,
-					    0, 0, &(pinfo->fd->shift_offset));
+					    0, 0, frame_data_shift_offset(pinfo->fd));
 			proto_item_set_generated(item);
 
 			if (proto_field_is_referenced(tree, hf_frame_time_delta)) {
@@ -22139,6 +22139,10 @@ void proto_reg_handoff_rtps(void) {
   heur_dissector_add("rtitcp", dissect_rtps_rtitcp, "RTPS over RTITCP", "rtps_rtitcp", proto_rtps, HEURISTIC_ENABLE);
   heur_dissector_add("udp", dissect_rtps_udp, "RTPS over UDP", "rtps_udp", proto_rtps, HEURISTIC_ENABLE);
   heur_dissector_add("tcp", dissect_rtps_tcp, "RTPS over TCP", "rtps_tcp", proto_rtps, HEURISTIC_ENABLE);
+
+  /* Every RTPS message starts with a 16 byte header beginning with "RTPS" or "RTPX" */
+  heur_dissector_set_signature("rtps_udp", 16, 0, (const uint8_t *)"RTP", 3);
+  heur_dissector_set_signature("rtps_tcp", 4 + 16, 4, (const uint8_t *)"RTP", 3);
 }
 
 /*
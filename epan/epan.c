@@ -601,6 +601,14 @@ epan_free(epan_t *session)
 	}
 }
 
+void
+epan_evict_idle_state(epan_t *session _U_, const uint32_t oldest_frame)
+{
+	/* XXX, conversations and reassembly tables aren't per-session */
+	conversation_evict_idle(oldest_frame);
+	reassembly_tables_evict_idle(oldest_frame);
+}
+
 void
 epan_conversation_init(void)
 {
@@ -348,6 +348,23 @@ const nstime_t *epan_get_start_ts(const epan_t *session);
  */
 WS_DLL_PUBLIC void epan_free(epan_t *session);
 
+/**
+ * @brief Forget dissection state that hasn't been used since a given frame.
+ *
+ * Stops tracking conversations whose last frame is before `oldest_frame` and
+ * frees reassemblies that haven't seen a fragment since then, without
+ * disturbing the state of more recent traffic. Unlike freeing and recreating
+ * the session, this keeps active conversations and reassemblies intact.
+ *
+ * Only use this when every packet is dissected exactly once and in order
+ * (e.g. single-pass TShark), as frames before `oldest_frame` can no longer
+ * find their state.
+ *
+ * @param session       Pointer to the epan session.
+ * @param oldest_frame  The oldest frame number whose state is kept.
+ */
+WS_DLL_PUBLIC void epan_evict_idle_state(epan_t *session, const uint32_t oldest_frame);
+
 /**
  * @brief Retrieve the epan library's version as a string.
  *
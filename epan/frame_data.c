@@ -334,14 +334,16 @@ frame_data_compare(const struct epan_session *epan, const frame_data *fdata1, co
 int
 frame_data_aggregation_compare(const frame_data* fdata1, const frame_data* fdata2)
 {
-  unsigned length = g_slist_length(fdata1->aggregation_keys);
-  if (length != g_slist_length(fdata2->aggregation_keys)) {
+  GSList *keys1 = FRAME_DATA_AGGREGATION_KEYS(fdata1);
+  GSList *keys2 = FRAME_DATA_AGGREGATION_KEYS(fdata2);
+  unsigned length = g_slist_length(keys1);
+  if (length != g_slist_length(keys2)) {
     return 1;
   }
   unsigned i = 0;
   while (i < length) {
-    const aggregation_key* key1 = (aggregation_key*)g_slist_nth_data(fdata1->aggregation_keys, i);
-    const aggregation_key* key2 = (aggregation_key*)g_slist_nth_data(fdata2->aggregation_keys, i);
+    const aggregation_key* key1 = (aggregation_key*)g_slist_nth_data(keys1, i);
+    const aggregation_key* key2 = (aggregation_key*)g_slist_nth_data(keys2, i);
     if (g_strcmp0(key1->field, key2->field) != 0 ||
       frame_data_aggregation_values_compare(key1->values, key2->values) == 1) {
       return 1;
@@ -361,7 +363,7 @@ frame_data_init(frame_data *fdata, uint32_t num, const wtap_rec *rec,
   fdata->file_off = offset;
   fdata->passed_dfilter = 1;
   fdata->dependent_of_displayed = 0;
-  fdata->dependent_frames = NULL;
+  fdata->extra = NULL;
   fdata->encoding = PACKET_CHAR_ENC_CHAR_ASCII;
   fdata->visited = 0;
   fdata->marked = 0;
@@ -423,11 +425,28 @@ frame_data_init(frame_data *fdata, uint32_t num, const wtap_rec *rec,
   fdata->has_modified_block = 0;
   fdata->need_colorize = 0;
   fdata->color_filter = NULL;
-  fdata->shift_offset.secs = 0;
-  fdata->shift_offset.nsecs = 0;
   fdata->frame_ref_num = 0;
   fdata->prev_dis_num = 0;
-  fdata->aggregation_keys = NULL;
+}
+
+frame_data_extra *
+frame_data_get_extra(frame_data *fdata)
+{
+  if (fdata->extra == NULL) {
+    fdata->extra = g_new0(frame_data_extra, 1);
+  }
+  return fdata->extra;
+}
+
+const nstime_t *
+frame_data_shift_offset(const frame_data *fdata)
+{
+  static const nstime_t no_shift = NSTIME_INIT_ZERO;
+
+  if (fdata->extra == NULL) {
+    return &no_shift;
+  }
+  return &fdata->extra->shift_offset;
 }
 
 void
@@ -511,19 +530,30 @@ frame_data_destroy(frame_data *fdata)
     fdata->pfd = NULL;
   }
 
-  if (fdata->dependent_frames) {
-    g_hash_table_destroy(fdata->dependent_frames);
-    fdata->dependent_frames = NULL;
+  if (fdata->extra == NULL) {
+    return;
+  }
+
+  if (fdata->extra->dependent_frames) {
+    g_hash_table_destroy(fdata->extra->dependent_frames);
+    fdata->extra->dependent_frames = NULL;
   }
 
   frame_data_aggregation_free(fdata);
+
+  /* The time shift is not dissection state and survives a reset; the
+   * frame data sequence frees what is left when it is freed. */
+  if (nstime_is_zero(&fdata->extra->shift_offset)) {
+    g_free(fdata->extra);
+    fdata->extra = NULL;
+  }
 }
 
 void frame_data_aggregation_free(frame_data* fdata)
 {
-  if (fdata->aggregation_keys) {
-    g_slist_free_full(fdata->aggregation_keys, free_aggregation_key);
-    fdata->aggregation_keys = NULL;
+  if (fdata->extra && fdata->extra->aggregation_keys) {
+    g_slist_free_full(fdata->extra->aggregation_keys, free_aggregation_key);
+    fdata->extra->aggregation_keys = NULL;
   }
 }
 
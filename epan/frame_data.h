@@ -50,6 +50,14 @@ typedef struct _aggregation_key {
   int     values_num;
 } aggregation_key;
 
+/** Per-frame data that most frames never use. It is allocated on first
+   use, so that frame_data only needs a single pointer for it. */
+typedef struct _frame_data_extra {
+  GHashTable  *dependent_frames;  /**< A hash table of frames which this one depends on */
+  GSList      *aggregation_keys;  /**< Holds the aggregation_key values used for rendering the aggregation view. */
+  nstime_t     shift_offset;      /**< How much the abs_tm of the frame is shifted */
+} frame_data_extra;
+
 /** The frame number is the ordinal number of the frame in the capture, so
    it's 1-origin.  In various contexts, 0 as a frame number means "frame
    number unknown".
@@ -76,7 +84,7 @@ typedef struct _frame_data {
      LLP64 (64-bit Windows) platforms.  Put them here, one after the
      other, so they don't require padding between them. */
   GSList      *pfd;          /**< Per frame proto data */
-  GHashTable  *dependent_frames;     /**< A hash table of frames which this one depends on */
+  frame_data_extra *extra;   /**< Rarely used data, NULL if none */
   const struct _color_filter *color_filter;  /**< Per-packet matching color_filter_t object */
   uint32_t     cum_bytes;    /**< Cumulative bytes into the capture */
   /* XXX - cum_bytes presumably ought to be 64-bit as well now */
@@ -96,16 +104,28 @@ typedef struct _frame_data {
   unsigned int need_colorize    : 1; /**< 1 = need to (re-)calculate packet color */
   unsigned int tsprec           : 4; /**< Time stamp precision -2^tsprec gives up to femtoseconds */
   nstime_t     abs_ts;       /**< Absolute timestamp */
-  nstime_t     shift_offset; /**< How much the abs_tm of the frame is shifted */
   uint32_t     frame_ref_num; /**< Reference frame for relative timestamps (can be this frame) */
   /* frame_ref_num == num if ref_time == true, but also if this is the first
    * record that has_ts (or if somehow a record without a TS is a reference
    * time frame, the first frame after that with has_ts == true.) */
   uint32_t     prev_dis_num; /**< Previous displayed frame (0 if first one) */
-  GSList*      aggregation_keys; /**< Holds the aggregation_key values used for rendering the aggregation view. */
 } frame_data;
 DIAG_ON_PEDANTIC
 
+/** The frames which this one depends on, or NULL */
+#define FRAME_DATA_DEPENDENT_FRAMES(fdata) \
+  ((fdata)->extra ? (fdata)->extra->dependent_frames : NULL)
+
+/** The aggregation keys of this frame, or NULL */
+#define FRAME_DATA_AGGREGATION_KEYS(fdata) \
+  ((fdata)->extra ? (fdata)->extra->aggregation_keys : NULL)
+
+/** Returns the rarely used data of a frame, allocating it if needed. */
+WS_DLL_PUBLIC frame_data_extra *frame_data_get_extra(frame_data *fdata);
+
+/** Returns how much the timestamp of a frame is shifted. */
+WS_DLL_PUBLIC const nstime_t *frame_data_shift_offset(const frame_data *fdata);
+
 /** compare two frame_datas */
 WS_DLL_PUBLIC int frame_data_compare(const struct epan_session *epan, const frame_data *fdata1, const frame_data *fdata2, int field);
 
@@ -269,6 +269,8 @@ free_frame_data_array(void *array, unsigned count, unsigned level, bool last)
 
     for (i=0; i < level_count; i++) {
       frame_data_destroy(&real_array[i]);
+      /* Anything frame_data_destroy() keeps, such as a time shift */
+      g_free(real_array[i].extra);
     }
   }
 
@@ -328,8 +330,8 @@ find_and_mark_frame_depended_upon(void *key, void *value _U_, void *user_data)
      */
     if (!(dependent_fd->dependent_of_displayed || dependent_fd->passed_dfilter)) {
       dependent_fd->dependent_of_displayed = 1;
-      if (dependent_fd->dependent_frames) {
-        g_hash_table_foreach(dependent_fd->dependent_frames, find_and_mark_frame_depended_upon, frames);
+      if (FRAME_DATA_DEPENDENT_FRAMES(dependent_fd)) {
+        g_hash_table_foreach(dependent_fd->extra->dependent_frames, find_and_mark_frame_depended_upon, frames);
       }
     }
   }
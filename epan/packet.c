@@ -393,9 +393,31 @@ init_dissection(void)
 	expert_packet_init();
 }
 
+/*
+ * Log the counters kept by dissector_try_heuristic() for a heuristic
+ * dissector, and start counting again.
+ */
+static void
+heur_dissector_log_counters(void *key _U_, void *value, void *user_data _U_)
+{
+	heur_dtbl_entry_t *hdtbl_entry = (heur_dtbl_entry_t *)value;
+
+	if (hdtbl_entry->calls != 0 || hdtbl_entry->rejected_early != 0) {
+		ws_debug("heuristic %s: %" PRIu64 " calls, %" PRIu64 " accepted, %" PRIu64 " ruled out by its signature",
+		    hdtbl_entry->short_name, hdtbl_entry->calls,
+		    hdtbl_entry->accepts, hdtbl_entry->rejected_early);
+	}
+	hdtbl_entry->calls = 0;
+	hdtbl_entry->accepts = 0;
+	hdtbl_entry->rejected_early = 0;
+}
+
 void
 cleanup_dissection(void)
 {
+	/* Report how the heuristic dissectors fared. */
+	g_hash_table_foreach(heuristic_short_names, heur_dissector_log_counters, NULL);
+
 	/* Cleanup protocol-specific variables. */
 	g_slist_foreach(cleanup_routines, &call_routine, NULL);
 
@@ -556,10 +578,12 @@ mark_frame_as_depended_upon(frame_data *fd, uint32_t frame_num)
 		/* ws_assert(frame_num < fd->num) - we assume in several other
 		 * places in the code that frames don't depend on future
 		 * frames. */
-		if (fd->dependent_frames == NULL) {
-			fd->dependent_frames = g_hash_table_new(g_direct_hash, g_direct_equal);
+		frame_data_extra *extra = frame_data_get_extra(fd);
+
+		if (extra->dependent_frames == NULL) {
+			extra->dependent_frames = g_hash_table_new(g_direct_hash, g_direct_equal);
 		}
-		g_hash_table_add(fd->dependent_frames, GUINT_TO_POINTER(frame_num));
+		g_hash_table_add(extra->dependent_frames, GUINT_TO_POINTER(frame_num));
 	}
 }
 
@@ -2993,6 +3017,12 @@ heur_dissector_add(const char *name, heur_dissector_t dissector, const char *dis
 	hdtbl_entry->list_name = g_strdup(name);
 	hdtbl_entry->enabled   = (enable == HEURISTIC_ENABLE);
 	hdtbl_entry->enabled_by_default = (enable == HEURISTIC_ENABLE);
+	hdtbl_entry->sig_min_len = 0;
+	hdtbl_entry->sig_offset = 0;
+	hdtbl_entry->sig_len = 0;
+	hdtbl_entry->calls = 0;
+	hdtbl_entry->accepts = 0;
+	hdtbl_entry->rejected_early = 0;
 
 	/* do the table insertion */
 	/* Ensure short_name is unique */
@@ -3051,6 +3081,49 @@ heur_dissector_delete(const char *name, heur_dissector_t dissector, const int pr
 	}
 }
 
+void
+heur_dissector_set_signature(const char *internal_name, unsigned min_len,
+			     unsigned offset, const uint8_t *bytes, unsigned len)
+{
+	heur_dtbl_entry_t *hdtbl_entry = find_heur_dissector_by_unique_short_name(internal_name);
+
+	if (hdtbl_entry == NULL) {
+		fprintf(stderr, "OOPS: heuristic dissector \"%s\" doesn't exist\n",
+		    internal_name);
+		if (wireshark_abort_on_dissector_bug)
+			abort();
+		return;
+	}
+	if (len > HEUR_SIGNATURE_MAX_LEN || (len != 0 && bytes == NULL)) {
+		ws_error("Invalid signature for heuristic dissector \"%s\"."
+			" This might be caused by an inappropriate plugin or a development error.", internal_name);
+	}
+
+	hdtbl_entry->sig_min_len = min_len;
+	hdtbl_entry->sig_offset = offset;
+	hdtbl_entry->sig_len = len;
+	if (len != 0)
+		memcpy(hdtbl_entry->sig_bytes, bytes, len);
+}
+
+/*
+ * Returns true if the packet doesn't meet the preconditions set for a
+ * heuristic dissector. If the signature bytes weren't captured, the
+ * dissector is left to decide.
+ */
+static inline bool
+heur_dissector_rejects_early(const heur_dtbl_entry_t *hdtbl_entry, tvbuff_t *tvb)
+{
+	if (hdtbl_entry->sig_min_len != 0 &&
+	    tvb_reported_length(tvb) < hdtbl_entry->sig_min_len)
+		return true;
+	if (hdtbl_entry->sig_len != 0 &&
+	    tvb_bytes_exist(tvb, hdtbl_entry->sig_offset, hdtbl_entry->sig_len) &&
+	    tvb_memeql(tvb, hdtbl_entry->sig_offset, hdtbl_entry->sig_bytes, hdtbl_entry->sig_len) != 0)
+		return true;
+	return false;
+}
+
 bool
 dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 			packet_info *pinfo, proto_tree *tree, heur_dtbl_entry_t **heur_dtbl_entry, void *data)
@@ -3107,6 +3180,16 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 			continue;
 		}
 
+		if (heur_dissector_rejects_early(hdtbl_entry, tvb)) {
+			/*
+			 * The packet can't be for this dissector; don't
+			 * bother setting up to call it.
+			 */
+			hdtbl_entry->rejected_early++;
+			prev_entry = entry;
+			continue;
+		}
+
 		if (hdtbl_entry->protocol != NULL) {
 			proto_id = proto_get_id(hdtbl_entry->protocol);
 			/* do NOT change this behavior - wslua uses the protocol short name set here in order
@@ -3124,6 +3207,7 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 		pinfo->heur_list_name = hdtbl_entry->list_name;
 
 		saved_desegment_len = pinfo->desegment_len;
+		hdtbl_entry->calls++;
 		len = (hdtbl_entry->dissector)(tvb, pinfo, tree, data);
 		consumed_none = len == 0 || (pinfo->desegment_len != saved_desegment_len && pinfo->desegment_offset == 0);
 		if (hdtbl_entry->protocol != NULL &&
@@ -3149,6 +3233,7 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 			}
 
 			*heur_dtbl_entry = hdtbl_entry;
+			hdtbl_entry->accepts++;
 
 			/* Bubble the matched entry to the top for faster search next time. */
 			if (prev_entry != NULL) {
@@ -482,6 +482,9 @@ struct heur_dissector_list;
 typedef struct heur_dissector_list *heur_dissector_list_t;
 
 
+/** Maximum length of the signature set with heur_dissector_set_signature(). */
+#define HEUR_SIGNATURE_MAX_LEN 8
+
 typedef struct heur_dtbl_entry {
 	heur_dissector_t dissector;
 	protocol_t *protocol; /* this entry's protocol */
@@ -490,6 +493,16 @@ typedef struct heur_dtbl_entry {
 	char *short_name;     /* string used for "internal" use to uniquely identify heuristic */
 	bool enabled;
 	bool enabled_by_default;
+	/* Preconditions set with heur_dissector_set_signature() */
+	unsigned sig_min_len;  /* minimum reported length, or 0 */
+	unsigned sig_offset;   /* offset of sig_bytes */
+	unsigned sig_len;      /* length of sig_bytes, or 0 */
+	uint8_t sig_bytes[HEUR_SIGNATURE_MAX_LEN];
+	/* Counters maintained by dissector_try_heuristic(); logged at debug
+	   level and reset by cleanup_dissection() */
+	uint64_t calls;        /* times the dissector was called */
+	uint64_t accepts;      /* times the dissector accepted the packet */
+	uint64_t rejected_early; /* times the preconditions ruled the packet out */
 } heur_dtbl_entry_t;
 
 /** A protocol uses this function to register a heuristic sub-dissector list.
@@ -600,6 +613,21 @@ WS_DLL_PUBLIC void heur_dissector_add(const char *name, heur_dissector_t dissect
  */
 WS_DLL_PUBLIC void heur_dissector_delete(const char *name, heur_dissector_t dissector, const int proto);
 
+/** Set cheap preconditions for a heuristic dissector.
+ *  dissector_try_heuristic() checks them before calling the dissector, and
+ *  doesn't call it for packets that can't match. Only set preconditions
+ *  that the dissector itself requires of every packet it accepts.
+ *  Call this after heur_dissector_add().
+ *
+ * @param internal_name the unique short name passed to heur_dissector_add()
+ * @param min_len the minimum reported length of the data, or 0
+ * @param offset the offset of the signature bytes
+ * @param bytes the signature bytes, which must be present at offset, or NULL
+ * @param len the number of signature bytes, at most HEUR_SIGNATURE_MAX_LEN
+ */
+WS_DLL_PUBLIC void heur_dissector_set_signature(const char *internal_name,
+    unsigned min_len, unsigned offset, const uint8_t *bytes, unsigned len);
+
 /** Register a new dissector. */
 WS_DLL_PUBLIC dissector_handle_t register_dissector(const char *name, dissector_t dissector, const int proto);
 
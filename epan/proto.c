@@ -28,6 +28,7 @@
 #include <wsutil/unicode-utils.h>
 #include <wsutil/dtoa.h>
 #include <wsutil/filesystem.h>
+#include <wsutil/ws_roundup.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -426,20 +427,129 @@ static GPtrArray *deregistered_slice;
 /* indexed by prefix, contains initializers */
 static GHashTable* prefixes;
 
+/*
+ * The proto_nodes and field_infos of a tree are carved out of large
+ * chunks that belong to the tree, rather than being allocated one by
+ * one from the packet pool, and they're all released at once when the
+ * tree is reset for the next packet; the chunks are kept, so building
+ * the tree for a packet normally allocates no memory at all. When a
+ * tree is freed, its chunks are kept for the next tree to be created,
+ * so this also works when a new tree is created for every packet.
+ *
+ * If WIRESHARK_DEBUG_WMEM_OVERRIDE is set, the nodes are allocated from
+ * the packet pool as before, so that valgrind and the strict allocator
+ * can still catch misuse of them.
+ */
+#define PROTO_ARENA_CHUNK_SIZE	(64 * 1024)
+#define PROTO_ARENA_CACHE_MAX	64	/* chunks kept for the next tree */
+
+typedef struct _proto_arena {
+	GPtrArray	*chunks;	/* chunks owned by the tree */
+	unsigned	 in_use;	/* number of chunks in use */
+	size_t		 used;		/* bytes used in the last chunk in use */
+} proto_arena_t;
+
+/*
+ * Chunks of freed trees, waiting to be reused. Trees can be built and
+ * freed on more than one thread, so the cache is only touched with
+ * proto_arena_cache_mtx held; that happens once per chunk, not once
+ * per node.
+ */
+static GPtrArray *proto_arena_cache;
+static GMutex proto_arena_cache_mtx;
+static bool proto_arena_disabled;
+
+static void *
+proto_arena_alloc(proto_tree *tree, size_t size)
+{
+	tree_data_t *tree_data = PTREE_DATA(tree);
+	proto_arena_t *arena = tree_data->arena;
+	void *chunk;
+
+	if (proto_arena_disabled)
+		return wmem_alloc(PNODE_POOL(tree), size);
+
+	size = WS_ROUNDUP_8(size);
+	if (arena == NULL) {
+		arena = g_new(proto_arena_t, 1);
+		arena->chunks = g_ptr_array_new();
+		arena->in_use = 0;
+		arena->used = PROTO_ARENA_CHUNK_SIZE;
+		tree_data->arena = arena;
+	}
+	if (arena->used + size > PROTO_ARENA_CHUNK_SIZE) {
+		if (arena->in_use == arena->chunks->len) {
+			chunk = NULL;
+			g_mutex_lock(&proto_arena_cache_mtx);
+			if (proto_arena_cache != NULL && proto_arena_cache->len > 0) {
+				chunk = g_ptr_array_index(proto_arena_cache,
+				    proto_arena_cache->len - 1);
+				g_ptr_array_set_size(proto_arena_cache,
+				    proto_arena_cache->len - 1);
+			}
+			g_mutex_unlock(&proto_arena_cache_mtx);
+			if (chunk == NULL)
+				chunk = g_malloc(PROTO_ARENA_CHUNK_SIZE);
+			g_ptr_array_add(arena->chunks, chunk);
+		}
+		arena->in_use++;
+		arena->used = 0;
+	}
+	chunk = g_ptr_array_index(arena->chunks, arena->in_use - 1);
+	arena->used += size;
+	return (uint8_t *)chunk + arena->used - size;
+}
+
+/* Release everything allocated from the tree's arena, keeping the chunks. */
+static void
+proto_arena_reset(tree_data_t *tree_data)
+{
+	proto_arena_t *arena = tree_data->arena;
+
+	if (arena == NULL)
+		return;
+	arena->in_use = 0;
+	arena->used = PROTO_ARENA_CHUNK_SIZE;
+}
+
+static void
+proto_arena_free(tree_data_t *tree_data)
+{
+	proto_arena_t *arena = tree_data->arena;
+
+	if (arena == NULL)
+		return;
+	g_mutex_lock(&proto_arena_cache_mtx);
+	if (proto_arena_cache == NULL)
+		proto_arena_cache = g_ptr_array_new();
+	for (unsigned i = 0; i < arena->chunks->len; i++) {
+		if (proto_arena_cache->len < PROTO_ARENA_CACHE_MAX) {
+			g_ptr_array_add(proto_arena_cache, g_ptr_array_index(arena->chunks, i));
+			g_ptr_array_index(arena->chunks, i) = NULL;
+		}
+	}
+	g_mutex_unlock(&proto_arena_cache_mtx);
+	/* Free whatever didn't fit in the cache outside the lock. */
+	g_ptr_array_foreach(arena->chunks, (GFunc)g_free, NULL);
+	g_ptr_array_free(arena->chunks, true);
+	g_free(arena);
+	tree_data->arena = NULL;
+}
+
 /* Contains information about a field when a dissector calls
  * proto_tree_add_item.  */
-#define FIELD_INFO_NEW(pool, fi)  fi = wmem_new(pool, field_info)
-#define FIELD_INFO_FREE(pool, fi) wmem_free(pool, fi)
+#define FIELD_INFO_NEW(tree, fi) \
+	fi = (field_info *)proto_arena_alloc(tree, sizeof(field_info))
 
 /* Contains the space for proto_nodes. */
+#define PROTO_NODE_NEW(tree, node) \
+	node = (proto_node *)proto_arena_alloc(tree, sizeof(proto_node))
+
 #define PROTO_NODE_INIT(node)			\
 	node->first_child = NULL;		\
 	node->last_child = NULL;		\
 	node->next = NULL;
 
-#define PROTO_NODE_FREE(pool, node)			\
-	wmem_free(pool, node)
-
 /* String space for protocol and field items for the GUI */
 #define ITEM_LABEL_NEW(pool, il)			\
 	il = wmem_new(pool, item_label_t);		\
@@ -582,6 +692,8 @@ proto_init(GSList *register_all_plugin_protocols_list,
 	proto_cleanup_base();
 	saved_dir_queue = g_queue_new();
 
+	proto_arena_disabled = g_getenv("WIRESHARK_DEBUG_WMEM_OVERRIDE") != NULL;
+
 	proto_names        = g_hash_table_new(wmem_str_hash, g_str_equal);
 	proto_short_names  = g_hash_table_new(wmem_str_hash, g_str_equal);
 	proto_filter_names = g_hash_table_new(wmem_str_hash, g_str_equal);
@@ -768,6 +880,14 @@ proto_cleanup(void)
 	proto_free_deregistered_fields();
 	proto_cleanup_base();
 
+	g_mutex_lock(&proto_arena_cache_mtx);
+	if (proto_arena_cache != NULL) {
+		g_ptr_array_foreach(proto_arena_cache, (GFunc)g_free, NULL);
+		g_ptr_array_free(proto_arena_cache, true);
+		proto_arena_cache = NULL;
+	}
+	g_mutex_unlock(&proto_arena_cache_mtx);
+
 	g_slist_free(dissector_plugins);
 	dissector_plugins = NULL;
 }
@@ -926,6 +1046,9 @@ proto_tree_reset(proto_tree *tree)
 	tree_data->max_start = 0;
 	tree_data->start_idle_count = 0;
 
+	/* The nodes are all gone now; reuse their memory */
+	proto_arena_reset(tree_data);
+
 	PROTO_NODE_INIT(tree);
 }
 
@@ -947,6 +1070,8 @@ proto_tree_free(proto_tree *tree)
 		g_hash_table_destroy(tree_data->interesting_hfids);
 	}
 
+	proto_arena_free(tree_data);
+
 	g_slice_free(tree_data_t, tree_data);
 
 	g_slice_free(proto_tree, tree);
@@ -6466,7 +6591,7 @@ proto_tree_add_fake_node(proto_tree *tree, const header_field_info *hfinfo)
 		/* XXX - is it safe to continue here? */
 	}
 
-	pnode = wmem_new(PNODE_POOL(tree), proto_node);
+	PROTO_NODE_NEW(tree, pnode);
 	PROTO_NODE_INIT(pnode);
 	pnode->parent = tnode;
 	PNODE_HFINFO(pnode) = hfinfo;
@@ -6542,7 +6667,7 @@ proto_tree_add_node(proto_tree *tree, field_info *fi)
 		/* XXX - is it safe to continue here? */
 	}
 
-	pnode = wmem_new(PNODE_POOL(tree), proto_node);
+	PROTO_NODE_NEW(tree, pnode);
 	PROTO_NODE_INIT(pnode);
 	pnode->parent = tnode;
 	PNODE_HFINFO(pnode) = fi->hfinfo;
@@ -6886,7 +7011,7 @@ new_field_info(proto_tree *tree, header_field_info *hfinfo, tvbuff_t *tvb,
 {
 	field_info *fi;
 
-	FIELD_INFO_NEW(PNODE_POOL(tree), fi);
+	FIELD_INFO_NEW(tree, fi);
 
 	fi->hfinfo     = hfinfo;
 	fi->start      = start;
@@ -8038,6 +8163,7 @@ proto_tree_create_root(packet_info *pinfo)
 
 	/* Don't initialize the tree_data_t. Wait until we know we need it */
 	pnode->tree_data->interesting_hfids = NULL;
+	pnode->tree_data->arena = NULL;
 
 	/* Set the default to false so it's easier to
 	 * find errors; if we expect to see the protocol tree
@@ -890,10 +890,13 @@ typedef struct
 #define FI_GET_BITS_OFFSET(fi) (FI_GET_FLAG(fi, FI_BITS_OFFSET(63)) >> 5)
 #define FI_GET_BITS_SIZE(fi)   (FI_GET_FLAG(fi, FI_BITS_SIZE(63)) >> 12)
 
+struct _proto_arena;
+
 /** One of these exists for the entire protocol tree. Each proto_node
  * in the protocol tree points to the same copy. */
 typedef struct {
     GHashTable          *interesting_hfids;
+    struct _proto_arena *arena;         /**< memory for the tree's nodes; private to proto.c */
     bool                 visible;
     bool                 fake_protocols;
     unsigned             count;
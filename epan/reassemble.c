@@ -9,7 +9,9 @@
  */
 
 #include "config.h"
+#define WS_LOG_DOMAIN LOG_DOMAIN_EPAN
 
+#include <errno.h>
 #include <string.h>
 
 #include <epan/packet.h>
@@ -17,7 +19,10 @@
 #include <epan/reassemble.h>
 #include <epan/tvbuff-int.h>
 
+#include <wsutil/file_util.h>
 #include <wsutil/str_util.h>
+#include <wsutil/tempfile.h>
+#include <wsutil/wslog.h>
 #include <wsutil/ws_assert.h>
 
 /*
@@ -333,6 +338,7 @@ free_all_fragments(void *key_arg _U_, void *value, void *user_data _U_)
 	 */
 	fd_head = (fragment_head *)value;
 	if (fd_head != NULL) {
+		spill_forget(fd_head);
 		fd_i = fd_head->next;
 		if(fd_head->tvb_data && !(fd_head->flags&FD_SUBSET_TVB))
 			tvb_free(fd_head->tvb_data);
@@ -350,6 +356,283 @@ free_all_fragments(void *key_arg _U_, void *value, void *user_data _U_)
 	return TRUE;
 }
 
+/*
+ * Spilling of reassembled data to disk.
+ *
+ * If a memory limit has been set with reassembly_set_memory_limit(),
+ * the reassembled data of completed reassemblies (i.e. those that were
+ * moved to a reassembled table) is accounted for, and when the total
+ * exceeds the limit the least recently used buffers are written to a
+ * temporary file and freed. The data is read back the next time the
+ * reassembly is looked up, e.g. on the second pass or when a packet is
+ * dissected again.
+ *
+ * Buffers used by the frame currently being dissected are never spilled.
+ */
+typedef struct {
+	fragment_head *fd_head;
+	GList link;		/* in spill_lru, if the data is in memory */
+	uint32_t len;
+	uint32_t last_frame;	/* last frame in which the data was used */
+	int64_t offset;		/* offset in the spill file, or -1 if in memory */
+} spill_entry;
+
+static size_t reassembly_memory_limit;
+static size_t reassembly_memory_used;
+
+/* fragment_head * -> spill_entry * */
+static GHashTable *spill_entries;
+/* In-memory entries, least recently used first */
+static GQueue spill_lru = G_QUEUE_INIT;
+
+static int spill_fd = -1;
+static char *spill_path;
+static int64_t spill_file_end;
+
+static const char spill_read_error[] = "Reassembled data couldn't be read back from the spill file";
+
+void
+reassembly_set_memory_limit(size_t limit)
+{
+	reassembly_memory_limit = limit;
+}
+
+size_t
+reassembly_get_memory_used(void)
+{
+	return reassembly_memory_used;
+}
+
+static void
+spill_file_close(void)
+{
+	if (spill_fd != -1) {
+		ws_close(spill_fd);
+		spill_fd = -1;
+	}
+	if (spill_path != NULL) {
+		ws_unlink(spill_path);
+		g_free(spill_path);
+		spill_path = NULL;
+	}
+	spill_file_end = 0;
+}
+
+/*
+ * Write an entry's data to the spill file and free it.
+ * Returns false if the data couldn't be written.
+ */
+static bool
+spill_entry_write(spill_entry *entry)
+{
+	fragment_head *fd_head = entry->fd_head;
+	const uint8_t *data;
+	uint32_t done;
+	ws_file_ssize_t nwritten;
+
+	if (spill_fd == -1) {
+		GError *err = NULL;
+
+		spill_fd = create_tempfile(NULL, &spill_path, "wireshark_reassembly", NULL, &err);
+		if (spill_fd == -1) {
+			ws_warning("Can't create reassembly spill file: %s", err->message);
+			g_error_free(err);
+			return false;
+		}
+	}
+
+	data = tvb_get_ptr(fd_head->tvb_data, 0, entry->len);
+	if (ws_lseek64(spill_fd, spill_file_end, SEEK_SET) == -1) {
+		ws_warning("Can't seek in reassembly spill file %s: %s", spill_path, g_strerror(errno));
+		return false;
+	}
+	for (done = 0; done < entry->len; done += (uint32_t)nwritten) {
+		nwritten = ws_write(spill_fd, data + done, entry->len - done);
+		if (nwritten <= 0) {
+			ws_warning("Can't write to reassembly spill file %s: %s", spill_path, g_strerror(errno));
+			return false;
+		}
+	}
+
+	entry->offset = spill_file_end;
+	spill_file_end += entry->len;
+
+	tvb_free(fd_head->tvb_data);
+	fd_head->tvb_data = NULL;
+	return true;
+}
+
+/*
+ * Spill the least recently used data until we're within the memory
+ * limit, without touching anything used by the current frame.
+ */
+static void
+spill_enforce_limit(const uint32_t frame)
+{
+	GList *link;
+	spill_entry *entry;
+
+	while (reassembly_memory_used > reassembly_memory_limit &&
+	       (link = g_queue_peek_head_link(&spill_lru)) != NULL) {
+		entry = (spill_entry *)link->data;
+		if (entry->last_frame == frame) {
+			break;
+		}
+		if (entry->fd_head->tvb_data != NULL && !spill_entry_write(entry)) {
+			/* Keep the data in memory and stop trying. */
+			reassembly_memory_limit = 0;
+			break;
+		}
+		g_queue_unlink(&spill_lru, link);
+		reassembly_memory_used -= entry->len;
+	}
+}
+
+/*
+ * Start accounting for the reassembled data of a completed reassembly.
+ */
+static void
+spill_track(fragment_head *fd_head, const uint32_t frame)
+{
+	fragment_item *fd_i;
+	spill_entry *entry;
+	unsigned len;
+
+	if (reassembly_memory_limit == 0 || fd_head->tvb_data == NULL ||
+	    (fd_head->flags & FD_SUBSET_TVB)) {
+		return;
+	}
+	/* Don't spill data that fragment items still point into. */
+	for (fd_i = fd_head->next; fd_i; fd_i = fd_i->next) {
+		if (fd_i->flags & FD_SUBSET_TVB)
+			return;
+	}
+	len = tvb_captured_length(fd_head->tvb_data);
+	if (len == 0 || len != tvb_reported_length(fd_head->tvb_data)) {
+		return;
+	}
+
+	if (spill_entries == NULL) {
+		spill_entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+	entry = (spill_entry *)g_hash_table_lookup(spill_entries, fd_head);
+	if (entry != NULL) {
+		/* Already accounted for; just mark it as used. */
+		entry->last_frame = frame;
+		if (entry->offset == -1) {
+			g_queue_unlink(&spill_lru, &entry->link);
+			g_queue_push_tail_link(&spill_lru, &entry->link);
+		}
+		return;
+	}
+
+	entry = g_new0(spill_entry, 1);
+	entry->fd_head = fd_head;
+	entry->link.data = entry;
+	entry->len = len;
+	entry->last_frame = frame;
+	entry->offset = -1;
+	g_hash_table_insert(spill_entries, fd_head, entry);
+	g_queue_push_tail_link(&spill_lru, &entry->link);
+	reassembly_memory_used += len;
+
+	spill_enforce_limit(frame);
+}
+
+/*
+ * Make sure a reassembly's data is in memory, reading it back from the
+ * spill file if necessary, and mark it as used by the current frame.
+ *
+ * If the data can't be read back, the reassembly is marked as failed and
+ * ReassemblyError is thrown; the data stays in the file, so a later
+ * lookup tries again.
+ */
+static fragment_head *
+spill_restore(fragment_head *fd_head, const uint32_t frame)
+{
+	spill_entry *entry;
+	uint8_t *data;
+	uint32_t done;
+	ws_file_ssize_t nread;
+
+	if (fd_head == NULL || spill_entries == NULL) {
+		return fd_head;
+	}
+	entry = (spill_entry *)g_hash_table_lookup(spill_entries, fd_head);
+	if (entry == NULL) {
+		return fd_head;
+	}
+	entry->last_frame = frame;
+
+	if (entry->offset == -1) {
+		g_queue_unlink(&spill_lru, &entry->link);
+		g_queue_push_tail_link(&spill_lru, &entry->link);
+		return fd_head;
+	}
+
+	data = (uint8_t *)g_malloc(entry->len);
+	if (ws_lseek64(spill_fd, entry->offset, SEEK_SET) == -1) {
+		ws_warning("Can't seek in reassembly spill file %s: %s", spill_path, g_strerror(errno));
+		goto fail;
+	}
+	for (done = 0; done < entry->len; done += (uint32_t)nread) {
+		nread = ws_read(spill_fd, data + done, entry->len - done);
+		if (nread <= 0) {
+			ws_warning("Can't read from reassembly spill file %s: %s", spill_path,
+			    nread == 0 ? "unexpected end of file" : g_strerror(errno));
+			goto fail;
+		}
+	}
+	if (fd_head->error == spill_read_error) {
+		fd_head->error = NULL;
+	}
+	fd_head->tvb_data = tvb_new_real_data(data, entry->len, entry->len);
+	tvb_set_free_cb(fd_head->tvb_data, g_free);
+
+	/* The space in the file isn't reused; it goes away with the file. */
+	entry->offset = -1;
+	g_queue_push_tail_link(&spill_lru, &entry->link);
+	reassembly_memory_used += entry->len;
+
+	if (reassembly_memory_limit != 0) {
+		spill_enforce_limit(frame);
+	}
+	return fd_head;
+
+fail:
+	g_free(data);
+	fd_head->error = spill_read_error;
+	THROW_MESSAGE(ReassemblyError, fd_head->error);
+}
+
+/*
+ * Stop accounting for a reassembly that is being freed.
+ */
+static void
+spill_forget(fragment_head *fd_head)
+{
+	spill_entry *entry;
+
+	if (spill_entries == NULL) {
+		return;
+	}
+	entry = (spill_entry *)g_hash_table_lookup(spill_entries, fd_head);
+	if (entry == NULL) {
+		return;
+	}
+	if (entry->offset == -1) {
+		g_queue_unlink(&spill_lru, &entry->link);
+		reassembly_memory_used -= entry->len;
+	}
+	g_hash_table_remove(spill_entries, fd_head);
+	g_free(entry);
+
+	if (g_hash_table_size(spill_entries) == 0) {
+		/* Nothing refers to the spill file any more. */
+		spill_file_close();
+	}
+}
+
 /* ------------------------- */
 static fragment_head *new_head(const uint32_t flags)
 {
@@ -373,6 +656,7 @@ free_fd_head(fragment_head *fd_head)
 {
 	fragment_item *fd_i, *tmp;
 
+	spill_forget(fd_head);
 	if (fd_head->flags & FD_SUBSET_TVB)
 		fd_head->tvb_data = NULL;
 	if (fd_head->tvb_data)
@@ -660,7 +944,7 @@ fragment_get_reassembled_id(reassembly_table *table, const packet_info *pinfo,
 	/* create key to search hash with */
 	key.frame = pinfo->num;
 	key.id = id;
-	fd_head = (fragment_head *)g_hash_table_lookup(table->reassembled_table, &key);
+	fd_head = spill_restore((fragment_head *)g_hash_table_lookup(table->reassembled_table, &key), pinfo->num);
 
 	return fd_head;
 }
@@ -1053,6 +1337,7 @@ fragment_reassembled(reassembly_table *table, fragment_head *fd_head,
 	fd_head->flags |= FD_DEFRAGMENTED;
 	fd_head->reassembled_in = pinfo->num;
 	fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+	spill_track(fd_head, pinfo->num);
 }
 
 /*
@@ -1091,6 +1376,7 @@ fragment_reassembled_single(reassembly_table *table, fragment_head *fd_head,
 	fd_head->flags |= FD_DEFRAGMENTED;
 	fd_head->reassembled_in = pinfo->num;
 	fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+	spill_track(fd_head, pinfo->num);
 }
 
 static void
@@ -1776,7 +2062,7 @@ fragment_add_check_with_fallback(reassembly_table *table, tvbuff_t *tvb, const i
 	if (pinfo->fd->visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		return (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		return spill_restore((fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key), pinfo->num);
 	}
 
 	/* Looks up a key in the GHashTable, returning the original key and the associated value
@@ -1788,7 +2074,7 @@ fragment_add_check_with_fallback(reassembly_table *table, tvbuff_t *tvb, const i
 		/* Check if there is completed reassembly reachable from fallback frame */
 		reass_key.frame = fallback_frame;
 		reass_key.id = id;
-		fd_head = (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		fd_head = spill_restore((fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key), pinfo->num);
 		if (fd_head != NULL) {
 			/* Found completely reassembled packet, hash it with current frame number */
 			reassembled_key *new_key = g_slice_new(reassembled_key);
@@ -2348,7 +2634,7 @@ fragment_add_seq_check_work(reassembly_table *table, tvbuff_t *tvb,
 	if (pinfo->fd->visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		return (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		return spill_restore((fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key), pinfo->num);
 	}
 
 	fd_head = fragment_add_seq_common(table, tvb, offset, pinfo, id, data,
@@ -2504,7 +2790,7 @@ fragment_add_seq_single_work(reassembly_table *table, tvbuff_t *tvb,
 	if (pinfo->fd->visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		fh = (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		fh = spill_restore((fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key), pinfo->num);
 		return fh;
 	}
 	/* First let's figure out where we want to add our new fragment */
@@ -2798,7 +3084,7 @@ fragment_end_seq_next(reassembly_table *table, const packet_info *pinfo,
 	if (pinfo->fd->visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		return (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		return spill_restore((fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key), pinfo->num);
 	}
 
 	fd_head = lookup_fd_head(table, pinfo, id, data, &orig_key);
@@ -3171,6 +3457,42 @@ reassembly_table_cleanup_reg_tables(void)
 	g_list_foreach(reassembly_table_list, reassembly_table_cleanup_reg_table, NULL);
 }
 
+static gboolean
+fragment_is_idle(void *key _U_, void *value, void *user_data)
+{
+	const fragment_head *fd_head = (const fragment_head *)value;
+	const uint32_t oldest_frame = GPOINTER_TO_UINT(user_data);
+
+	if (fd_head->frame >= oldest_frame)
+		return FALSE;
+	return free_all_fragments(key, value, NULL);
+}
+
+static gboolean
+reassembled_is_idle(void *key, void *value _U_, void *user_data)
+{
+	const reassembled_key *rkey = (const reassembled_key *)key;
+
+	return rkey->frame < GPOINTER_TO_UINT(user_data);
+}
+
+static void
+reassembly_table_evict_reg_table(void *p, void *user_data)
+{
+	reassembly_table *table = ((register_reassembly_table_t*)p)->table;
+
+	if (table->fragment_table != NULL)
+		g_hash_table_foreach_remove(table->fragment_table, fragment_is_idle, user_data);
+	if (table->reassembled_table != NULL)
+		g_hash_table_foreach_remove(table->reassembled_table, reassembled_is_idle, user_data);
+}
+
+void
+reassembly_tables_evict_idle(const uint32_t oldest_frame)
+{
+	g_list_foreach(reassembly_table_list, reassembly_table_evict_reg_table, GUINT_TO_POINTER(oldest_frame));
+}
+
 void reassembly_tables_init(void)
 {
 	register_init_routine(&reassembly_table_init_reg_tables);
@@ -3323,7 +3645,7 @@ reassemble_streaming_data_and_call_subdissector(
 			reassembly_id = reassembly_info->last_msp->streaming_reassembly_id;
 			frag_offset = reassembly_info->last_msp->length;
 			if (reassembly_info->frame_num_frag_offset_map == NULL) {
-				reassembly_info->frame_num_frag_offset_map = wmem_map_new(wmem_file_scope(), g_int64_hash, g_int64_equal);
+				reassembly_info->frame_num_frag_offset_map = wmem_map_new_flat(wmem_file_scope(), g_int64_hash, g_int64_equal);
 			}
 			frame_ptr = (uint64_t*)wmem_memdup(wmem_file_scope(), &cur_frame_num, sizeof(uint64_t));
 			wmem_map_insert(reassembly_info->frame_num_frag_offset_map, frame_ptr, GUINT_TO_POINTER(frag_offset));
@@ -3523,7 +3845,7 @@ reassemble_streaming_data_and_call_subdissector(
 			cur_msp->prev_msp = reassembly_info->last_msp;
 			reassembly_info->last_msp = cur_msp;
 			if (reassembly_info->multisegment_pdus == NULL) {
-				reassembly_info->multisegment_pdus = wmem_map_new(wmem_file_scope(), g_int64_hash, g_int64_equal);
+				reassembly_info->multisegment_pdus = wmem_map_new_flat(wmem_file_scope(), g_int64_hash, g_int64_equal);
 			}
 			frame_ptr = (uint64_t*)wmem_memdup(wmem_file_scope(), &cur_frame_num, sizeof(uint64_t));
 			wmem_map_insert(reassembly_info->multisegment_pdus, frame_ptr, cur_msp);
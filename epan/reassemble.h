@@ -186,6 +186,29 @@ reassembly_table_init(reassembly_table *table,
 WS_DLL_PUBLIC void
 reassembly_table_destroy(reassembly_table *table);
 
+/*
+ * Set a limit, in bytes, on the memory used by the data of completed
+ * reassemblies in all reassembly tables. When the limit is exceeded, the
+ * least recently used reassembled data is written to a temporary file
+ * and read back the next time the reassembly is looked up; if it can't be
+ * read back, the lookup throws ReassemblyError. 0, the default, means no
+ * limit.
+ *
+ * Only the reassembly lookup functions read spilled data back, so callers
+ * that keep a fragment_head, or a tvbuff created from one, across packets
+ * (e.g. a GUI that keeps the tree of the selected packet while dissecting
+ * others) must not set a limit.
+ */
+WS_DLL_PUBLIC void
+reassembly_set_memory_limit(size_t limit);
+
+/*
+ * Get the number of bytes of reassembled data currently held in memory
+ * and accounted against the limit set with reassembly_set_memory_limit().
+ */
+WS_DLL_PUBLIC size_t
+reassembly_get_memory_used(void);
+
 /*
  * This function adds a new fragment to the reassembly table
  * If this is the first fragment seen for this datagram, a new entry
@@ -553,6 +576,17 @@ WS_DLL_PUBLIC bool
 show_fragment_seq_tree(fragment_head *ipfd_head, const fragment_items *fit,
     proto_tree *tree, packet_info *pinfo, tvbuff_t *tvb, proto_item **fi);
 
+/*
+ * Free the partial and completed reassemblies in all registered reassembly
+ * tables that haven't had a fragment added since before oldest_frame, and
+ * the reassembled-table entries for frames before oldest_frame.
+ *
+ * This is only meaningful when packets are dissected once, in order, as
+ * the reassemblies of frames before oldest_frame can no longer be found.
+ */
+WS_DLL_PUBLIC void
+reassembly_tables_evict_idle(const uint32_t oldest_frame);
+
 /* Initialize internal structures
  */
 extern void reassembly_tables_init(void);
@@ -3203,6 +3203,202 @@ test_fragment_add_check_duplicate_conflict(void)
         print_fragment_table();
     }
 }
+/**********************************************************************************
+ *
+ * reassembly_set_memory_limit
+ *
+ *********************************************************************************/
+
+/* With a memory limit smaller than any reassembly, checks that completed
+ * reassemblies are written to the spill file once they're no longer used by
+ * the current frame, and that the data read back on a later pass is the
+ * data that was reassembled.
+ *
+ *    id  frame  frag_off  len  more  tvb_offset
+ *    30     1       0      50   T       10
+ *    30     2      50      40   F       60   (completes 30)
+ *    31     3       0      30   T      100
+ *    31     4      30      70   F      130   (completes 31, spills 30)
+ */
+static void
+test_fragment_add_check_spill(void)
+{
+    fragment_head *fd_head, *fdh30, *fdh31;
+
+    printf("Starting test test_fragment_add_check_spill\n");
+
+    reassembly_set_memory_limit(1);
+
+    pinfo.num = 1;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 10, &pinfo, 30,
+                               NULL, 0, 50, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fdh30=fragment_add_check(&test_reassembly_table, tvb, 60, &pinfo, 30,
+                             NULL, 50, 40, false);
+    ASSERT_NE_POINTER(NULL,fdh30);
+    ASSERT_EQ(90,fdh30->datalen);
+    /* Still in use by this frame, so it stays in memory. */
+    ASSERT_NE_POINTER(NULL,fdh30->tvb_data);
+    ASSERT_EQ(90,reassembly_get_memory_used());
+
+    pinfo.num = 3;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 100, &pinfo, 31,
+                               NULL, 0, 30, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 4;
+    fdh31=fragment_add_check(&test_reassembly_table, tvb, 130, &pinfo, 31,
+                             NULL, 30, 70, false);
+    ASSERT_NE_POINTER(NULL,fdh31);
+    ASSERT_EQ(100,fdh31->datalen);
+    ASSERT_NE_POINTER(NULL,fdh31->tvb_data);
+    ASSERT_EQ_POINTER(NULL,fdh30->tvb_data);
+    ASSERT_EQ(100,reassembly_get_memory_used());
+
+    if (debug) {
+        print_tables();
+    }
+
+    /* Second pass: 30 is read back and 31 spilled in its place. */
+    pinfo.fd->visited = 1;
+    pinfo.num = 1;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 10, &pinfo, 30,
+                               NULL, 0, 50, true);
+    ASSERT_EQ_POINTER(fdh30,fd_head);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ_POINTER(NULL,fd_head->error);
+    ASSERT_EQ(90,tvb_captured_length(fd_head->tvb_data));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+60,40));
+    ASSERT_EQ_POINTER(NULL,fdh31->tvb_data);
+    ASSERT_EQ(90,reassembly_get_memory_used());
+
+    pinfo.num = 4;
+    fd_head=fragment_get_reassembled_id(&test_reassembly_table, &pinfo, 31);
+    ASSERT_EQ_POINTER(fdh31,fd_head);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ(100,tvb_captured_length(fd_head->tvb_data));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+100,30));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,30,data+130,70));
+    ASSERT_EQ_POINTER(NULL,fdh30->tvb_data);
+    ASSERT_EQ(100,reassembly_get_memory_used());
+
+    /* 30 again, from a different frame and a later place in the file. */
+    pinfo.num = 2;
+    fd_head=fragment_get_reassembled_id(&test_reassembly_table, &pinfo, 30);
+    ASSERT_EQ_POINTER(fdh30,fd_head);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+60,40));
+
+    reassembly_set_memory_limit(0);
+}
+
+/**********************************************************************************
+ *
+ * reassembly_tables_evict_idle
+ *
+ *********************************************************************************/
+
+/* Checks that reassembly_tables_evict_idle frees only the partial reassemblies
+ * whose newest fragment is older than oldest_frame, and only the reassembled
+ * table entries for frames before oldest_frame.
+ *
+ *    id  frame  frag_off  len  more  tvb_offset
+ *    12     1       0      50   T       10
+ *    20     2       0      40   T       20
+ *    20     3      40      30   F       30   (completes 20)
+ *    13     4       0      60   T       15
+ *    14     5       0      20   T        5
+ *    12     6      50      60   T        5
+ *    -- evict idle before frame 5 --
+ *    12     7     110      40   F       25   (completes 12)
+ */
+static void
+test_fragment_add_check_evict_idle(void)
+{
+    fragment_head *fd_head;
+
+    printf("Starting test test_fragment_add_check_evict_idle\n");
+
+    pinfo.num = 1;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 10, &pinfo, 12,
+                               NULL, 0, 50, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 20, &pinfo, 20,
+                               NULL, 0, 40, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 30, &pinfo, 20,
+                               NULL, 40, 30, false);
+    ASSERT_NE_POINTER(NULL,fd_head);
+
+    pinfo.num = 4;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 15, &pinfo, 13,
+                               NULL, 0, 60, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 5;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 5, &pinfo, 14,
+                               NULL, 0, 20, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 6;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 5, &pinfo, 12,
+                               NULL, 50, 60, true);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    ASSERT_EQ(3,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ(2,g_hash_table_size(test_reassembly_table.reassembled_table));
+
+    if (debug) {
+        print_tables();
+    }
+
+    reassembly_tables_evict_idle(5);
+
+    if (debug) {
+        print_tables();
+    }
+
+    /* 13 is idle; 14 had a fragment in frame 5 itself, and 12 had one in
+     * frame 6, even though its first fragment is older. */
+    ASSERT_EQ(2,g_hash_table_size(test_reassembly_table.fragment_table));
+    pinfo.num = 4;
+    ASSERT_EQ_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, 13, NULL));
+    pinfo.num = 5;
+    ASSERT_NE_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, 14, NULL));
+    pinfo.num = 6;
+    ASSERT_NE_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, 12, NULL));
+
+    /* Only 20's entry for frame 2 is gone; it can still be found from frame 3. */
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.reassembled_table));
+    pinfo.num = 2;
+    ASSERT_EQ_POINTER(NULL,fragment_get_reassembled_id(&test_reassembly_table, &pinfo, 20));
+    pinfo.num = 3;
+    fd_head=fragment_get_reassembled_id(&test_reassembly_table, &pinfo, 20);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(70,fd_head->datalen);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+20,40));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,40,data+30,30));
+
+    /* 12 still reassembles. */
+    pinfo.num = 7;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 25, &pinfo, 12,
+                               NULL, 110, 40, false);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(150,fd_head->datalen);
+    ASSERT_EQ(7,fd_head->reassembled_in);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+5,60));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,110,data+25,40));
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+}
+
 /**********************************************************************************
  *
  * main
@@ -3251,6 +3447,8 @@ main(int argc _U_, char **argv _U_)
         test_fragment_add_check_duplicate_last,
 #endif
         test_fragment_add_check_duplicate_conflict,
+        test_fragment_add_check_spill,
+        test_fragment_add_check_evict_idle,
     };
 
     /* a tvbuff for testing with */
@@ -3267,6 +3465,10 @@ main(int argc _U_, char **argv _U_)
     set_address(&pinfo.src,AT_IPv4,4,src);
     set_address(&pinfo.dst,AT_IPv4,4,dst);
 
+    /* reassembly_tables_evict_idle works on the registered tables */
+    reassembly_table_register(&test_reassembly_table,
+                              &addresses_reassembly_table_functions);
+
     /*************************************************************************/
     for(i=0; i < array_length(tests); i++ ) {
         /* re-init the fragment tables */
@@ -31,6 +31,7 @@
 #include "strutil.h"
 #include "stats_tree.h"
 #include <wsutil/ws_assert.h>
+#include <wsutil/glib-compat.h>
 
 enum _stat_tree_columns {
     COL_NAME,
@@ -214,6 +215,167 @@ stats_tree_reset(void *p)
     reset_stat_node(&st->root);
 }
 
+/* Internal function to merge the burst calculation data of one node into
+ * another: buckets for the same period are added together, and buckets
+ * that have fallen out of the burst window are dropped, as
+ * update_burst_calc() would have done had it seen both nodes' packets. */
+static void
+merge_burst_calc(stat_node *dst, const stat_node *src)
+{
+    burst_bucket *db, *sb, *bn;
+    double burstwin;
+
+    if (!prefs.st_enable_burstinfo) {
+        return;
+    }
+
+    /* The dummy bucket created at init time has bucket number 0, like
+     * the first real bucket; merging it adds nothing either way. */
+    db = dst->bh;
+    for (sb = src->bh; sb; sb = sb->next) {
+        if (sb->count == 0) {
+            continue;
+        }
+        while (db->next && db->next->bucket_no <= sb->bucket_no) {
+            db = db->next;
+        }
+        if (db->bucket_no == sb->bucket_no) {
+            db->count += sb->count;
+            if (db->start_time > sb->start_time) {
+                db->start_time = sb->start_time;
+            }
+        } else if (sb->bucket_no < db->bucket_no) {
+            /* Only possible at the head of the list */
+            bn = g_new0(burst_bucket, 1);
+            bn->count = sb->count;
+            bn->bucket_no = sb->bucket_no;
+            bn->start_time = sb->start_time;
+            bn->next = db;
+            db->prev = bn;
+            dst->bh = bn;
+            db = bn;
+        } else {
+            /* Insert after db */
+            bn = g_new0(burst_bucket, 1);
+            bn->count = sb->count;
+            bn->bucket_no = sb->bucket_no;
+            bn->start_time = sb->start_time;
+            bn->prev = db;
+            bn->next = db->next;
+            if (db->next) {
+                db->next->prev = bn;
+            } else {
+                dst->bt = bn;
+            }
+            db->next = bn;
+            db = bn;
+        }
+    }
+
+    /* Drop the buckets that are too old for the current window */
+    burstwin = prefs.st_burst_windowlen/prefs.st_burst_resolution;
+    while (dst->bh != dst->bt && dst->bt->bucket_no >= dst->bh->bucket_no + burstwin) {
+        bn = dst->bh;
+        dst->bh = bn->next;
+        dst->bh->prev = NULL;
+        g_free(bn);
+    }
+
+    dst->bcount = 0;
+    for (db = dst->bh; db; db = db->next) {
+        dst->bcount += db->count;
+    }
+
+    if (src->max_burst > dst->max_burst) {
+        dst->max_burst = src->max_burst;
+        dst->burst_time = src->burst_time;
+    }
+    if (dst->bcount > dst->max_burst) {
+        dst->max_burst = dst->bcount;
+        dst->burst_time = dst->bh->start_time;
+    }
+}
+
+/* merges the counters of a node, and those of its children, into another */
+static void
+// NOLINTNEXTLINE(misc-no-recursion)
+merge_stat_node(stats_tree *st, stat_node *dst, const stat_node *src)
+{
+    stat_node *src_child;
+    stat_node *dst_child;
+
+    dst->counter += src->counter;
+    switch (dst->datatype)
+    {
+    case STAT_DT_INT:
+        dst->total.int_total += src->total.int_total;
+        if (dst->minvalue.int_min > src->minvalue.int_min) {
+            dst->minvalue.int_min = src->minvalue.int_min;
+        }
+        if (dst->maxvalue.int_max < src->maxvalue.int_max) {
+            dst->maxvalue.int_max = src->maxvalue.int_max;
+        }
+        break;
+    case STAT_DT_FLOAT:
+        dst->total.float_total += src->total.float_total;
+        if (dst->minvalue.float_min > src->minvalue.float_min) {
+            dst->minvalue.float_min = src->minvalue.float_min;
+        }
+        if (dst->maxvalue.float_max < src->maxvalue.float_max) {
+            dst->maxvalue.float_max = src->maxvalue.float_max;
+        }
+        break;
+    }
+    dst->st_flags |= src->st_flags;
+
+    merge_burst_calc(dst, src);
+
+    for (src_child = src->children; src_child; src_child = src_child->next) {
+        /* Children are identified by name within their parent */
+        if (dst->hash) {
+            dst_child = (stat_node *)g_hash_table_lookup(dst->hash, src_child->name);
+        } else {
+            for (dst_child = dst->children; dst_child; dst_child = dst_child->next) {
+                if (strcmp(dst_child->name, src_child->name) == 0)
+                    break;
+            }
+        }
+
+        if (dst_child == NULL) {
+            /* Anything with children is registered as a parent */
+            ws_assert(dst->id >= 0);
+            dst_child = new_stat_node(st, src_child->name, dst->id, src_child->datatype,
+                                      src_child->hash != NULL, src_child->id >= 0);
+            if (src_child->rng) {
+                dst_child->rng = (range_pair_t *)g_memdup2(src_child->rng, sizeof(range_pair_t));
+            }
+        }
+
+        // Recursion is limited by proto.c checks
+        merge_stat_node(st, dst_child, src_child);
+    }
+}
+
+/* merges the statistics gathered by one stats_tree into another of the
+ * same kind, e.g. from separate shards of a capture */
+extern void
+stats_tree_merge(stats_tree *dst, const stats_tree *src)
+{
+    ws_assert(dst->cfg == src->cfg);
+
+    if (src->start >= 0.0) {
+        if (dst->start < 0.0 || src->start < dst->start) {
+            dst->start = src->start;
+        }
+        if (src->now > dst->now) {
+            dst->now = src->now;
+        }
+        dst->elapsed = dst->now - dst->start;
+    }
+
+    merge_stat_node(dst, &dst->root, &src->root);
+}
+
 extern void
 stats_tree_reinit(void *p)
 {
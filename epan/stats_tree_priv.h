@@ -185,6 +185,14 @@ WS_DLL_PUBLIC tap_packet_status stats_tree_packet(void*, packet_info*, epan_diss
 /** callback for reset */
 WS_DLL_PUBLIC void stats_tree_reset(void *p_st);
 
+/** merges the statistics of src into dst, which must be built from the same
+ *  stats_tree_cfg.  Nodes are matched by name under the same parent, and
+ *  the nodes that only src has are created in dst.  Times are taken as
+ *  they are, so both trees must have been built relative to the same
+ *  reference time.  The maximum burst is exact unless the busiest burst
+ *  window straddles the boundary between src's and dst's packets. */
+WS_DLL_PUBLIC void stats_tree_merge(stats_tree *dst, const stats_tree *src);
+
 /** callback for clear */
 WS_DLL_PUBLIC void stats_tree_reinit(void *p_st);
 
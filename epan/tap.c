@@ -92,12 +92,205 @@ typedef struct _tap_listener_t {
 	tap_packet_cb packet;
 	tap_draw_cb draw;
 	tap_finish_cb finish;
+	/* For listeners run on the tap listener thread; see set_tap_threaded(). */
+	tap_copy_cb copy;
+	tap_copied_packet_cb copied_packet;
+	GDestroyNotify free_copy;
+	int thread_redraw;	/* set by the listener thread */
+	int thread_failed;	/* set by the listener thread */
 } tap_listener_t;
 
 static tap_listener_t *tap_listener_queue;
 
 static GSList *tap_plugins;
 
+/*
+ * Listeners that have declared themselves thread-safe with
+ * set_tap_threaded() don't run on the dissection thread.  Instead,
+ * their copy routine takes what they need out of the packet, and the
+ * copy is handed through a ring to a listener thread that runs their
+ * packet routine.  This lets dissection carry on with the next packet
+ * while the statistics are being updated.
+ *
+ * The ring is a bounded multi-producer, single-consumer queue in which
+ * each slot carries a sequence number:  a producer claims a slot by
+ * advancing tap_ring_head when the slot's sequence number equals the
+ * head position, fills it in, and publishes it by setting the sequence
+ * number to position + 1.  The consumer frees it for reuse by setting
+ * the sequence number to position + TAP_RING_LEN.  Neither side takes
+ * a lock unless the listener thread has gone to sleep on an empty ring.
+ *
+ * The reset, draw and finish routines, and anything else that reads
+ * the listener's state, run on the main thread once the ring has been
+ * drained by flush_tap_listeners().
+ */
+#define TAP_RING_LEN 4096	/* must be a power of 2 */
+
+typedef struct _tap_ring_slot_t {
+	unsigned seq;
+	tap_listener_t *tl;
+	void *copy;
+} tap_ring_slot_t;
+
+static tap_ring_slot_t *tap_ring;
+static unsigned tap_ring_head;		/* next slot to be claimed by a producer */
+static unsigned tap_ring_tail;		/* next slot to be consumed */
+static unsigned tap_ring_done;		/* number of copies consumed */
+
+static GThread *tap_thread;
+static GMutex tap_thread_mutex;
+static GCond tap_thread_cond;		/* signalled when the ring is no longer empty */
+static GCond tap_flush_cond;		/* signalled when copies have been consumed */
+static int tap_thread_sleeping;
+static int tap_thread_flushing;
+static bool tap_thread_stop;
+
+static void
+tap_thread_wake(void)
+{
+	g_mutex_lock(&tap_thread_mutex);
+	g_cond_signal(&tap_thread_cond);
+	g_mutex_unlock(&tap_thread_mutex);
+}
+
+static void
+tap_ring_push(tap_listener_t *tl, void *copy)
+{
+	tap_ring_slot_t *slot;
+	unsigned pos, seq;
+
+	pos = g_atomic_int_get(&tap_ring_head);
+	for (;;) {
+		slot = &tap_ring[pos & (TAP_RING_LEN - 1)];
+		seq = g_atomic_int_get(&slot->seq);
+		if (seq == pos) {
+			if (g_atomic_int_compare_and_exchange(&tap_ring_head, pos, pos + 1))
+				break;
+		} else if ((int)(seq - pos) < 0) {
+			/* The ring is full; let the listener thread catch up. */
+			if (g_atomic_int_get(&tap_thread_sleeping))
+				tap_thread_wake();
+			g_thread_yield();
+		}
+		pos = g_atomic_int_get(&tap_ring_head);
+	}
+
+	slot->tl = tl;
+	slot->copy = copy;
+	g_atomic_int_set(&slot->seq, pos + 1);
+
+	if (g_atomic_int_get(&tap_thread_sleeping))
+		tap_thread_wake();
+}
+
+static void
+tap_thread_run_listener(tap_listener_t *tl, void *copy)
+{
+	tap_packet_status status;
+
+	if (!g_atomic_int_get(&tl->thread_failed)) {
+		status = tl->copied_packet(tl->tapdata, copy);
+
+		switch (status) {
+
+		case TAP_PACKET_DONT_REDRAW:
+			break;
+
+		case TAP_PACKET_REDRAW:
+			g_atomic_int_set(&tl->thread_redraw, 1);
+			break;
+
+		case TAP_PACKET_FAILED:
+			g_atomic_int_set(&tl->thread_failed, 1);
+			break;
+		}
+	}
+	if (tl->free_copy)
+		tl->free_copy(copy);
+}
+
+static void *
+tap_thread_func(void *data _U_)
+{
+	tap_ring_slot_t *slot;
+	tap_listener_t *tl;
+	void *copy;
+
+	for (;;) {
+		slot = &tap_ring[tap_ring_tail & (TAP_RING_LEN - 1)];
+		if (g_atomic_int_get(&slot->seq) != tap_ring_tail + 1) {
+			/*
+			 * The ring is empty.  Say we're going to sleep
+			 * before checking again, so that a producer
+			 * that publishes a slot in the meantime wakes us.
+			 */
+			g_mutex_lock(&tap_thread_mutex);
+			g_atomic_int_set(&tap_thread_sleeping, 1);
+			while (g_atomic_int_get(&slot->seq) != tap_ring_tail + 1 && !tap_thread_stop)
+				g_cond_wait(&tap_thread_cond, &tap_thread_mutex);
+			g_atomic_int_set(&tap_thread_sleeping, 0);
+			if (g_atomic_int_get(&slot->seq) != tap_ring_tail + 1) {
+				/* Told to stop, with nothing left to do. */
+				g_mutex_unlock(&tap_thread_mutex);
+				return NULL;
+			}
+			g_mutex_unlock(&tap_thread_mutex);
+		}
+
+		tl = slot->tl;
+		copy = slot->copy;
+		g_atomic_int_set(&slot->seq, tap_ring_tail + TAP_RING_LEN);
+		tap_ring_tail++;
+
+		tap_thread_run_listener(tl, copy);
+
+		g_atomic_int_inc(&tap_ring_done);
+		if (g_atomic_int_get(&tap_thread_flushing)) {
+			g_mutex_lock(&tap_thread_mutex);
+			g_cond_broadcast(&tap_flush_cond);
+			g_mutex_unlock(&tap_thread_mutex);
+		}
+	}
+}
+
+static void
+tap_thread_start(void)
+{
+	unsigned i;
+
+	if (tap_thread)
+		return;
+
+	tap_ring = g_new(tap_ring_slot_t, TAP_RING_LEN);
+	for (i = 0; i < TAP_RING_LEN; i++) {
+		tap_ring[i].seq = i;
+		tap_ring[i].tl = NULL;
+		tap_ring[i].copy = NULL;
+	}
+	tap_ring_head = 0;
+	tap_ring_tail = 0;
+	tap_ring_done = 0;
+	tap_thread_stop = false;
+	tap_thread = g_thread_new("Tap listeners", tap_thread_func, NULL);
+}
+
+static void
+tap_thread_end(void)
+{
+	if (!tap_thread)
+		return;
+
+	g_mutex_lock(&tap_thread_mutex);
+	tap_thread_stop = true;
+	g_cond_signal(&tap_thread_cond);
+	g_mutex_unlock(&tap_thread_mutex);
+	g_thread_join(tap_thread);
+	tap_thread = NULL;
+
+	g_free(tap_ring);
+	tap_ring = NULL;
+}
+
 #ifdef HAVE_PLUGINS
 void
 tap_register_plugin(const tap_plugin *plug)
@@ -386,6 +579,23 @@ tap_push_tapped_queue(epan_dissect_t *edt)
 						}
 					}
 
+					/* If the listener runs on the listener
+					 * thread, hand it a copy of what it
+					 * needs from this packet.
+					 */
+					if(tl->copied_packet){
+						void *copy;
+
+						if(g_atomic_int_get(&tl->thread_failed)){
+							continue;
+						}
+						copy = tl->copy(tl->tapdata, tp->pinfo, edt, tp->tap_specific_data, flags);
+						if(copy){
+							tap_ring_push(tl, copy);
+						}
+						continue;
+					}
+
 					/* So call the per-packet routine. */
 					tap_packet_status status;
 
@@ -454,6 +664,40 @@ fetch_tapped_data(int tap_id, int idx)
 	return NULL;
 }
 
+/* This function waits until the tap listener thread has processed all the
+   packets handed to it, and picks up the results of its packet routines.
+*/
+void
+flush_tap_listeners(void)
+{
+	tap_listener_t *tl;
+	unsigned target;
+
+	if(!tap_thread){
+		return;
+	}
+
+	target=g_atomic_int_get(&tap_ring_head);
+	g_mutex_lock(&tap_thread_mutex);
+	g_atomic_int_set(&tap_thread_flushing, 1);
+	while((int)(g_atomic_int_get(&tap_ring_done) - target) < 0){
+		g_cond_signal(&tap_thread_cond);
+		g_cond_wait(&tap_flush_cond, &tap_thread_mutex);
+	}
+	g_atomic_int_set(&tap_thread_flushing, 0);
+	g_mutex_unlock(&tap_thread_mutex);
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		if(g_atomic_int_get(&tl->thread_redraw)){
+			g_atomic_int_set(&tl->thread_redraw, 0);
+			tl->needs_redraw=true;
+		}
+		if(g_atomic_int_get(&tl->thread_failed)){
+			tl->failed=true;
+		}
+	}
+}
+
 /* This function is called when we need to reset all tap listeners, for example
    when we open/start a new capture or if we need to rescan the packet list.
 */
@@ -462,12 +706,15 @@ reset_tap_listeners(void)
 {
 	tap_listener_t *tl;
 
+	flush_tap_listeners();
+
 	for(tl=tap_listener_queue;tl;tl=tl->next){
 		if(tl->reset){
 			tl->reset(tl->tapdata);
 		}
 		tl->needs_redraw=true;
 		tl->failed=false;
+		g_atomic_int_set(&tl->thread_failed, 0);
 	}
 
 }
@@ -485,6 +732,8 @@ draw_tap_listeners(bool draw_all)
 {
 	tap_listener_t *tl;
 
+	flush_tap_listeners();
+
 	for(tl=tap_listener_queue;tl;tl=tl->next){
 		if(tl->needs_redraw || draw_all){
 			if(tl->draw){
@@ -607,6 +856,45 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 	return NULL;
 }
 
+/* this function moves the per-packet work of a tap listener onto the tap
+ * listener thread.
+ * function returns :
+ *     NULL: ok.
+ * non-NULL: error, return value points to GString containing error
+ *           message.
+ */
+GString *
+set_tap_threaded(void *tapdata, tap_copy_cb copy,
+		 tap_copied_packet_cb copied_packet, GDestroyNotify free_copy)
+{
+	tap_listener_t *tl;
+	GString *error_string;
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		if(tl->tapdata==tapdata){
+			break;
+		}
+	}
+	if(!tl){
+		error_string = g_string_new("no listener found with that tap data");
+		return error_string;
+	}
+	if(!copy || !copied_packet){
+		error_string = g_string_new("a copy and a packet routine are required");
+		return error_string;
+	}
+
+	/* Copies already queued were made for the old routines. */
+	flush_tap_listeners();
+
+	tap_thread_start();
+	tl->copy=copy;
+	tl->copied_packet=copied_packet;
+	tl->free_copy=free_copy;
+
+	return NULL;
+}
+
 /* this function sets a new dfilter to a tap listener
  */
 GString *
@@ -729,6 +1017,9 @@ remove_tap_listener(void *tapdata)
 		return;
 	}
 
+	/* The listener thread may still have copies for this listener. */
+	flush_tap_listeners();
+
 	if(tap_listener_queue->tapdata==tapdata){
 		tl=tap_listener_queue;
 		tap_listener_queue=tap_listener_queue->next;
@@ -860,6 +1151,9 @@ void tap_cleanup(void)
 	tap_dissector_t *elem_dl;
 	tap_dissector_t *head_dl = tap_dissector_list;
 
+	flush_tap_listeners();
+	tap_thread_end();
+
 	while(head_lq){
 		elem_lq = head_lq;
 		head_lq = head_lq->next;
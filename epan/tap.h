@@ -34,6 +34,8 @@ typedef void (*tap_reset_cb)(void *tapdata);
 typedef tap_packet_status (*tap_packet_cb)(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data, tap_flags_t flags);
 typedef void (*tap_draw_cb)(void *tapdata);
 typedef void (*tap_finish_cb)(void *tapdata);
+typedef void *(*tap_copy_cb)(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data, tap_flags_t flags);
+typedef tap_packet_status (*tap_copied_packet_cb)(void *tapdata, void *copy);
 
 /**
  * Flags to indicate what a tap listener's packet routine requires.
@@ -251,6 +253,43 @@ WS_DLL_PUBLIC GString *register_tap_listener(const char *tapname, void *tapdata,
     tap_packet_cb tap_packet, tap_draw_cb tap_draw,
     tap_finish_cb tap_finish) G_GNUC_WARN_UNUSED_RESULT;
 
+/**
+ * Run the per-packet work of a tap listener on the tap listener thread,
+ * rather than on the dissection thread.
+ *
+ * @param tapdata       the tapdata the listener was registered with.
+ * @param copy          void *(*copy)(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data, tap_flags_t flags)
+ *                      Called on the dissection thread, in place of the
+ *                      packet routine, for each packet that passes the
+ *                      listener's filters.  It must copy whatever the
+ *                      listener needs from pinfo, edt and data, none of
+ *                      which survive the packet, and return the copy;
+ *                      it may return NULL to skip the packet.  It must
+ *                      not modify *tapdata.
+ * @param copied_packet tap_packet_status (*copied_packet)(void *tapdata, void *copy)
+ *                      Called on the tap listener thread with each copy,
+ *                      in the order the packets were tapped.  It is the
+ *                      only routine that runs on that thread, so it may
+ *                      update *tapdata without locking.
+ * @param free_copy     Called on the tap listener thread to free each
+ *                      copy after it has been processed; may be NULL.
+ *
+ * The reset, draw and finish routines still run on the main thread, after
+ * flush_tap_listeners() has waited for all outstanding copies to be
+ * processed; reset_tap_listeners(), draw_tap_listeners() and
+ * remove_tap_listener() do that themselves.  Anything else that reads
+ * *tapdata must call flush_tap_listeners() first.
+ *
+ * @return NULL on success, or a GString containing an error message.
+ */
+WS_DLL_PUBLIC GString *set_tap_threaded(void *tapdata, tap_copy_cb copy,
+    tap_copied_packet_cb copied_packet, GDestroyNotify free_copy) G_GNUC_WARN_UNUSED_RESULT;
+
+/** Wait until the tap listener thread has processed all the packets that
+ * have been handed to it.
+ */
+WS_DLL_PUBLIC void flush_tap_listeners(void);
+
 /** This function sets a new dfilter to a tap listener */
 WS_DLL_PUBLIC GString *set_tap_dfilter(void *tapdata, const char *fstring);
 
@@ -10,6 +10,17 @@
 
 #include "strutil.h"
 #include <wsutil/utf8_entities.h>
+#include <wsutil/time_util.h>
+
+#include "epan.h"
+#include "packet.h"
+#include "packet_info.h"
+#include "prefs.h"
+#include "proto.h"
+#include "tvbuff.h"
+#include "conversation.h"
+#include "conversation_table.h"
+#include "stats_tree_priv.h"
 
 /*
  * FIXME: LABEL_LENGTH includes the nul byte terminator.
@@ -74,6 +85,492 @@ void test_label_escape_control(void)
     g_assert_cmpuint(pos, ==, strlen(dst));
 }
 
+/*
+ * Tests that need registered protocols share one epan_init(), which is
+ * cleaned up at the end of main().
+ */
+static bool epan_initialized;
+
+static void
+test_epan_init(void)
+{
+    if (!epan_initialized) {
+        if (!epan_init(NULL, NULL, false))
+            g_assert_not_reached();
+        epan_initialized = true;
+    }
+}
+
+/* A dissection session without a capture file, for file-scoped state. */
+static epan_t *
+test_epan_new(void)
+{
+    static const struct packet_provider_funcs funcs;
+
+    test_epan_init();
+    return epan_new(NULL, &funcs);
+}
+
+/*
+ * Builds protocol trees the way a dissector does for a full-tree
+ * dissection, and reports how many tree items per second are added,
+ * including resetting the tree and the packet pool between packets.
+ *
+ * NOTE: You have to run "test_epan -m perf" to run the performance tests.
+ */
+static void test_proto_tree_perf(void)
+{
+#define PERF_PACKETS 100000
+#define PERF_ITEMS   100        /* items per packet, in subtrees of 10 */
+    static int ett_perf;
+    static int *ett[] = { &ett_perf };
+    static const uint8_t data[64];
+    packet_info pinfo;
+    tvbuff_t *tvb;
+    proto_tree *root, *subtree, *group = NULL;
+    proto_item *ti;
+    int proto_frame, hf_frame_len;
+    double start_utime, start_stime, end_utime, end_stime, ms;
+
+    test_epan_init();
+    proto_register_subtree_array(ett, G_N_ELEMENTS(ett));
+    /* These are normally set when the preferences are read. */
+    prefs.gui_max_tree_items = 1 * 1000 * 1000;
+    prefs.gui_max_tree_depth = 5 * 100;
+
+    proto_frame = proto_get_id_by_filter_name("frame");
+    hf_frame_len = proto_registrar_get_id_byname("frame.len");
+    g_assert_cmpint(proto_frame, >, 0);
+    g_assert_cmpint(hf_frame_len, >, 0);
+
+    memset(&pinfo, 0, sizeof(pinfo));
+    pinfo.pool = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK_FAST);
+    tvb = tvb_new_real_data(data, sizeof(data), sizeof(data));
+    root = proto_tree_create_root(&pinfo);
+    proto_tree_set_visible(root, true);
+
+    get_resource_usage(&start_utime, &start_stime);
+    for (int p = 0; p < PERF_PACKETS; p++) {
+        ti = proto_tree_add_item(root, proto_frame, tvb, 0, -1, ENC_NA);
+        subtree = proto_item_add_subtree(ti, ett_perf);
+        for (int i = 0; i < PERF_ITEMS; i++) {
+            if (i % 10 == 0) {
+                ti = proto_tree_add_item(subtree, hf_frame_len, tvb, 0, 4, ENC_BIG_ENDIAN);
+                group = proto_item_add_subtree(ti, ett_perf);
+            } else {
+                proto_tree_add_item(group, hf_frame_len, tvb, 0, 4, ENC_BIG_ENDIAN);
+            }
+        }
+        proto_tree_reset(root);
+        wmem_free_all(pinfo.pool);
+    }
+    get_resource_usage(&end_utime, &end_stime);
+    ms = ((end_utime - start_utime) + (end_stime - start_stime)) * 1000.0;
+
+    g_test_maximized_result((double)PERF_PACKETS * (PERF_ITEMS + 1) / (ms / 1000.0),
+        "proto tree: %d packets of %d items in %.3f ms, %.0f items/s",
+        PERF_PACKETS, PERF_ITEMS + 1, ms,
+        (double)PERF_PACKETS * (PERF_ITEMS + 1) / (ms / 1000.0));
+
+    proto_tree_free(root);
+    tvb_free(tvb);
+    wmem_destroy_allocator(pinfo.pool);
+}
+
+/*
+ * Statistics merging: tap the same packets once as a whole and once as
+ * two shards, merge the shards, and check that the result is the same.
+ */
+#define MERGE_PACKETS 200
+
+typedef struct {
+    uint8_t src_host;
+    uint8_t dst_host;
+    uint16_t src_port;
+    uint16_t dst_port;
+    int len;
+    int secs;
+    bool passed;        /* matched the display filter */
+} merge_packet_t;
+
+static merge_packet_t merge_packets[MERGE_PACKETS];
+
+static void
+merge_packets_init(void)
+{
+    /* A handful of hosts and ports, so that conversations and endpoints
+     * are seen in both shards and in both directions. */
+    for (int i = 0; i < MERGE_PACKETS; i++) {
+        merge_packet_t *mp = &merge_packets[i];
+        bool reply = (i % 3) == 1;
+        uint8_t a = 1 + (i * 7) % 5;
+        uint8_t b = 1 + (i * 11) % 4;
+
+        mp->src_host = reply ? b : a;
+        mp->dst_host = reply ? a : b;
+        mp->src_port = reply ? 80 : 1024 + a;
+        mp->dst_port = reply ? 1024 + a : 80;
+        mp->len = 60 + (i * 37) % 1400;
+        mp->secs = i / 4;
+        mp->passed = (i % 5) != 0 && mp->src_host != 4;
+    }
+}
+
+static void
+tap_conversation(conv_hash_t *ch, const merge_packet_t *mp)
+{
+    uint8_t src_addr[4] = { 192, 0, 2, mp->src_host };
+    uint8_t dst_addr[4] = { 192, 0, 2, mp->dst_host };
+    address src, dst;
+    nstime_t ts = NSTIME_INIT_SECS(mp->secs);
+
+    set_address(&src, AT_IPv4, 4, src_addr);
+    set_address(&dst, AT_IPv4, 4, dst_addr);
+    ch->flags = mp->passed ? 0 : TL_DISPLAY_FILTER_IGNORED;
+    add_conversation_table_data(ch, &src, &dst, mp->src_port, mp->dst_port,
+            1, mp->len, &ts, &ts, NULL, CONVERSATION_TCP);
+}
+
+static void
+tap_endpoints(conv_hash_t *ch, const merge_packet_t *mp)
+{
+    uint8_t src_addr[4] = { 192, 0, 2, mp->src_host };
+    uint8_t dst_addr[4] = { 192, 0, 2, mp->dst_host };
+    address src, dst;
+
+    set_address(&src, AT_IPv4, 4, src_addr);
+    set_address(&dst, AT_IPv4, 4, dst_addr);
+    ch->flags = mp->passed ? 0 : TL_DISPLAY_FILTER_IGNORED;
+    add_endpoint_table_data(ch, &src, mp->src_port, true, 1, mp->len, NULL, ENDPOINT_TCP);
+    add_endpoint_table_data(ch, &dst, mp->dst_port, false, 1, mp->len, NULL, ENDPOINT_TCP);
+}
+
+static const conv_item_t *
+find_conv_item(const conv_hash_t *ch, const conv_item_t *want)
+{
+    for (unsigned i = 0; i < ch->conv_array->len; i++) {
+        const conv_item_t *item = &g_array_index(ch->conv_array, conv_item_t, i);
+
+        if (addresses_equal(&item->src_address, &want->src_address) &&
+            addresses_equal(&item->dst_address, &want->dst_address) &&
+            item->src_port == want->src_port && item->dst_port == want->dst_port) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void test_merge_conversation_table(void)
+{
+    int splits[] = { 0, 1, MERGE_PACKETS / 3, MERGE_PACKETS - 1, MERGE_PACKETS };
+
+    merge_packets_init();
+    for (unsigned s = 0; s < G_N_ELEMENTS(splits); s++) {
+        conv_hash_t whole = { 0 }, shard1 = { 0 }, shard2 = { 0 };
+
+        for (int i = 0; i < MERGE_PACKETS; i++) {
+            tap_conversation(&whole, &merge_packets[i]);
+            tap_conversation(i < splits[s] ? &shard1 : &shard2, &merge_packets[i]);
+        }
+        merge_conversation_table_data(&shard1, &shard2);
+
+        g_assert_nonnull(shard1.conv_array);
+        g_assert_cmpuint(shard1.conv_array->len, ==, whole.conv_array->len);
+        for (unsigned i = 0; i < whole.conv_array->len; i++) {
+            const conv_item_t *want = &g_array_index(whole.conv_array, conv_item_t, i);
+            const conv_item_t *got = find_conv_item(&shard1, want);
+
+            g_assert_nonnull(got);
+            g_assert_cmpuint(got->tx_frames, ==, want->tx_frames);
+            g_assert_cmpuint(got->rx_frames, ==, want->rx_frames);
+            g_assert_cmpuint(got->tx_bytes, ==, want->tx_bytes);
+            g_assert_cmpuint(got->rx_bytes, ==, want->rx_bytes);
+            g_assert_cmpuint(got->tx_frames_total, ==, want->tx_frames_total);
+            g_assert_cmpuint(got->rx_frames_total, ==, want->rx_frames_total);
+            g_assert_cmpuint(got->tx_bytes_total, ==, want->tx_bytes_total);
+            g_assert_cmpuint(got->rx_bytes_total, ==, want->rx_bytes_total);
+            g_assert_cmpint(nstime_cmp(&got->start_time, &want->start_time), ==, 0);
+            g_assert_cmpint(nstime_cmp(&got->stop_time, &want->stop_time), ==, 0);
+            g_assert_true(got->filtered == want->filtered);
+        }
+
+        reset_conversation_table_data(&whole);
+        reset_conversation_table_data(&shard1);
+        reset_conversation_table_data(&shard2);
+    }
+}
+
+static void test_merge_endpoint_table(void)
+{
+    int splits[] = { 0, 1, MERGE_PACKETS / 3, MERGE_PACKETS - 1, MERGE_PACKETS };
+
+    merge_packets_init();
+    for (unsigned s = 0; s < G_N_ELEMENTS(splits); s++) {
+        conv_hash_t whole = { 0 }, shard1 = { 0 }, shard2 = { 0 };
+
+        for (int i = 0; i < MERGE_PACKETS; i++) {
+            tap_endpoints(&whole, &merge_packets[i]);
+            tap_endpoints(i < splits[s] ? &shard1 : &shard2, &merge_packets[i]);
+        }
+        merge_endpoint_table_data(&shard1, &shard2);
+
+        g_assert_nonnull(shard1.conv_array);
+        g_assert_cmpuint(shard1.conv_array->len, ==, whole.conv_array->len);
+        for (unsigned i = 0; i < whole.conv_array->len; i++) {
+            const endpoint_item_t *want = &g_array_index(whole.conv_array, endpoint_item_t, i);
+            const endpoint_item_t *got = NULL;
+
+            for (unsigned j = 0; j < shard1.conv_array->len; j++) {
+                const endpoint_item_t *item = &g_array_index(shard1.conv_array, endpoint_item_t, j);
+                if (addresses_equal(&item->myaddress, &want->myaddress) && item->port == want->port) {
+                    got = item;
+                    break;
+                }
+            }
+            g_assert_nonnull(got);
+            g_assert_cmpuint(got->tx_frames, ==, want->tx_frames);
+            g_assert_cmpuint(got->rx_frames, ==, want->rx_frames);
+            g_assert_cmpuint(got->tx_bytes, ==, want->tx_bytes);
+            g_assert_cmpuint(got->rx_bytes, ==, want->rx_bytes);
+            g_assert_cmpuint(got->tx_frames_total, ==, want->tx_frames_total);
+            g_assert_cmpuint(got->rx_frames_total, ==, want->rx_frames_total);
+            g_assert_true(got->filtered == want->filtered);
+        }
+
+        reset_endpoint_table_data(&whole);
+        reset_endpoint_table_data(&shard1);
+        reset_endpoint_table_data(&shard2);
+    }
+}
+
+static tap_packet_status
+merge_test_packet(stats_tree *st _U_, packet_info *pinfo _U_, epan_dissect_t *edt _U_,
+        const void *p _U_, tap_flags_t flags _U_)
+{
+    return TAP_PACKET_DONT_REDRAW;
+}
+
+static void
+tap_stats_tree(stats_tree *st, const merge_packet_t *mp)
+{
+    char host[16], port[16];
+    int hosts_node, host_node;
+
+    snprintf(host, sizeof(host), "host %u", mp->src_host);
+    snprintf(port, sizeof(port), "port %u", mp->dst_port);
+
+    hosts_node = tick_stat_node(st, "Hosts", 0, true);
+    host_node = tick_stat_node(st, host, hosts_node, true);
+    avg_stat_node_add_value_int(st, port, host_node, false, mp->len);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void
+check_stat_node(const stat_node *got, const stat_node *want)
+{
+    const stat_node *want_child, *got_child;
+
+    g_assert_cmpstr(got->name, ==, want->name);
+    g_assert_cmpint(got->counter, ==, want->counter);
+    g_assert_cmpint(got->total.int_total, ==, want->total.int_total);
+    if (want->counter > 0 && want->total.int_total > 0) {
+        g_assert_cmpint(got->minvalue.int_min, ==, want->minvalue.int_min);
+        g_assert_cmpint(got->maxvalue.int_max, ==, want->maxvalue.int_max);
+    }
+
+    for (want_child = want->children; want_child; want_child = want_child->next) {
+        for (got_child = got->children; got_child; got_child = got_child->next) {
+            if (strcmp(got_child->name, want_child->name) == 0)
+                break;
+        }
+        g_assert_nonnull(got_child);
+        check_stat_node(got_child, want_child);
+    }
+    for (got_child = got->children; got_child; got_child = got_child->next) {
+        for (want_child = want->children; want_child; want_child = want_child->next) {
+            if (strcmp(got_child->name, want_child->name) == 0)
+                break;
+        }
+        g_assert_nonnull(want_child);
+    }
+}
+
+static void test_merge_stats_tree(void)
+{
+    int splits[] = { 0, 1, MERGE_PACKETS / 3, MERGE_PACKETS - 1, MERGE_PACKETS };
+    stats_tree_cfg *cfg;
+
+    merge_packets_init();
+    cfg = stats_tree_register("frame", "merge_test", "Merge Test", 0,
+            merge_test_packet, NULL, NULL);
+    for (unsigned s = 0; s < G_N_ELEMENTS(splits); s++) {
+        stats_tree *whole = stats_tree_new(cfg, NULL, NULL);
+        stats_tree *shard1 = stats_tree_new(cfg, NULL, NULL);
+        stats_tree *shard2 = stats_tree_new(cfg, NULL, NULL);
+
+        for (int i = 0; i < MERGE_PACKETS; i++) {
+            tap_stats_tree(whole, &merge_packets[i]);
+            tap_stats_tree(i < splits[s] ? shard1 : shard2, &merge_packets[i]);
+        }
+        stats_tree_merge(shard1, shard2);
+        check_stat_node(&shard1->root, &whole->root);
+
+        stats_tree_free(whole);
+        stats_tree_free(shard1);
+        stats_tree_free(shard2);
+    }
+}
+
+/*
+ * find_conversation() remembers its results for the current frame; adding
+ * or removing a conversation must make it look again.
+ */
+static void test_conversation_lookup_memo(void)
+{
+    uint8_t addr_a_data[4] = { 192, 0, 2, 1 };
+    uint8_t addr_b_data[4] = { 192, 0, 2, 2 };
+    address addr_a, addr_b;
+    conversation_t *conv;
+    uint64_t hits, misses, hits0, misses0;
+    epan_t *session = test_epan_new();
+
+    set_address(&addr_a, AT_IPv4, 4, addr_a_data);
+    set_address(&addr_b, AT_IPv4, 4, addr_b_data);
+    conversation_get_lookup_stats(&hits0, &misses0);
+
+    /* Not found, and the second lookup is answered from the memo. */
+    g_assert_null(find_conversation(10, &addr_a, &addr_b, CONVERSATION_UDP, 1024, 53, 0));
+    g_assert_null(find_conversation(10, &addr_a, &addr_b, CONVERSATION_UDP, 1024, 53, 0));
+    conversation_get_lookup_stats(&hits, &misses);
+    g_assert_cmpuint(hits - hits0, ==, 1);
+    g_assert_cmpuint(misses - misses0, ==, 1);
+
+    /* Adding the conversation invalidates the memoised miss. */
+    conv = conversation_new(5, &addr_a, &addr_b, CONVERSATION_UDP, 1024, 53, 0);
+    g_assert_true(find_conversation(10, &addr_a, &addr_b, CONVERSATION_UDP, 1024, 53, 0) == conv);
+    g_assert_true(find_conversation(10, &addr_a, &addr_b, CONVERSATION_UDP, 1024, 53, 0) == conv);
+    conversation_get_lookup_stats(&hits, &misses);
+    g_assert_cmpuint(hits - hits0, ==, 2);
+    g_assert_cmpuint(misses - misses0, ==, 2);
+
+    /* Removing it invalidates the memoised hit. */
+    g_assert_cmpuint(conversation_evict_idle(10), ==, 1);
+    g_assert_null(find_conversation(10, &addr_a, &addr_b, CONVERSATION_UDP, 1024, 53, 0));
+    conversation_get_lookup_stats(&hits, &misses);
+    g_assert_cmpuint(hits - hits0, ==, 2);
+    g_assert_cmpuint(misses - misses0, ==, 3);
+
+    epan_free(session);
+}
+
+/*
+ * conversation_evict_idle() forgets conversations last seen before the
+ * given frame and keeps the others.
+ */
+static void test_conversation_evict_idle(void)
+{
+    uint8_t addr_a_data[4] = { 192, 0, 2, 1 };
+    uint8_t addr_b_data[4] = { 192, 0, 2, 2 };
+    address addr_a, addr_b;
+    conversation_t *idle, *recent, *reused;
+    epan_t *session = test_epan_new();
+
+    set_address(&addr_a, AT_IPv4, 4, addr_a_data);
+    set_address(&addr_b, AT_IPv4, 4, addr_b_data);
+
+    idle = conversation_new(1, &addr_a, &addr_b, CONVERSATION_TCP, 1024, 80, 0);
+    recent = conversation_new(100, &addr_a, &addr_b, CONVERSATION_TCP, 1025, 80, 0);
+    g_assert_true(find_conversation(101, &addr_a, &addr_b, CONVERSATION_TCP, 1024, 80, 0) == idle);
+
+    g_assert_cmpuint(conversation_evict_idle(50), ==, 1);
+    g_assert_null(find_conversation(101, &addr_a, &addr_b, CONVERSATION_TCP, 1024, 80, 0));
+    g_assert_true(find_conversation(101, &addr_a, &addr_b, CONVERSATION_TCP, 1025, 80, 0) == recent);
+    g_assert_true(find_conversation(101, &addr_b, &addr_a, CONVERSATION_TCP, 80, 1025, 0) == recent);
+
+    /* Nothing else is idle yet. */
+    g_assert_cmpuint(conversation_evict_idle(50), ==, 0);
+
+    /* A later packet with the evicted addresses and ports starts afresh. */
+    reused = conversation_new(102, &addr_a, &addr_b, CONVERSATION_TCP, 1024, 80, 0);
+    g_assert_true(reused != idle);
+    g_assert_true(find_conversation(103, &addr_a, &addr_b, CONVERSATION_TCP, 1024, 80, 0) == reused);
+
+    epan_free(session);
+}
+
+static int heur_signature_calls;
+
+static bool
+heur_signature_dissector(tvbuff_t *tvb _U_, packet_info *pinfo _U_, proto_tree *tree _U_, void *data _U_)
+{
+    heur_signature_calls++;
+    return true;
+}
+
+/*
+ * A heuristic dissector with a signature is called for packets that have
+ * it, or that are too short to tell, and skipped for the others.
+ */
+static void test_heur_signature(void)
+{
+    static const uint8_t magic[] = { 'H', 'S' };
+    static const uint8_t match[] = { 0, 0, 'H', 'S', 0, 0, 0, 0 };
+    static const uint8_t other[] = { 0, 0, 'H', 'X', 0, 0, 0, 0 };
+    heur_dissector_list_t list;
+    heur_dtbl_entry_t *entry, *hdtbl_entry;
+    packet_info pinfo;
+    tvbuff_t *tvb;
+    int proto;
+
+    test_epan_init();
+    /* This is normally set when the preferences are read. */
+    prefs.gui_max_tree_depth = 5 * 100;
+
+    proto = proto_register_protocol("Heuristic Signature Test", "HEURSIGTEST", "heursigtest");
+    list = register_heur_dissector_list_with_description("heursigtest", "Heuristic signature test", proto);
+    heur_dissector_add("heursigtest", heur_signature_dissector, "Signature test",
+            "heursigtest_sig", proto, HEURISTIC_ENABLE);
+    heur_dissector_set_signature("heursigtest_sig", 6, 2, magic, sizeof(magic));
+    entry = find_heur_dissector_by_unique_short_name("heursigtest_sig");
+    g_assert_nonnull(entry);
+
+    memset(&pinfo, 0, sizeof(pinfo));
+    pinfo.pool = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK);
+    pinfo.layers = wmem_list_new(pinfo.pool);
+
+    /* The signature matches. */
+    tvb = tvb_new_real_data(match, sizeof(match), sizeof(match));
+    g_assert_true(dissector_try_heuristic(list, tvb, &pinfo, NULL, &hdtbl_entry, NULL));
+    g_assert_true(hdtbl_entry == entry);
+    g_assert_cmpint(heur_signature_calls, ==, 1);
+    tvb_free(tvb);
+
+    /* Different bytes at the signature's offset. */
+    tvb = tvb_new_real_data(other, sizeof(other), sizeof(other));
+    g_assert_false(dissector_try_heuristic(list, tvb, &pinfo, NULL, &hdtbl_entry, NULL));
+    g_assert_null(hdtbl_entry);
+    g_assert_cmpint(heur_signature_calls, ==, 1);
+    tvb_free(tvb);
+
+    /* Shorter than the minimum length. */
+    tvb = tvb_new_real_data(match, 4, 4);
+    g_assert_false(dissector_try_heuristic(list, tvb, &pinfo, NULL, &hdtbl_entry, NULL));
+    g_assert_cmpint(heur_signature_calls, ==, 1);
+    tvb_free(tvb);
+
+    /* The signature wasn't captured, so the dissector has to decide. */
+    tvb = tvb_new_real_data(match, 2, sizeof(match));
+    g_assert_true(dissector_try_heuristic(list, tvb, &pinfo, NULL, &hdtbl_entry, NULL));
+    g_assert_cmpint(heur_signature_calls, ==, 2);
+    tvb_free(tvb);
+
+    g_assert_cmpuint(entry->calls, ==, 2);
+    g_assert_cmpuint(entry->accepts, ==, 2);
+    g_assert_cmpuint(entry->rejected_early, ==, 2);
+
+    wmem_destroy_allocator(pinfo.pool);
+}
+
 int main(int argc, char **argv)
 {
     int ret;
@@ -89,8 +586,24 @@ int main(int argc, char **argv)
     g_test_add_func("/label/escape_whitespace", test_label_strcat_escape_whitespace);
     g_test_add_func("/label/escape_control", test_label_escape_control);
 
+    g_test_add_func("/stats/merge_conversation_table", test_merge_conversation_table);
+    g_test_add_func("/stats/merge_endpoint_table", test_merge_endpoint_table);
+    g_test_add_func("/stats/merge_stats_tree", test_merge_stats_tree);
+
+    g_test_add_func("/conversation/lookup_memo", test_conversation_lookup_memo);
+    g_test_add_func("/conversation/evict_idle", test_conversation_evict_idle);
+
+    g_test_add_func("/packet/heur_signature", test_heur_signature);
+
+    if (g_test_perf()) {
+        g_test_add_func("/proto/tree_perf", test_proto_tree_perf);
+    }
+
     ret = g_test_run();
 
+    if (epan_initialized)
+        epan_cleanup();
+
     return ret;
 }
 
@@ -18,13 +18,19 @@
 typedef struct {
 	GQueue		*tvbs;
 
-	/* Used for quick testing to see if this
-	 * is the tvbuff that a COMPOSITE is
-	 * interested in. */
+	/* The members, and the offsets of their first and last bytes in
+	 * the composite, indexed the same way; set up by
+	 * tvb_composite_finalize(), so that the member containing an
+	 * offset can be found with a binary search. */
+	unsigned	num_members;
+	tvbuff_t	**members;
 	unsigned		*start_offsets;
 	unsigned		*end_offsets;
 
-	unsigned	recursion_depth;
+	/* Copies of ranges that span members, handed out by
+	 * composite_get_ptr(), and their total size. */
+	GSList		*spans;
+	unsigned	span_bytes;
 
 } tvb_comp_t;
 
@@ -42,8 +48,10 @@ composite_free(tvbuff_t *tvb)
 
 	g_queue_free(composite->tvbs);
 
+	g_free(composite->members);
 	g_free(composite->start_offsets);
 	g_free(composite->end_offsets);
+	g_slist_free_full(composite->spans, g_free);
 	g_free((void *)tvb->real_data);
 }
 
@@ -53,36 +61,53 @@ composite_offset(const tvbuff_t *tvb _U_, const unsigned counter)
 	return counter;
 }
 
+/*
+ * Returns the index of the member that contains abs_offset, or
+ * num_members if abs_offset is past the end of the last member.
+ */
+static unsigned
+composite_find_member(const tvb_comp_t *composite, unsigned abs_offset)
+{
+	unsigned low = 0, high = composite->num_members;
+
+	/* Find the first member whose last byte is at or after abs_offset. */
+	while (low < high) {
+		unsigned mid = low + (high - low) / 2;
+
+		if (composite->end_offsets[mid] < abs_offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+static void *composite_memcpy(tvbuff_t *tvb, void* _target, unsigned abs_offset, unsigned abs_length);
+
 static const uint8_t*
 composite_get_ptr(tvbuff_t *tvb, unsigned abs_offset, unsigned abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	unsigned	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	unsigned	member_offset;
+	uint8_t    *span;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite = &composite_tvb->composite;
-	GList *item = (GList*)composite->tvbs->head;
-
-
-	for (i = 0; i < g_queue_get_length(composite->tvbs); i++, item=item->next) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			member_tvb = (tvbuff_t *)item->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->num_members) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return "";
 	}
 
+	member_tvb = composite->members[i];
 	member_offset = abs_offset - composite->start_offsets[i];
 
 	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
@@ -92,8 +117,27 @@ composite_get_ptr(tvbuff_t *tvb, unsigned abs_offset, unsigned abs_length)
 		DISSECTOR_ASSERT(!tvb->real_data);
 		return tvb_get_ptr(member_tvb, member_offset, abs_length);
 	}
+	else if (composite->span_bytes + abs_length < tvb->length) {
+		/*
+		 * The range spans members; copy just that range, rather
+		 * than the whole composite, which could be a reassembled
+		 * stream made of thousands of segments.
+		 */
+		span = (uint8_t *)g_malloc(abs_length);
+		composite_memcpy(tvb, span, abs_offset, abs_length);
+		composite->spans = g_slist_prepend(composite->spans, span);
+		composite->span_bytes += abs_length;
+		return span;
+	}
 	else {
-		/* Use a temporary variable as tvb_memcpy is also checking tvb->real_data pointer */
+		/*
+		 * We've already copied as much as the whole composite
+		 * would take; flatten it, so that all further requests
+		 * are satisfied from the flattened copy.
+		 *
+		 * Use a temporary variable as tvb_memcpy is also checking
+		 * tvb->real_data pointer.
+		 */
 		void *real_data = g_malloc(tvb->length);
 		tvb_memcpy(tvb, real_data, 0, tvb->length);
 		tvb->real_data = (const uint8_t *)real_data;
@@ -103,9 +147,7 @@ composite_get_ptr(tvbuff_t *tvb, unsigned abs_offset, unsigned abs_length)
 	DISSECTOR_ASSERT_NOT_REACHED();
 }
 
-#define MAX_RECURSION_DEPTH 500 // Arbitrary; matches prefs.gui_max_tree_depth
 static void *
-// NOLINTNEXTLINE(misc-no-recursion)
 composite_memcpy(tvbuff_t *tvb, void* _target, unsigned abs_offset, unsigned abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
@@ -113,64 +155,52 @@ composite_memcpy(tvbuff_t *tvb, void* _target, unsigned abs_offset, unsigned abs
 
 	unsigned	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	unsigned	    member_offset, member_length;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
-	/* Maybe the range specified by offset/length
-	 * is contiguous inside one of the member tvbuffs */
 	composite   = &composite_tvb->composite;
-
-	GList *item = (GList*)composite->tvbs->head;
-	for (i = 0; i < g_queue_get_length(composite->tvbs); i++, item=item->next) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			member_tvb = (tvbuff_t *)item->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->num_members) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return target;
 	}
 
 	member_offset = abs_offset - composite->start_offsets[i];
 
-	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
-		DISSECTOR_ASSERT(!tvb->real_data);
-		return tvb_memcpy(member_tvb, target, member_offset, abs_length);
-	}
-	else {
-		/* The requested data is non-contiguous inside
-		 * the member tvb. We have to memcpy() the part that's in the member tvb,
-		 * then iterate across the other member tvb's, copying their portions
-		 * until we have copied all data.
-		 */
+	/*
+	 * Copy the part that's in this member, then carry on with the
+	 * following members until we have copied all the data.
+	 */
+	for (;;) {
+		member_tvb = composite->members[i];
+		if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
+			tvb_memcpy(member_tvb, target, member_offset, abs_length);
+			break;
+		}
+
 		member_length = tvb_captured_length_remaining(member_tvb, member_offset);
 
-		/* composite_memcpy() can't handle a member_length of zero. */
+		/* We can't make progress with a member_length of zero. */
 		DISSECTOR_ASSERT(member_length > 0);
 		/* make sure we don't underflow below */
 		DISSECTOR_ASSERT(member_length <= abs_length);
 
 		tvb_memcpy(member_tvb, target, member_offset, member_length);
-		abs_offset	+= member_length;
+		target		+= member_length;
 		abs_length	-= member_length;
+		if (abs_length == 0)
+			break;
 
-		/* Recurse */
-		if (abs_length > 0) {
-			composite->recursion_depth++;
-			DISSECTOR_ASSERT(composite->recursion_depth < MAX_RECURSION_DEPTH);
-			composite_memcpy(tvb, target + member_length, abs_offset, abs_length);
-			composite->recursion_depth--;
-		}
-
-		return target;
+		i++;
+		DISSECTOR_ASSERT(i < composite->num_members);
+		member_offset = 0;
 	}
 
-	DISSECTOR_ASSERT_NOT_REACHED();
+	return _target;
 }
 
 static const struct tvb_ops tvb_composite_ops = {
@@ -205,9 +235,12 @@ tvb_new_composite(void)
 	tvb_comp_t *composite = &composite_tvb->composite;
 
 	composite->tvbs		 = g_queue_new();
+	composite->num_members	 = 0;
+	composite->members	 = NULL;
 	composite->start_offsets = NULL;
 	composite->end_offsets	 = NULL;
-	composite->recursion_depth = 0;
+	composite->spans	 = NULL;
+	composite->span_bytes	 = 0;
 
 	return tvb;
 }
@@ -284,12 +317,15 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	 */
 	DISSECTOR_ASSERT(num_members);
 
+	composite->num_members = num_members;
+	composite->members = g_new(tvbuff_t *, num_members);
 	composite->start_offsets = g_new(unsigned, num_members);
 	composite->end_offsets = g_new(unsigned, num_members);
 
 	GList *item = (GList*)composite->tvbs->head;
 	for (i=0; i < num_members; i++, item=item->next) {
 		member_tvb = (tvbuff_t *)item->data;
+		composite->members[i] = member_tvb;
 		composite->start_offsets[i] = tvb->length;
 		tvb->length += member_tvb->length;
 		tvb->reported_length += member_tvb->reported_length;
@@ -484,6 +484,26 @@ calc_progbar_val(capture_file *cf, int64_t size, int64_t file_pos, char *status_
     return progbar_val;
 }
 
+/*
+ * Serializes reads from the capture file. rescan_packets() reads records
+ * on a separate thread while the main thread may read others, or read
+ * new records sequentially from a file that's being tailed; either can
+ * grow the wtap's interface, section and fast seek tables.
+ */
+static GMutex read_mtx;
+
+static bool
+read_next_record(capture_file *cf, wtap_rec *rec, int *err, char **err_info,
+        int64_t *data_offset)
+{
+    bool ret;
+
+    g_mutex_lock(&read_mtx);
+    ret = wtap_read(cf->provider.wth, rec, err, err_info, data_offset);
+    g_mutex_unlock(&read_mtx);
+    return ret;
+}
+
 cf_read_status_t
 cf_read(capture_file *cf, bool reloading)
 {
@@ -612,7 +632,7 @@ cf_read(capture_file *cf, bool reloading)
         float   progbar_val;
         char    status_str[100];
 
-        while ((wtap_read(cf->provider.wth, &rec, &err, &err_info,
+        while ((read_next_record(cf, &rec, &err, &err_info,
                         &data_offset))) {
             if (size >= 0) {
                 if (cf->count == max_records) {
@@ -872,7 +892,7 @@ cf_continue_tail(capture_file *cf, volatile int to_read, wtap_rec *rec,
 
         while (to_read != 0) {
             wtap_cleareof(cf->provider.wth);
-            if (!wtap_read(cf->provider.wth, rec, err, &err_info,
+            if (!read_next_record(cf, rec, err, &err_info,
                         &data_offset)) {
                 break;
             }
@@ -992,7 +1012,7 @@ cf_finish_tail(capture_file *cf, wtap_rec *rec, int *err,
     epan_dissect_init(&edt, cf->epan, create_proto_tree, false);
 
     wtap_cleareof(cf->provider.wth);
-    while ((wtap_read(cf->provider.wth, rec, err, &err_info, &data_offset))) {
+    while ((read_next_record(cf, rec, err, &err_info, &data_offset))) {
         if (cf->state == FILE_READ_ABORTED) {
             /* Well, the user decided to abort the read.  Break out of the
                loop, and let the code below (which is called even if there
@@ -1233,12 +1253,12 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
     if (fdata->passed_dfilter && dfcode != NULL) {
         fdata->passed_dfilter = dfilter_apply_edt(dfcode, edt) ? 1 : 0;
 
-        if (fdata->passed_dfilter && edt->pi.fd->dependent_frames) {
+        if (fdata->passed_dfilter && FRAME_DATA_DEPENDENT_FRAMES(edt->pi.fd)) {
             /* This frame passed the display filter but it may depend on other
              * (potentially not displayed) frames.  Find those frames and mark them
              * as depended upon.
              */
-            g_hash_table_foreach(edt->pi.fd->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
+            g_hash_table_foreach(edt->pi.fd->extra->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
         }
     }
 
@@ -1598,13 +1618,25 @@ cf_redissect_packets(capture_file *cf)
     }
 }
 
+static bool
+read_record(capture_file *cf, const frame_data *fdata, wtap_rec *rec,
+        int *err, char **err_info)
+{
+    bool ret;
+
+    g_mutex_lock(&read_mtx);
+    ret = wtap_seek_read(cf->provider.wth, fdata->file_off, rec, err, err_info);
+    g_mutex_unlock(&read_mtx);
+    return ret;
+}
+
 bool
 cf_read_record(capture_file *cf, const frame_data *fdata, wtap_rec *rec)
 {
     int    err;
     char *err_info;
 
-    if (!wtap_seek_read(cf->provider.wth, fdata->file_off, rec, &err, &err_info)) {
+    if (!read_record(cf, fdata, rec, &err, &err_info)) {
         report_cfile_read_failure(cf->filename, err, err_info);
         return false;
     }
@@ -1618,7 +1650,7 @@ cf_read_record_no_alert(capture_file *cf, const frame_data *fdata,
     int    err;
     char *err_info;
 
-    if (!wtap_seek_read(cf->provider.wth, fdata->file_off, rec, &err, &err_info)) {
+    if (!read_record(cf, fdata, rec, &err, &err_info)) {
         g_free(err_info);
         return false;
     }
@@ -1670,6 +1702,10 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, bo
     bool        compiled _U_;
     uint32_t    frames_count;
     rescan_type queued_rescan_type = RESCAN_NONE;
+    cf_read_ahead_t *reader;
+    cf_read_ahead_slot_t *slot;
+    uint32_t    read_ahead_last;
+    wtap_rec   *rec_ptr;
 
     if (cf->state == FILE_CLOSED || cf->state == FILE_READ_PENDING) {
         return;
@@ -1856,6 +1892,15 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, bo
         wtap_set_cb_new_secrets(cf->provider.wth, secrets_wtap_callback);
     }
 
+    /*
+     * Rescanning has to dissect every frame on this thread, but reading
+     * the records (and decompressing them, for compressed files) doesn't,
+     * so read them ahead on another one. Frames added while redissecting
+     * are read on this thread.
+     */
+    read_ahead_last = frames_count;
+    reader = cf_read_ahead_start(cf, 1, read_ahead_last, read_record);
+
     for (framenum = 1; framenum <= frames_count; framenum++) {
         fdata = frame_data_sequence_find(cf->provider.frames, framenum);
 
@@ -1930,8 +1975,22 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, bo
         /* Frame dependencies from the previous dissection/filtering are no longer valid. */
         fdata->dependent_of_displayed = 0;
 
-        if (!cf_read_record(cf, fdata, &rec))
-            break; /* error reading the frame */
+        if (framenum <= read_ahead_last) {
+            slot = cf_read_ahead_next(reader);
+            ws_assert(slot->fdata == fdata);
+            if (!slot->ok) {
+                report_cfile_read_failure(cf->filename, slot->err, slot->err_info);
+                slot->err_info = NULL;
+                cf_read_ahead_release(reader, slot);
+                break; /* error reading the frame */
+            }
+            rec_ptr = &slot->rec;
+        } else {
+            slot = NULL;
+            if (!cf_read_record(cf, fdata, &rec))
+                break; /* error reading the frame */
+            rec_ptr = &rec;
+        }
 
         /* If the previous frame is displayed, and we haven't yet seen the
            selected frame, remember that frame - it's the closest one we've
@@ -1941,7 +2000,7 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, bo
             preceding_frame = prev_frame;
         }
 
-        add_packet_to_packet_list(fdata, cf, &edt, cf->dfcode, cinfo, &rec,
+        add_packet_to_packet_list(fdata, cf, &edt, cf->dfcode, cinfo, rec_ptr,
                 add_to_packet_list);
 
         /* If this frame is displayed, and this is the first frame we've
@@ -1962,9 +2021,13 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, bo
            on the next pass through the loop. */
         prev_frame_num = fdata->num;
         prev_frame = fdata;
-        wtap_rec_reset(&rec);
+        if (slot != NULL)
+            cf_read_ahead_release(reader, slot);
+        else
+            wtap_rec_reset(&rec);
     }
 
+    cf_read_ahead_finish(reader);
     epan_dissect_cleanup(&edt);
     wtap_rec_cleanup(&rec);
 
@@ -5215,9 +5278,9 @@ save_record(capture_file *cf, frame_data *fdata, wtap_rec *rec, void *argsp)
     new_rec.block  = pkt_block;
     new_rec.block_was_modified = fdata->has_modified_block ? true : false;
 
-    if (!nstime_is_zero(&fdata->shift_offset)) {
+    if (!nstime_is_zero(frame_data_shift_offset(fdata))) {
         if (new_rec.presence_flags & WTAP_HAS_TS) {
-            nstime_add(&new_rec.ts, &fdata->shift_offset);
+            nstime_add(&new_rec.ts, frame_data_shift_offset(fdata));
         }
     }
 
@@ -5239,8 +5302,8 @@ save_record(capture_file *cf, frame_data *fdata, wtap_rec *rec, void *argsp)
      *
      * If we're exporting to a different file, then don't do that.
      */
-    if (!args->export && new_rec.presence_flags & WTAP_HAS_TS) {
-        nstime_set_zero(&fdata->shift_offset);
+    if (!args->export && new_rec.presence_flags & WTAP_HAS_TS && fdata->extra) {
+        nstime_set_zero(&fdata->extra->shift_offset);
     }
 
     return true;
@@ -5429,7 +5492,7 @@ rescan_file(capture_file *cf, const char *fname, bool is_tempfile)
 
     framenum = 0;
     wtap_rec_init(&rec, 1514);
-    while ((wtap_read(cf->provider.wth, &rec, &err, &err_info,
+    while ((read_next_record(cf, &rec, &err, &err_info,
                       &data_offset))) {
         framenum++;
         fdata = frame_data_sequence_find(cf->provider.frames, framenum);
@@ -11,6 +11,7 @@
 #include <config.h>
 #define WS_LOG_DOMAIN  LOG_DOMAIN_MAIN
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +27,7 @@
 #include <wsutil/file_util.h>
 #include <wsutil/privileges.h>
 #include <wsutil/report_message.h>
+#include <wsutil/tempfile.h>
 #include <cli_main.h>
 #include <wsutil/version_info.h>
 #include <wiretap/wtap_opttypes.h>
@@ -51,6 +53,9 @@ print_usage(FILE *output)
     fprintf(output, "\n");
     fprintf(output, "Options:\n");
     fprintf(output, "  -n                don't write to output file if the input file is ordered.\n");
+    fprintf(output, "  -s <frames>       sort in a single pass, holding at most <frames> frames\n");
+    fprintf(output, "                    in memory; frames further out of order than that are\n");
+    fprintf(output, "                    sorted via temporary files.\n");
     fprintf(output, "  -h, --help        display this help and exit.\n");
     fprintf(output, "  -v, --version     print version information and exit.\n");
 }
@@ -134,6 +139,518 @@ frames_compare(const void *a, const void *b)
     return nstime_cmp(time1, time2);
 }
 
+/**************************************************/
+/* Streaming mode                                 */
+
+/*
+ * Rather than indexing every frame and then re-reading the input in sorted
+ * order, which needs memory for every frame and random access to the input,
+ * the streaming mode keeps at most "window" frames in a min-heap and writes
+ * out the earliest one whenever the heap is full (replacement selection).
+ * A frame earlier than one that has already been written can't go into the
+ * run being written, so it is held back for the next run.  Input that is
+ * only out of order within the window is thus sorted in one sequential pass;
+ * otherwise the runs are written to temporary files and merged afterwards.
+ */
+
+/* Maximum number of runs merged at once; more than that are merged in
+   several passes, to stay within the limit on open files. */
+#define MERGE_FAN_IN 64
+
+/* A frame held in the reorder window */
+typedef struct StreamFrame_t {
+    wtap_rec     rec;
+    unsigned     run;
+    unsigned     num;
+
+    nstime_t     frame_time;
+} StreamFrame_t;
+
+/* A sorted run being read back to be merged */
+typedef struct RunReader_t {
+    const char  *path;
+    wtap        *wth;
+    wtap_rec     rec;
+    unsigned     run;
+
+    nstime_t     frame_time;
+} RunReader_t;
+
+typedef struct ReorderStream_t {
+    const char  *infile;
+    const char  *outfile;
+    int          file_type_subtype;
+    wtap_dump_params params;
+
+    GPtrArray   *run_paths;     /* file of each finished run, NULL if outfile */
+    wtap_dumper *pdh;           /* run being written */
+    char        *run_path;      /* its temporary file, NULL if outfile */
+    unsigned     cur_run;
+    nstime_t     last_written;
+} ReorderStream_t;
+
+static void
+heap_push(GPtrArray *heap, void *item, GCompareFunc compare)
+{
+    unsigned i = heap->len;
+
+    g_ptr_array_add(heap, item);
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+
+        if (compare(heap->pdata[parent], item) <= 0)
+            break;
+        heap->pdata[i] = heap->pdata[parent];
+        i = parent;
+    }
+    heap->pdata[i] = item;
+}
+
+static void *
+heap_pop(GPtrArray *heap, GCompareFunc compare)
+{
+    void *top = heap->pdata[0];
+    void *last = g_ptr_array_remove_index(heap, heap->len - 1);
+    unsigned i = 0;
+
+    if (heap->len == 0)
+        return top;
+
+    for (;;) {
+        unsigned child = 2 * i + 1;
+
+        if (child >= heap->len)
+            break;
+        if (child + 1 < heap->len &&
+            compare(heap->pdata[child + 1], heap->pdata[child]) < 0)
+            child++;
+        if (compare(last, heap->pdata[child]) <= 0)
+            break;
+        heap->pdata[i] = heap->pdata[child];
+        i = child;
+    }
+    heap->pdata[i] = last;
+    return top;
+}
+
+/* Order by run, then timestamp, then position in the input file, so
+   that frames with equal timestamps keep their original order. */
+static int
+stream_frames_compare(const void *a, const void *b)
+{
+    const StreamFrame_t *frame1 = (const StreamFrame_t *) a;
+    const StreamFrame_t *frame2 = (const StreamFrame_t *) b;
+    int cmp;
+
+    if (frame1->run != frame2->run)
+        return frame1->run < frame2->run ? -1 : 1;
+
+    cmp = nstime_cmp(&frame1->frame_time, &frame2->frame_time);
+    if (cmp != 0)
+        return cmp;
+
+    return frame1->num < frame2->num ? -1 : (frame1->num > frame2->num);
+}
+
+/* Order by timestamp, then run; equal timestamps can only be split across
+   runs in input order, so this keeps the sort stable. */
+static int
+run_readers_compare(const void *a, const void *b)
+{
+    const RunReader_t *reader1 = (const RunReader_t *) a;
+    const RunReader_t *reader2 = (const RunReader_t *) b;
+    int cmp;
+
+    cmp = nstime_cmp(&reader1->frame_time, &reader2->frame_time);
+    if (cmp != 0)
+        return cmp;
+
+    return reader1->run < reader2->run ? -1 : (reader1->run > reader2->run);
+}
+
+static const char *
+stream_run_name(ReorderStream_t *rs)
+{
+    return rs->run_path ? rs->run_path : rs->outfile;
+}
+
+/* Start writing a run; to a temporary file if path is NULL, otherwise
+   to path, which may be "-" for the standard output. */
+static bool
+stream_start_run(ReorderStream_t *rs, const char *path)
+{
+    int err;
+    char *err_info = NULL;
+
+    rs->run_path = NULL;
+    if (path == NULL) {
+        GError *err_tempfile = NULL;
+        int fd;
+
+        fd = create_tempfile(NULL, &rs->run_path, "reordercap_", NULL, &err_tempfile);
+        if (fd < 0) {
+            cmdarg_err("Temporary file could not be created: %s", err_tempfile->message);
+            g_error_free(err_tempfile);
+            g_free(rs->run_path);
+            rs->run_path = NULL;
+            return false;
+        }
+        rs->pdh = wtap_dump_fdopen(fd, rs->file_type_subtype,
+                                   WS_FILE_UNCOMPRESSED, &rs->params, &err, &err_info);
+    } else if (strcmp(path, "-") == 0) {
+        rs->pdh = wtap_dump_open_stdout(rs->file_type_subtype,
+                                        WS_FILE_UNCOMPRESSED, &rs->params, &err, &err_info);
+    } else {
+        rs->pdh = wtap_dump_open(path, rs->file_type_subtype,
+                                 WS_FILE_UNCOMPRESSED, &rs->params, &err, &err_info);
+    }
+
+    if (rs->pdh == NULL) {
+        report_cfile_dump_open_failure(stream_run_name(rs), err, err_info,
+                                       rs->file_type_subtype);
+        if (rs->run_path != NULL) {
+            ws_unlink(rs->run_path);
+            g_free(rs->run_path);
+            rs->run_path = NULL;
+        }
+        return false;
+    }
+    return true;
+}
+
+static bool
+stream_finish_run(ReorderStream_t *rs)
+{
+    int err;
+    char *err_info;
+    bool ok = true;
+
+    if (!wtap_dump_close(rs->pdh, NULL, &err, &err_info)) {
+        report_cfile_close_failure(stream_run_name(rs), err, err_info);
+        ok = false;
+    }
+    rs->pdh = NULL;
+    return ok;
+}
+
+/* Write out the earliest frame in the window */
+static bool
+stream_write_next(ReorderStream_t *rs, GPtrArray *heap, GPtrArray *free_frames)
+{
+    StreamFrame_t *frame = (StreamFrame_t *) heap_pop(heap, stream_frames_compare);
+    int err;
+    char *err_info;
+
+    if (frame->run != rs->cur_run) {
+        /* Nothing left in the window for this run; start the next one */
+        if (!stream_finish_run(rs)) {
+            g_ptr_array_add(free_frames, frame);
+            return false;
+        }
+        g_ptr_array_add(rs->run_paths, rs->run_path);
+        if (!stream_start_run(rs, NULL)) {
+            g_ptr_array_add(free_frames, frame);
+            return false;
+        }
+        rs->cur_run = frame->run;
+    }
+
+    DEBUG_PRINT("Writing frame %u to run %u\n", frame->num, frame->run);
+
+    if (!wtap_dump(rs->pdh, &frame->rec, &err, &err_info)) {
+        report_cfile_write_failure(rs->infile, stream_run_name(rs), err, err_info,
+                                   frame->num, rs->file_type_subtype);
+        g_ptr_array_add(free_frames, frame);
+        return false;
+    }
+    rs->last_written = frame->frame_time;
+    wtap_rec_reset(&frame->rec);
+    g_ptr_array_add(free_frames, frame);
+
+    return true;
+}
+
+static bool
+run_reader_next(RunReader_t *reader, bool *ok)
+{
+    int err;
+    char *err_info;
+    int64_t data_offset;
+
+    if (!wtap_read(reader->wth, &reader->rec, &err, &err_info, &data_offset)) {
+        if (err != 0) {
+            report_cfile_read_failure(reader->path, err, err_info);
+            *ok = false;
+        }
+        return false;
+    }
+    if (reader->rec.presence_flags & WTAP_HAS_TS) {
+        reader->frame_time = reader->rec.ts;
+    } else {
+        nstime_set_unset(&reader->frame_time);
+    }
+    return true;
+}
+
+/* Merge count runs, starting with run first, into the run being written */
+static bool
+stream_merge_runs(ReorderStream_t *rs, unsigned first, unsigned count)
+{
+    RunReader_t *readers = g_new0(RunReader_t, count);
+    GPtrArray *heap = g_ptr_array_sized_new(count);
+    unsigned num = 0;
+    unsigned i;
+    int err;
+    char *err_info;
+    bool ok = true;
+
+    for (i = 0; i < count; i++) {
+        RunReader_t *reader = &readers[i];
+
+        reader->path = (const char *) rs->run_paths->pdata[first + i];
+        reader->run = i;
+        wtap_rec_init(&reader->rec, 1514);
+        if (!ok)
+            continue;
+
+        reader->wth = wtap_open_offline(reader->path, WTAP_TYPE_AUTO, &err, &err_info, false);
+        if (reader->wth == NULL) {
+            report_cfile_open_failure(reader->path, err, err_info);
+            ok = false;
+        } else if (run_reader_next(reader, &ok)) {
+            heap_push(heap, reader, run_readers_compare);
+        }
+    }
+
+    while (ok && heap->len > 0) {
+        RunReader_t *reader = (RunReader_t *) heap_pop(heap, run_readers_compare);
+
+        num++;
+        if (!wtap_dump(rs->pdh, &reader->rec, &err, &err_info)) {
+            report_cfile_write_failure(reader->path, stream_run_name(rs), err, err_info,
+                                       num, rs->file_type_subtype);
+            ok = false;
+            break;
+        }
+        wtap_rec_reset(&reader->rec);
+
+        if (run_reader_next(reader, &ok))
+            heap_push(heap, reader, run_readers_compare);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (readers[i].wth != NULL)
+            wtap_close(readers[i].wth);
+        wtap_rec_cleanup(&readers[i].rec);
+    }
+    g_ptr_array_free(heap, TRUE);
+    g_free(readers);
+
+    return ok;
+}
+
+/* The first run was written straight to the output file, but there are
+   more; move it out of the way so that they can all be merged into it. */
+static bool
+stream_move_output_aside(ReorderStream_t *rs)
+{
+    char *dir = g_strdup(rs->outfile);
+    const char *tempdir;
+    char *path = NULL;
+    GError *err_tempfile = NULL;
+    int fd;
+
+    /* Same directory, so that this is a rename rather than a copy */
+    tempdir = get_dirname(dir);
+    fd = create_tempfile(tempdir ? tempdir : ".", &path, "reordercap_", NULL, &err_tempfile);
+    g_free(dir);
+    if (fd < 0) {
+        cmdarg_err("Temporary file could not be created: %s", err_tempfile->message);
+        g_error_free(err_tempfile);
+        g_free(path);
+        return false;
+    }
+    ws_close(fd);
+    ws_unlink(path);
+
+    if (ws_rename(rs->outfile, path) != 0) {
+        cmdarg_err("\"%s\" could not be renamed to \"%s\": %s",
+                   rs->outfile, path, g_strerror(errno));
+        g_free(path);
+        return false;
+    }
+    rs->run_paths->pdata[0] = path;
+    return true;
+}
+
+static int
+reorder_streaming(wtap *wth, const char *infile, const char *outfile,
+                  unsigned window, bool write_output_regardless)
+{
+    ReorderStream_t rs;
+    StreamFrame_t *frames;
+    StreamFrame_t *frame;
+    GPtrArray *heap;
+    GPtrArray *free_frames;
+    nstime_t prev_time;
+    unsigned frame_count = 0;
+    unsigned wrong_order_count = 0;
+    unsigned i;
+    int err;
+    char *err_info;
+    int64_t data_offset;
+    int ret = EXIT_SUCCESS;
+
+    memset(&rs, 0, sizeof rs);
+    rs.infile = infile;
+    rs.outfile = outfile;
+    rs.file_type_subtype = wtap_file_type_subtype(wth);
+    rs.run_paths = g_ptr_array_new_with_free_func(g_free);
+    nstime_set_unset(&rs.last_written);
+    wtap_dump_params_init(&rs.params, wth);
+
+    /* One more than the window, so that a frame can be read in before
+       the earliest one is written out. */
+    frames = g_new0(StreamFrame_t, window + 1);
+    heap = g_ptr_array_sized_new(window + 1);
+    free_frames = g_ptr_array_sized_new(window + 1);
+    for (i = 0; i <= window; i++) {
+        wtap_rec_init(&frames[i].rec, 1514);
+        g_ptr_array_add(free_frames, &frames[i]);
+    }
+
+    /* The first run can go straight to the output file, unless it might
+       not be wanted or it might need to be read back. */
+    if (!stream_start_run(&rs, (write_output_regardless && strcmp(outfile, "-") != 0) ? outfile : NULL)) {
+        ret = OUTPUT_FILE_ERROR;
+        goto cleanup;
+    }
+
+    nstime_set_unset(&prev_time);
+    frame = (StreamFrame_t *) g_ptr_array_remove_index(free_frames, free_frames->len - 1);
+    while (wtap_read(wth, &frame->rec, &err, &err_info, &data_offset)) {
+        frame->num = ++frame_count;
+        if (frame->rec.presence_flags & WTAP_HAS_TS) {
+            frame->frame_time = frame->rec.ts;
+        } else {
+            nstime_set_unset(&frame->frame_time);
+        }
+
+        if (frame_count > 1 && nstime_cmp(&frame->frame_time, &prev_time) < 0) {
+            wrong_order_count++;
+        }
+        prev_time = frame->frame_time;
+
+        /* Too early for the run being written; hold it for the next one */
+        if (nstime_cmp(&frame->frame_time, &rs.last_written) < 0) {
+            frame->run = rs.cur_run + 1;
+        } else {
+            frame->run = rs.cur_run;
+        }
+        heap_push(heap, frame, stream_frames_compare);
+
+        if (heap->len > window && !stream_write_next(&rs, heap, free_frames)) {
+            ret = OUTPUT_FILE_ERROR;
+            goto cleanup;
+        }
+        frame = (StreamFrame_t *) g_ptr_array_remove_index(free_frames, free_frames->len - 1);
+    }
+    g_ptr_array_add(free_frames, frame);
+    if (err != 0) {
+      /* Print a message noting that the read failed somewhere along the line. */
+      report_cfile_read_failure(infile, err, err_info);
+    }
+
+    /* Drain the window */
+    while (heap->len > 0) {
+        if (!stream_write_next(&rs, heap, free_frames)) {
+            ret = OUTPUT_FILE_ERROR;
+            goto cleanup;
+        }
+    }
+    if (!stream_finish_run(&rs)) {
+        ret = OUTPUT_FILE_ERROR;
+        goto cleanup;
+    }
+    g_ptr_array_add(rs.run_paths, rs.run_path);
+    rs.run_path = NULL;
+
+    printf("%u frames, %u out of order\n", frame_count, wrong_order_count);
+    DEBUG_PRINT("%u sorted runs\n", rs.run_paths->len);
+
+    /* Avoid writing if already sorted and configured to */
+    if (!write_output_regardless && wrong_order_count == 0) {
+        printf("Not writing output file because input file is already in order.\n");
+        goto cleanup;
+    }
+
+    /* Already written in full? */
+    if (rs.run_paths->len == 1 && rs.run_paths->pdata[0] == NULL) {
+        goto cleanup;
+    }
+
+    if (rs.run_paths->pdata[0] == NULL && !stream_move_output_aside(&rs)) {
+        ret = OUTPUT_FILE_ERROR;
+        goto cleanup;
+    }
+
+    /* Merge the earliest runs first, and put the result in their place,
+       so that frames with equal timestamps stay in input order. */
+    while (rs.run_paths->len > MERGE_FAN_IN) {
+        if (!stream_start_run(&rs, NULL)) {
+            ret = OUTPUT_FILE_ERROR;
+            goto cleanup;
+        }
+        if (!stream_merge_runs(&rs, 0, MERGE_FAN_IN) || !stream_finish_run(&rs)) {
+            ret = OUTPUT_FILE_ERROR;
+            goto cleanup;
+        }
+        for (i = 0; i < MERGE_FAN_IN; i++) {
+            ws_unlink((const char *) rs.run_paths->pdata[i]);
+        }
+        g_ptr_array_remove_range(rs.run_paths, 0, MERGE_FAN_IN);
+        g_ptr_array_insert(rs.run_paths, 0, rs.run_path);
+        rs.run_path = NULL;
+    }
+
+    if (!stream_start_run(&rs, outfile)) {
+        ret = OUTPUT_FILE_ERROR;
+        goto cleanup;
+    }
+    if (!stream_merge_runs(&rs, 0, rs.run_paths->len) || !stream_finish_run(&rs)) {
+        ret = OUTPUT_FILE_ERROR;
+        goto cleanup;
+    }
+
+cleanup:
+    if (rs.pdh != NULL) {
+        wtap_dump_close(rs.pdh, NULL, &err, &err_info);
+        g_free(err_info);
+    }
+    if (rs.run_path != NULL) {
+        ws_unlink(rs.run_path);
+        g_free(rs.run_path);
+    }
+    for (i = 0; i < rs.run_paths->len; i++) {
+        if (rs.run_paths->pdata[i] != NULL)
+            ws_unlink((const char *) rs.run_paths->pdata[i]);
+    }
+    g_ptr_array_free(rs.run_paths, TRUE);
+
+    for (i = 0; i <= window; i++) {
+        wtap_rec_cleanup(&frames[i].rec);
+    }
+    g_free(frames);
+    g_ptr_array_free(heap, TRUE);
+    g_ptr_array_free(free_frames, TRUE);
+
+    g_free(rs.params.idb_inf);
+    rs.params.idb_inf = NULL;
+    wtap_dump_params_cleanup(&rs.params);
+
+    return ret;
+}
+
 /********************************************************************/
 /* Main function.                                                   */
 /********************************************************************/
@@ -149,6 +666,7 @@ main(int argc, char *argv[])
     int64_t data_offset;
     unsigned wrong_order_count = 0;
     bool write_output_regardless = true;
+    int32_t stream_window = 0;
     unsigned i;
     wtap_dump_params params;
     int                          ret = EXIT_SUCCESS;
@@ -163,7 +681,7 @@ main(int argc, char *argv[])
         LONGOPT_WSLOG
         {0, 0, 0, 0 }
     };
-#define OPTSTRING "hnv"
+#define OPTSTRING "hns:v"
     static const char optstring[] = OPTSTRING;
     int file_count;
     char *infile;
@@ -212,6 +730,12 @@ main(int argc, char *argv[])
             case 'n':
                 write_output_regardless = false;
                 break;
+            case 's':
+                if (!get_positive_int(ws_optarg, "streaming window", &stream_window)) {
+                    ret = WS_EXIT_INVALID_OPTION;
+                    goto clean_exit;
+                }
+                break;
             case 'h':
                 show_help_header("Reorder timestamps of input file frames into output file.");
                 print_usage(stdout);
@@ -254,6 +778,13 @@ main(int argc, char *argv[])
     }
     DEBUG_PRINT("file_type_subtype is %d\n", wtap_file_type_subtype(wth));
 
+    if (stream_window > 0) {
+        ret = reorder_streaming(wth, infile, outfile, (unsigned)stream_window,
+                                write_output_regardless);
+        wtap_close(wth);
+        goto clean_exit;
+    }
+
     /* Allocate the array of frame pointers. */
     frames = g_ptr_array_new();
 
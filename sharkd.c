@@ -29,6 +29,7 @@
 #include <wsutil/file_util.h>
 #include <wsutil/privileges.h>
 #include <wsutil/wslog.h>
+#include <wsutil/ws_assert.h>
 #include <wsutil/version_info.h>
 #include <wsutil/report_message.h>
 #include <wiretap/wtap_opttypes.h>
@@ -72,6 +73,9 @@ capture_file cfile;
 static uint32_t cum_bytes;
 static frame_data ref_frame;
 
+/* true if cfile was loaded by the daemon before the session was forked */
+static bool cfile_preloaded;
+
 /*
  * The leading + ensures that getopt_long() does not permute the argv[]
  * entries.
@@ -98,6 +102,7 @@ static const struct ws_option long_options[] = {
     {"help", ws_no_argument, NULL, 'h'},
     {"version", ws_no_argument, NULL, 'v'},
     {"config-profile", ws_required_argument, NULL, 'C'},
+    {"preload", ws_required_argument, NULL, LONGOPT_PRELOAD},
     LONGOPT_WSLOG
     {0, 0, 0, 0 }
 };
@@ -319,8 +324,8 @@ process_packet(capture_file *cf, epan_dissect_t *edt, int64_t offset,
          * if a display filter was given and it matches this packet.
          */
         if (edt && cf->dfcode) {
-            if (dfilter_apply_edt(cf->dfcode, edt) && edt->pi.fd->dependent_frames) {
-                g_hash_table_foreach(edt->pi.fd->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
+            if (dfilter_apply_edt(cf->dfcode, edt) && FRAME_DATA_DEPENDENT_FRAMES(edt->pi.fd)) {
+                g_hash_table_foreach(edt->pi.fd->extra->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
             }
         }
 
@@ -469,9 +474,36 @@ fail:
     return CF_ERROR;
 }
 
+static void
+close_preloaded_cap_file(capture_file *cf)
+{
+    if (cf->provider.wth) {
+        wtap_close(cf->provider.wth);
+        cf->provider.wth = NULL;
+    }
+    if (cf->provider.frames != NULL) {
+        free_frame_data_sequence(cf->provider.frames);
+        cf->provider.frames = NULL;
+    }
+    if (cf->provider.frames_modified_blocks) {
+        g_tree_destroy(cf->provider.frames_modified_blocks);
+        cf->provider.frames_modified_blocks = NULL;
+    }
+    g_free(cf->filename);
+    cf->filename = NULL;
+    cf->count = 0;
+    cum_bytes = 0;
+
+    cfile_preloaded = false;
+}
+
 cf_status_t
 sharkd_cf_open(const char *fname, unsigned int type, bool is_tempfile, int *err)
 {
+    /* The session wants some other file, or the same one with limits. */
+    if (cfile_preloaded)
+        close_preloaded_cap_file(&cfile);
+
     return cf_open(&cfile, fname, type, is_tempfile, err);
 }
 
@@ -487,6 +519,59 @@ sharkd_load_cap_file_with_limits(int max_packet_count, int64_t max_byte_count)
     return load_cap_file(&cfile, max_packet_count, max_byte_count);
 }
 
+/*
+ * Open and dissect a capture file in the daemon, before any session
+ * processes are forked; each session then starts with the file already
+ * loaded, sharing the daemon's first-pass state copy-on-write instead of
+ * redoing the first pass itself.
+ */
+int
+sharkd_preload_cap_file(const char *fname)
+{
+    int err = 0;
+
+    if (sharkd_cf_open(fname, WTAP_TYPE_AUTO, false, &err) != CF_OK)
+        return err;
+
+    err = load_cap_file(&cfile, 0, 0);
+    if (err != 0) {
+        close_preloaded_cap_file(&cfile);
+        return err;
+    }
+
+    cfile_preloaded = true;
+    return 0;
+}
+
+bool
+sharkd_cap_file_is_preloaded(const char *fname)
+{
+    return cfile_preloaded && cfile.filename != NULL &&
+        strcmp(cfile.filename, fname) == 0;
+}
+
+/*
+ * Called in a forked session process; the random-access file descriptor
+ * was inherited from the daemon, and shares its file offset with every
+ * other session, so give this session its own.
+ */
+int
+sharkd_reopen_preloaded_cap_file(void)
+{
+    int err = 0;
+
+    if (!cfile_preloaded)
+        return 0;
+
+    /* Don't share the parent's file offsets, nor leak its descriptors. */
+    wtap_fdclose(cfile.provider.wth);
+    if (!wtap_fdreopen(cfile.provider.wth, cfile.filename, &err)) {
+        /* A "load" request will have to read the file itself. */
+        close_preloaded_cap_file(&cfile);
+    }
+    return err;
+}
+
 frame_data *
 sharkd_get_frame(uint32_t framenum)
 {
@@ -555,9 +640,8 @@ sharkd_retap(void)
 {
     uint32_t         framenum;
     frame_data      *fdata;
-    wtap_rec         rec;
-    int err;
-    char *err_info = NULL;
+    cf_read_ahead_t *reader;
+    cf_read_ahead_slot_t *slot;
 
     unsigned      tap_flags;
     bool          create_proto_tree;
@@ -581,26 +665,29 @@ sharkd_retap(void)
     create_proto_tree =
         (have_filtering_tap_listeners() || (tap_flags & TL_REQUIRES_PROTO_TREE));
 
-    wtap_rec_init(&rec, 1514);
     epan_dissect_init(&edt, cfile.epan, create_proto_tree, false);
 
     reset_tap_listeners();
 
+    reader = cf_read_ahead_start(&cfile, 1, cfile.count, NULL);
     for (framenum = 1; framenum <= cfile.count; framenum++) {
         fdata = sharkd_get_frame(framenum);
 
-        if (!wtap_seek_read(cfile.provider.wth, fdata->file_off, &rec, &err, &err_info))
+        slot = cf_read_ahead_next(reader);
+        if (!slot->ok) {
+            cf_read_ahead_release(reader, slot);
             break;
+        }
 
         fdata->ref_time = false;
         fdata->frame_ref_num = 1;
         fdata->prev_dis_num = framenum - 1;
-        epan_dissect_run_with_taps(&edt, cfile.cd_t, &rec, fdata, cinfo);
-        wtap_rec_reset(&rec);
+        epan_dissect_run_with_taps(&edt, cfile.cd_t, &slot->rec, fdata, cinfo);
         epan_dissect_reset(&edt);
+        cf_read_ahead_release(reader, slot);
     }
+    cf_read_ahead_finish(reader);
 
-    wtap_rec_cleanup(&rec);
     epan_dissect_cleanup(&edt);
 
     draw_tap_listeners(true);
@@ -615,9 +702,8 @@ sharkd_filter(const char *dftext, uint8_t **result)
 
     uint32_t framenum, prev_dis_num = 0;
     uint32_t frames_count;
-    wtap_rec rec;
-    int err;
-    char *err_info = NULL;
+    cf_read_ahead_t *reader;
+    cf_read_ahead_slot_t *slot;
 
     uint8_t *result_bits;
     uint8_t passed_bits;
@@ -636,12 +722,12 @@ sharkd_filter(const char *dftext, uint8_t **result)
 
     frames_count = cfile.count;
 
-    wtap_rec_init(&rec, 1514);
     epan_dissect_init(&edt, cfile.epan, true, false);
 
     passed_bits = 0;
     result_bits = (uint8_t *) g_malloc(2 + (frames_count / 8));
 
+    reader = cf_read_ahead_start(&cfile, 1, frames_count, NULL);
     for (framenum = 1; framenum <= frames_count; framenum++) {
         frame_data *fdata = sharkd_get_frame(framenum);
 
@@ -650,8 +736,11 @@ sharkd_filter(const char *dftext, uint8_t **result)
             passed_bits = 0;
         }
 
-        if (!wtap_seek_read(cfile.provider.wth, fdata->file_off, &rec, &err, &err_info))
+        slot = cf_read_ahead_next(reader);
+        if (!slot->ok) {
+            cf_read_ahead_release(reader, slot);
             break;
+        }
 
         /* frame_data_set_before_dissect */
         epan_dissect_prime_with_dfilter(&edt, dfcode);
@@ -659,7 +748,7 @@ sharkd_filter(const char *dftext, uint8_t **result)
         fdata->ref_time = false;
         fdata->frame_ref_num = 1;
         fdata->prev_dis_num = prev_dis_num;
-        epan_dissect_run(&edt, cfile.cd_t, &rec, fdata, NULL);
+        epan_dissect_run(&edt, cfile.cd_t, &slot->rec, fdata, NULL);
 
         if (dfilter_apply_edt(dfcode, &edt)) {
             passed_bits |= (1 << (framenum % 8));
@@ -668,15 +757,15 @@ sharkd_filter(const char *dftext, uint8_t **result)
 
         /* if passed or ref -> frame_data_set_after_dissect */
 
-        wtap_rec_reset(&rec);
         epan_dissect_reset(&edt);
+        cf_read_ahead_release(reader, slot);
     }
+    cf_read_ahead_finish(reader);
 
     if ((framenum & 7) == 0)
         framenum--;
     result_bits[framenum / 8] = passed_bits;
 
-    wtap_rec_cleanup(&rec);
     epan_dissect_cleanup(&edt);
 
     dfilter_free(dfcode);
@@ -29,11 +29,15 @@
 typedef void (*sharkd_dissect_func_t)(epan_dissect_t *edt, proto_tree *tree, struct epan_column_info *cinfo, const GSList *data_src, void *data);
 
 #define LONGOPT_FOREGROUND 4000
+#define LONGOPT_PRELOAD    4001
 
 /* sharkd.c */
 cf_status_t sharkd_cf_open(const char *fname, unsigned int type, bool is_tempfile, int *err);
 int sharkd_load_cap_file(void);
 int sharkd_load_cap_file_with_limits(int max_packet_count, int64_t max_byte_count);
+int sharkd_preload_cap_file(const char *fname);
+bool sharkd_cap_file_is_preloaded(const char *fname);
+int sharkd_reopen_preloaded_cap_file(void);
 int sharkd_retap(void);
 int sharkd_filter(const char *dftext, uint8_t **result);
 frame_data *sharkd_get_frame(uint32_t framenum);
@@ -58,6 +58,7 @@
 
 static int mode;
 static socket_handle_t _server_fd = INVALID_SOCKET;
+static char *preload_filename;
 
 static socket_handle_t
 socket_init(char *path)
@@ -201,6 +202,9 @@ print_usage(FILE* output)
     fprintf(output, "  -v, --version            show version information\n");
     fprintf(output, "  -C <config profile>, --config-profile <config profile>\n");
     fprintf(output, "                           start with specified configuration profile\n");
+    fprintf(output, "  --preload <file>         load this capture file once in the daemon; sessions\n");
+    fprintf(output, "                           that load it start without reading it again,\n");
+    fprintf(output, "                           unless they have changed a preference (needs --api)\n");
 
     fprintf(output, "\n");
     fprintf(output, "Supported socket types:\n");
@@ -353,6 +357,15 @@ sharkd_init(int argc, char **argv)
                     foreground = true;
                     break;
 
+                case LONGOPT_PRELOAD:
+#ifndef _WIN32
+                    preload_filename = ws_optarg;
+#else
+                    fputs("--preload is not supported on Windows.\n", stderr);
+                    return -1;
+#endif
+                    break;
+
                 default:
                     /* wslog arguments are okay */
                     if (ws_log_is_wslog_arg(opt))
@@ -365,6 +378,16 @@ sharkd_init(int argc, char **argv)
                     break;
             }
         } while (opt != -1);
+
+        /*
+         * A console session has no daemon to share the file with;
+         * it would only read the file before it's asked to.
+         */
+        if (preload_filename != NULL && mode == SHARKD_MODE_GOLD_CONSOLE)
+        {
+            fputs("--preload can only be used with --api.\n", stderr);
+            return -1;
+        }
     }
 
     if (!foreground && (mode == SHARKD_MODE_CLASSIC_DAEMON || mode == SHARKD_MODE_GOLD_DAEMON))
@@ -398,6 +421,14 @@ sharkd_loop(int argc _U_, char* argv[])
         return sharkd_session_main(mode);
     }
 
+    if (preload_filename != NULL)
+    {
+        /* Failures have already been reported. */
+        fprintf(stderr, "Preloading capture file: %s\n", preload_filename);
+        if (sharkd_preload_cap_file(preload_filename) != 0)
+            return -1;
+    }
+
     while (1)
     {
 #ifndef _WIN32
@@ -430,6 +461,9 @@ sharkd_loop(int argc _U_, char* argv[])
             dup2(fd, 1);
             close(fd);
 
+            if (sharkd_reopen_preloaded_cap_file() != 0)
+                fprintf(stderr, "cannot reopen preloaded capture file, it will be read again on load\n");
+
             exit(sharkd_session_main(mode));
         }
 
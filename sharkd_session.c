@@ -87,6 +87,13 @@ static GHashTable *filter_table;
 static int mode;
 static uint32_t rpcid;
 
+/*
+ * Set once this session has changed a preference; a file preloaded by
+ * the daemon was dissected with the daemon's preferences, so it can't
+ * be used after that.
+ */
+static bool session_prefs_changed;
+
 static json_dumper dumper;
 
 
@@ -1333,6 +1340,14 @@ sharkd_session_process_load(const char *buf, const jsmntok_t *tokens, int count)
     fprintf(stderr, "load: filename=%s, max_packets=%u, max_bytes=%" PRIu64 "\n",
             tok_file, max_packets, max_bytes);
 
+    if (max_packets == 0 && max_bytes == 0 && !session_prefs_changed &&
+        sharkd_cap_file_is_preloaded(tok_file))
+    {
+        /* Already read by the daemon before this session was started. */
+        sharkd_json_simple_ok(rpcid);
+        return;
+    }
+
     if (sharkd_cf_open(tok_file, WTAP_TYPE_AUTO, false, &err) != CF_OK)
     {
         sharkd_json_error(
@@ -5431,6 +5446,7 @@ sharkd_session_process_setconf(char *buf, const jsmntok_t *tokens, int count)
     switch (ret)
     {
         case PREFS_SET_OK:
+            session_prefs_changed = true;
             sharkd_json_simple_ok(rpcid);
             break;
 
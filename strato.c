@@ -2375,8 +2375,8 @@ process_packet_first_pass(capture_file *cf, epan_dissect_t *edt,
          */
         if (edt && cf->dfcode) {
             elapsed_start = g_get_monotonic_time();
-            if (dfilter_apply_edt(cf->dfcode, edt) && edt->pi.fd->dependent_frames) {
-                g_hash_table_foreach(edt->pi.fd->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
+            if (dfilter_apply_edt(cf->dfcode, edt) && FRAME_DATA_DEPENDENT_FRAMES(edt->pi.fd)) {
+                g_hash_table_foreach(edt->pi.fd->extra->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
             }
 
             if (selected_frame_number != 0 && selected_frame_number == cf->count + 1) {
@@ -14,7 +14,7 @@ import os
 import socket
 import subprocess
 import subprocesstest
-from subprocesstest import cat_dhcp_command, cat_cap_file_command, count_output, grep_output, check_packet_count
+from subprocesstest import ExitCodes, cat_dhcp_command, cat_cap_file_command, count_output, grep_output, check_packet_count
 from suite_text2pcap import check_capinfos_info
 import sys
 import threading
@@ -552,6 +552,30 @@ class TestDumpcapCapture:
         check_capture_snapshot_len(self, cmd=cmd_dumpcap, env=base_env)
 
 
+class TestDumpcapFanout:
+    @pytest.fixture(autouse=True)
+    def skip_unless_linux(self):
+        if not sys.platform.startswith('linux'):
+            pytest.skip('--fanout requires Linux PACKET_FANOUT support.')
+
+    def test_dumpcap_fanout_usage(self, cmd_dumpcap, base_env):
+        '''--fanout is listed in Dumpcap's usage'''
+        process = subprocesstest.run((cmd_dumpcap, '-h'), capture_output=True, env=base_env)
+        assert process.returncode == ExitCodes.OK
+        assert grep_output(process.stdout, '--fanout <queues>')
+
+    def test_dumpcap_fanout_invalid(self, cmd_dumpcap, base_env):
+        '''Invalid --fanout queue counts'''
+        for queues in ('0', '-1', 'many'):
+            process = subprocesstest.run((cmd_dumpcap, '--fanout', queues, '-i', '-'), capture_output=True, env=base_env)
+            assert process.returncode == ExitCodes.COMMAND_LINE
+            assert grep_output(process.stderr, 'number of fanout queues')
+
+    def test_dumpcap_fanout_from_stdin(self, cmd_dumpcap, check_capture_stdin, base_env):
+        '''--fanout leaves sources that aren't AF_PACKET sockets on a single reader'''
+        check_capture_stdin(self, cmd=(cmd_dumpcap, '--fanout', '2'), env=base_env)
+
+
 class TestDumpcapAutostop:
     # duration, filesize, packets, files
     def test_dumpcap_autostop_filesize(self, check_dumpcap_autostop_stdin, base_env):
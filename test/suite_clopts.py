@@ -129,6 +129,35 @@ class TestTsharkOptions:
         assert obj.get('ip.proto', 'NOT FOUND') == ['6']
         assert obj.get('http.host', 'NOT FOUND') == 'NOT FOUND'
 
+    def test_tshark_read_ahead_limit(self, cmd_tshark, capture_file, test_env):
+        '''--read-ahead rejects counts above its maximum'''
+        process = subprocesstest.run((cmd_tshark, '-r', capture_file('dhcp.pcap'),
+                    '--read-ahead', '65537'), capture_output=True, env=test_env)
+        assert process.returncode == ExitCodes.COMMAND_LINE
+        assert grep_output(process.stderr, 'larger than the maximum')
+        process = subprocesstest.run((cmd_tshark, '-r', capture_file('dhcp.pcap'),
+                    '--read-ahead', '65536'), env=test_env)
+        assert process.returncode == ExitCodes.OK
+
+    @pytest.mark.parametrize('args', (
+        ('-r', 'dhcp.pcap', '-V'),
+        ('-r', 'dns+icmp.pcapng.gz', '-V'),
+        ('-r', 'dtls12-aes128ccm8-dsb.pcapng', '-V'),
+        ('-r', 'http2-data-reassembly.pcap', '-Y', 'http2.data.data'),
+        ('-r', 'http2-data-reassembly.pcap', '-2', '-V'),
+        ('-r', 'sip-rtp.pcapng', '-2', '-Y', 'rtp.marker == 1'),
+    ))
+    def test_tshark_read_ahead_output(self, cmd_tshark, capture_file, test_env, args):
+        '''--read-ahead doesn't change what is dissected or printed'''
+        args = (cmd_tshark, args[0], capture_file(args[1])) + args[2:]
+        expected = subprocesstest.run(args, capture_output=True, env=test_env)
+        assert expected.returncode == ExitCodes.OK
+        for records in ('1', '64'):
+            process = subprocesstest.run(args + ('--read-ahead', records),
+                        capture_output=True, env=test_env)
+            assert process.returncode == ExitCodes.OK
+            assert process.stdout == expected.stdout
+
 
 class TestTsharkCaptureClopts:
     def test_tshark_invalid_capfilter(self, cmd_tshark, capture_interface, result_file, test_env):
@@ -180,6 +180,21 @@ class TestDfilterInteger:
         dfilter = "ip.version > ntp.precision"
         checkDFilterCount(dfilter, 1)
 
+    def test_field_cmp_1(self, checkDFilterCount):
+        # The same field compared with several constants.
+        dfilter = "udp.srcport == 124 || udp.srcport == 123"
+        checkDFilterCount(dfilter, 1)
+
+    def test_field_cmp_2(self, checkDFilterCount):
+        # The field's register is also used by a set membership test.
+        dfilter = "udp.srcport == 123 && udp.srcport in {123, 124}"
+        checkDFilterCount(dfilter, 1)
+
+    def test_field_cmp_3(self, checkDFilterCount):
+        # Absent field.
+        dfilter = "tcp.srcport == 123 || ip.version == 4"
+        checkDFilterCount(dfilter, 1)
+
 class TestDfilterInteger1Byte:
 
     trace_file = "ipx_rip.pcap"
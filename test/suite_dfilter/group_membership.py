@@ -134,3 +134,20 @@ class TestDfilterMembership:
     def test_membership_rhs_field(self, checkDFilterCount):
         dfilter = 'eth.src in { eth.addr }'
         checkDFilterCount(dfilter, 1)
+
+    def test_membership_overlapping_ranges_1(self, checkDFilterCount):
+        dfilter = 'tcp.port in {1..100, 50..60}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_overlapping_ranges_2(self, checkDFilterCount):
+        dfilter = 'tcp.port in {1..10, 81..90, 5..79}'
+        checkDFilterCount(dfilter, 0)
+
+    def test_membership_elements_and_ranges(self, checkDFilterCount):
+        dfilter = 'tcp.port in {1, 2, 3, 4, 5, 3000..3300}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_ip_subnet(self, checkDFilterCount):
+        # The host address is hashed, the subnet is compared using its netmask.
+        dfilter = 'ip.addr in {192.0.2.1, 10.0.0.0/8}'
+        checkDFilterCount(dfilter, 1)
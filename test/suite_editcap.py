@@ -0,0 +1,80 @@
+#
+# Wireshark tests
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Editcap tests'''
+
+import struct
+import subprocess
+import pytest
+from subprocesstest import check_packet_count, grep_output
+
+testin_pcap = 'testin.pcap'
+testshifted_pcap = 'testshifted.pcap'
+testmerged_pcapng = 'testmerged.pcapng'
+testout_pcapng = 'testout.pcapng'
+
+n_frames = 20
+
+
+def write_distinct_pcap(path):
+    '''Write a pcap file of n_frames frames with distinct data, one second
+    apart.'''
+    with open(path, 'wb') as f:
+        # Microsecond pcap, Ethernet, snaplen 65535
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for num in range(n_frames):
+            data = struct.pack('>I', num) + bytes(56)
+            f.write(struct.pack('<IIII', num + 1, 0, len(data), len(data)))
+            f.write(data)
+
+
+@pytest.fixture
+def dup_capture(cmd_editcap, cmd_mergecap, result_file, test_env):
+    '''Return a capture that has each frame of a n_frames frame capture
+    twice. The copy is either merged in chronologically with the given
+    time shift, or, if shift is None, appended after all the originals.'''
+    def dup_capture_real(shift):
+        testin_file = result_file(testin_pcap)
+        testshifted_file = result_file(testshifted_pcap)
+        testmerged_file = result_file(testmerged_pcapng)
+        write_distinct_pcap(testin_file)
+        if shift is None:
+            merge_args = ('-a', testin_file, testin_file)
+        else:
+            subprocess.check_call((cmd_editcap, '-t', shift, testin_file, testshifted_file), env=test_env)
+            merge_args = (testin_file, testshifted_file)
+        subprocess.check_call((cmd_mergecap, '-w', testmerged_file) + merge_args,
+            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, env=test_env)
+        return testmerged_file
+    return dup_capture_real
+
+
+class TestEditcapDedup:
+    # (time shift of the copy, editcap options, packets skipped)
+    @pytest.mark.parametrize('shift, dedup_args, skipped', [
+        # Each frame is followed by its copy.
+        ('0', ('-d',), n_frames),
+        ('0', ('-D', '5'), n_frames),
+        ('0', ('-w', '0.5'), n_frames),
+        ('0.25', ('-w', '0.5'), n_frames),
+        ('0.75', ('-w', '0.5'), 0),
+        # Each copy comes n_frames packets after the frame, with a timestamp
+        # earlier than the packets in between.
+        (None, ('-d',), 0),
+        (None, ('-D', '5'), 0),
+        (None, ('-D', str(n_frames)), 0),
+        (None, ('-D', str(n_frames + 1)), n_frames),
+        (None, ('-w', '0.5'), n_frames),
+    ])
+    def test_editcap_dedup(self, cmd_editcap, cmd_capinfos, dup_capture, result_file, test_env, shift, dedup_args, skipped):
+        '''Remove the duplicates from a capture merged with itself'''
+        testmerged_file = dup_capture(shift)
+        testout_file = result_file(testout_pcapng)
+
+        editcap_proc = subprocess.run((cmd_editcap,) + dedup_args + (testmerged_file, testout_file),
+            capture_output=True, encoding='utf-8', env=test_env)
+        assert editcap_proc.returncode == 0
+        assert grep_output(editcap_proc.stderr, r'^{} packets seen, {} packets? skipped '.format(2 * n_frames, skipped))
+        check_packet_count(cmd_capinfos, 2 * n_frames - skipped, testout_file)
@@ -0,0 +1,84 @@
+#
+# Wireshark tests
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Reordercap tests'''
+
+import random
+import struct
+import subprocess
+import pytest
+
+testin_pcap = 'testin.pcap'
+testout_pcap = 'testout.pcap'
+testout_stream_pcap = 'testout-stream.pcap'
+
+
+def write_disordered_pcap(path, n_frames, max_secs, seed):
+    '''Write a pcap file whose timestamps are in random order, with many
+    frames sharing each timestamp. Each frame's data is its position in the
+    file, so that the order of frames with equal timestamps can be checked.'''
+    rng = random.Random(seed)
+    with open(path, 'wb') as f:
+        # Microsecond pcap, Ethernet, snaplen 65535
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for num in range(n_frames):
+            secs = rng.randrange(max_secs)
+            data = struct.pack('>I', num) + bytes(56)
+            f.write(struct.pack('<IIII', secs, 0, len(data), len(data)))
+            f.write(data)
+
+
+def read_pcap_frames(path):
+    '''Return (timestamp, position in the input file) for each frame.'''
+    frames = []
+    with open(path, 'rb') as f:
+        f.read(24)
+        while True:
+            header = f.read(16)
+            if len(header) < 16:
+                break
+            secs, usecs, caplen, _ = struct.unpack('<IIII', header)
+            data = f.read(caplen)
+            frames.append(((secs, usecs), struct.unpack('>I', data[:4])[0]))
+    return frames
+
+
+class TestReordercapStreaming:
+    # A window much smaller than the disorder of the input, so that many
+    # sorted runs are written to temporary files; with more than 64 runs,
+    # some are merged into intermediate runs before the final merge.
+    @pytest.mark.parametrize('window', ['2', '16', '1000'])
+    def test_reordercap_streaming(self, cmd_reordercap, result_file, window, test_env):
+        '''Sort in streaming mode and compare with the default mode'''
+        testin_file = result_file(testin_pcap)
+        testout_file = result_file(testout_pcap)
+        testout_stream_file = result_file(testout_stream_pcap)
+        write_disordered_pcap(testin_file, 600, 40, 22)
+
+        subprocess.check_call((cmd_reordercap, testin_file, testout_file),
+            stdout=subprocess.DEVNULL, env=test_env)
+        subprocess.check_call((cmd_reordercap, '-s', window, testin_file, testout_stream_file),
+            stdout=subprocess.DEVNULL, env=test_env)
+
+        with open(testout_file, 'rb') as f:
+            expected = f.read()
+        with open(testout_stream_file, 'rb') as f:
+            assert f.read() == expected
+
+        # Sorted, and stable: frames with equal timestamps keep their order.
+        frames = read_pcap_frames(testout_stream_file)
+        assert len(frames) == 600
+        assert frames == sorted(frames)
+
+    def test_reordercap_streaming_in_order(self, cmd_reordercap, result_file, test_env):
+        '''Honour -n in streaming mode'''
+        testin_file = result_file(testin_pcap)
+        testout_file = result_file(testout_pcap)
+        write_disordered_pcap(testin_file, 100, 1, 22)
+
+        reordercap_proc = subprocess.run((cmd_reordercap, '-n', '-s', '4', testin_file, testout_file),
+            capture_output=True, encoding='utf-8', env=test_env)
+        assert reordercap_proc.returncode == 0
+        assert 'Not writing output file' in reordercap_proc.stdout
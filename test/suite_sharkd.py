@@ -9,7 +9,10 @@
 '''sharkd tests'''
 
 import json
+import os
+import socket
 import subprocess
+import time
 import pytest
 from matchers import *
 
@@ -53,6 +56,60 @@ def check_sharkd_session(run_sharkd_session):
 
 
 class TestSharkd:
+    def test_sharkd_preload_needs_api(self, cmd_sharkd, capture_file, base_env):
+        '''--preload is rejected without a daemon socket'''
+        process = subprocess.run(
+            (cmd_sharkd, '--preload', capture_file('dhcp.pcap')),
+            stdin=subprocess.DEVNULL, capture_output=True, encoding='utf-8', env=base_env)
+        assert process.returncode != 0
+        assert '--preload can only be used with --api' in process.stderr
+
+    def test_sharkd_preload_two_sessions(self, cmd_sharkd, capture_file, base_env, tmp_path):
+        '''Sessions of a daemon with --preload each see the preloaded frames'''
+        sock_path = str(tmp_path / 'sharkd.sock')
+        pcap_path = capture_file('dhcp.pcap')
+        daemon_proc = subprocess.Popen(
+            (cmd_sharkd, '--foreground', '--api', 'unix:' + sock_path, '--preload', pcap_path),
+            stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+            encoding='utf-8', env=base_env)
+
+        def run_session(sharkd_commands):
+            for _ in range(100):
+                if os.path.exists(sock_path):
+                    break
+                assert daemon_proc.poll() is None
+                time.sleep(0.1)
+            with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+                sock.settimeout(30)
+                sock.connect(sock_path)
+                sock.sendall('\n'.join(json.dumps(x) for x in sharkd_commands).encode('utf-8') + b'\n')
+                sock.shutdown(socket.SHUT_WR)
+                stdout = b''
+                while True:
+                    data = sock.recv(65536)
+                    if not data:
+                        break
+                    stdout += data
+            return [json.loads(line) for line in stdout.decode('utf-8').splitlines() if line.strip()]
+
+        try:
+            for _ in range(2):
+                outputs = run_session((
+                    {"jsonrpc":"2.0", "id":1, "method":"load",
+                    "params":{"file": pcap_path}
+                    },
+                    {"jsonrpc":"2.0", "id":2, "method":"status"},
+                    {"jsonrpc":"2.0", "id":3, "method":"frames"},
+                ))
+                assert outputs[0] == {"jsonrpc":"2.0","id":1,"result":{"status":"OK"}}
+                assert outputs[1]['result']['frames'] == 4
+                assert [frame['num'] for frame in outputs[2]['result']] == [1, 2, 3, 4]
+        finally:
+            daemon_proc.terminate()
+            _, stderr = daemon_proc.communicate()
+        assert 'Preloading capture file' in stderr
+        assert 'cannot reopen preloaded capture file' not in stderr
+
     def test_sharkd_req_load_bad_pcap(self, check_sharkd_session, capture_file):
         check_sharkd_session((
             {"jsonrpc":"2.0", "id":1, "method":"load",
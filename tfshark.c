@@ -1043,8 +1043,8 @@ process_packet_first_pass(capture_file *cf, epan_dissect_t *edt,
          * More importantly, edt.pi.fd.dependent_frames won't be initialized because
          * epan hasn't been initialized.
          */
-        if (edt && edt->pi.fd->dependent_frames) {
-            g_hash_table_foreach(edt->pi.fd->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
+        if (edt && FRAME_DATA_DEPENDENT_FRAMES(edt->pi.fd)) {
+            g_hash_table_foreach(edt->pi.fd->extra->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
         }
 
         cf->count++;
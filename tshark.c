@@ -97,6 +97,7 @@
 #include <epan/rtd_table.h>
 #include <epan/ex-opt.h>
 #include <epan/exported_pdu.h>
+#include <epan/reassemble.h>
 #include <epan/secrets.h>
 
 #include "capture/capture-pcap-util.h"
@@ -143,6 +144,9 @@
 #define LONGOPT_PRINT_TIMERS            LONGOPT_BASE_APPLICATION+9
 #define LONGOPT_GLOBAL_PROFILE          LONGOPT_BASE_APPLICATION+10
 #define LONGOPT_COMPRESS                LONGOPT_BASE_APPLICATION+11
+#define LONGOPT_READ_AHEAD              LONGOPT_BASE_APPLICATION+12
+#define LONGOPT_REASSEMBLY_MEMORY_LIMIT LONGOPT_BASE_APPLICATION+13
+#define LONGOPT_EVICT_IDLE              LONGOPT_BASE_APPLICATION+14
 
 capture_file cfile;
 
@@ -155,8 +159,39 @@ static bool perform_two_pass_analysis;
 static uint32_t epan_auto_reset_count;
 static bool epan_auto_reset;
 
+/*
+ * Conversations and reassemblies idle for this many seconds of packet
+ * time are evicted in single-pass mode; 0 means nothing is evicted.
+ */
+static uint32_t evict_idle_secs;
+
+/* The first frame seen in each second of packet time, oldest first. */
+typedef struct {
+    uint32_t frame;
+    time_t secs;
+} evict_checkpoint_t;
+static GArray *evict_checkpoints;
+static time_t evict_next_sweep;
+
 static uint32_t selected_frame_number;
 
+/*
+ * Number of records to read ahead on a separate thread when reading
+ * a capture file; 0 means records are read on the dissection thread.
+ * The file's own read-ahead only prefetches raw bytes; this also takes
+ * decompression and record parsing off the dissection thread.
+ */
+static int32_t read_ahead_records;
+
+/*
+ * Each read-ahead slot has its own record buffer, so don't let a typo
+ * allocate gigabytes of them.
+ */
+#define READ_AHEAD_MAX_RECORDS  65536
+
+/* Protects the wtap while a read-ahead thread is running. */
+static GMutex read_ahead_wth_mtx;
+
 /*
  * The way the packet decode is to be written.
  */
@@ -246,6 +281,7 @@ static void report_counts_siginfo(int);
 #endif /* HAVE_LIBPCAP */
 
 static void reset_epan_mem(capture_file *cf, epan_dissect_t *edt, bool tree, bool visual);
+static void evict_idle_state(capture_file *cf, const wtap_rec *rec);
 
 typedef enum {
     PROCESS_FILE_SUCCEEDED,
@@ -484,6 +520,13 @@ print_usage(FILE *output)
     fprintf(output, "Processing:\n");
     fprintf(output, "  -2                       perform a two-pass analysis\n");
     fprintf(output, "  -M <packet count>        perform session auto reset\n");
+    fprintf(output, "  --evict-idle <seconds>   forget conversations and reassemblies idle for\n");
+    fprintf(output, "                           this long\n");
+    fprintf(output, "  --read-ahead <records>   read up to this many records ahead of the dissector\n");
+    fprintf(output, "                           on a separate thread (at most 65536)\n");
+    fprintf(output, "  --reassembly-memory-limit <MiB>\n");
+    fprintf(output, "                           spill reassembled data beyond this size to a\n");
+    fprintf(output, "                           temporary file\n");
     fprintf(output, "  -R <read filter>, --read-filter <read filter>\n");
     fprintf(output, "                           packet Read filter in Wireshark display filter syntax\n");
     fprintf(output, "                           (requires -2)\n");
@@ -1063,6 +1106,9 @@ main(int argc, char *argv[])
         {"print-timers", ws_no_argument, NULL, LONGOPT_PRINT_TIMERS},
         {"global-profile", ws_no_argument, NULL, LONGOPT_GLOBAL_PROFILE},
         {"compress", ws_required_argument, NULL, LONGOPT_COMPRESS},
+        {"read-ahead", ws_required_argument, NULL, LONGOPT_READ_AHEAD},
+        {"reassembly-memory-limit", ws_required_argument, NULL, LONGOPT_REASSEMBLY_MEMORY_LIMIT},
+        {"evict-idle", ws_required_argument, NULL, LONGOPT_EVICT_IDLE},
         {0, 0, 0, 0}
     };
     bool                 arg_error = false;
@@ -1423,6 +1469,10 @@ main(int argc, char *argv[])
                     cmdarg_err("-2 does not support auto session reset.");
                     arg_error=true;
                 }
+                if (evict_idle_secs != 0) {
+                    cmdarg_err("-2 does not support idle state eviction.");
+                    arg_error = true;
+                }
                 perform_two_pass_analysis = true;
                 break;
             case 'M':
@@ -1931,6 +1981,39 @@ main(int argc, char *argv[])
             case LONGOPT_PRINT_TIMERS:
                 opt_print_timers = true;
                 break;
+            case LONGOPT_READ_AHEAD:
+                if (!get_natural_int(ws_optarg, "read-ahead record count", &read_ahead_records)) {
+                    exit_status = WS_EXIT_INVALID_OPTION;
+                    goto clean_exit;
+                }
+                if (read_ahead_records > READ_AHEAD_MAX_RECORDS) {
+                    cmdarg_err("The read-ahead record count %d is larger than the maximum of %d.",
+                               read_ahead_records, READ_AHEAD_MAX_RECORDS);
+                    exit_status = WS_EXIT_INVALID_OPTION;
+                    goto clean_exit;
+                }
+                break;
+            case LONGOPT_REASSEMBLY_MEMORY_LIMIT:
+            {
+                uint32_t limit_mib;
+
+                if (!get_nonzero_uint32(ws_optarg, "reassembly memory limit", &limit_mib)) {
+                    exit_status = WS_EXIT_INVALID_OPTION;
+                    goto clean_exit;
+                }
+                reassembly_set_memory_limit((size_t)limit_mib * 1024 * 1024);
+                break;
+            }
+            case LONGOPT_EVICT_IDLE:
+                if (perform_two_pass_analysis) {
+                    cmdarg_err("--evict-idle does not support two-pass analysis.");
+                    arg_error = true;
+                }
+                if (!get_nonzero_uint32(ws_optarg, "idle eviction time", &evict_idle_secs)) {
+                    exit_status = WS_EXIT_INVALID_OPTION;
+                    goto clean_exit;
+                }
+                break;
             case LONGOPT_GLOBAL_PROFILE:
                 /* already processed; just ignore it now */
                 break;
@@ -2943,19 +3026,100 @@ clean_exit:
 bool loop_running;
 uint32_t packet_count;
 
+/*
+ * Packet provider routines that look at the wtap; they have to hold
+ * read_ahead_wth_mtx, as a read-ahead thread might be reading from it.
+ */
+static const nstime_t *
+tshark_get_start_ts(struct packet_provider_data *prov)
+{
+    const nstime_t *ts;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    ts = cap_file_provider_get_start_ts(prov);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return ts;
+}
+
+static const nstime_t *
+tshark_get_end_ts(struct packet_provider_data *prov)
+{
+    const nstime_t *ts;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    ts = cap_file_provider_get_end_ts(prov);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return ts;
+}
+
+static const char *
+tshark_get_interface_name(struct packet_provider_data *prov, uint32_t interface_id, unsigned section_number)
+{
+    const char *name;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    name = cap_file_provider_get_interface_name(prov, interface_id, section_number);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return name;
+}
+
+static const char *
+tshark_get_interface_description(struct packet_provider_data *prov, uint32_t interface_id, unsigned section_number)
+{
+    const char *description;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    description = cap_file_provider_get_interface_description(prov, interface_id, section_number);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return description;
+}
+
+static int32_t
+tshark_get_process_id(struct packet_provider_data *prov, uint32_t process_info_id, unsigned section_number)
+{
+    int32_t process_id;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    process_id = cap_file_provider_get_process_id(prov, process_info_id, section_number);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return process_id;
+}
+
+static const char *
+tshark_get_process_name(struct packet_provider_data *prov, uint32_t process_info_id, unsigned section_number)
+{
+    const char *process_name;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    process_name = cap_file_provider_get_process_name(prov, process_info_id, section_number);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return process_name;
+}
+
+static const uint8_t *
+tshark_get_process_uuid(struct packet_provider_data *prov, uint32_t process_info_id, unsigned section_number, size_t *uuid_size)
+{
+    const uint8_t *uuid;
+
+    g_mutex_lock(&read_ahead_wth_mtx);
+    uuid = cap_file_provider_get_process_uuid(prov, process_info_id, section_number, uuid_size);
+    g_mutex_unlock(&read_ahead_wth_mtx);
+    return uuid;
+}
+
 static epan_t *
 tshark_epan_new(capture_file *cf)
 {
     static const struct packet_provider_funcs funcs = {
         cap_file_provider_get_frame_ts,
-        cap_file_provider_get_start_ts,
-        cap_file_provider_get_end_ts,
-        cap_file_provider_get_interface_name,
-        cap_file_provider_get_interface_description,
+        tshark_get_start_ts,
+        tshark_get_end_ts,
+        tshark_get_interface_name,
+        tshark_get_interface_description,
         NULL,
-        cap_file_provider_get_process_id,
-        cap_file_provider_get_process_name,
-        cap_file_provider_get_process_uuid,
+        tshark_get_process_id,
+        tshark_get_process_name,
+        tshark_get_process_uuid,
     };
 
     return epan_new(&cf->provider, &funcs);
@@ -3502,8 +3666,8 @@ process_packet_first_pass(capture_file *cf, epan_dissect_t *edt,
          */
         if (edt && cf->dfcode) {
             elapsed_start = g_get_monotonic_time();
-            if (dfilter_apply_edt(cf->dfcode, edt) && edt->pi.fd->dependent_frames) {
-                g_hash_table_foreach(edt->pi.fd->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
+            if (dfilter_apply_edt(cf->dfcode, edt) && FRAME_DATA_DEPENDENT_FRAMES(edt->pi.fd)) {
+                g_hash_table_foreach(edt->pi.fd->extra->dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
             }
 
             if (selected_frame_number != 0 && selected_frame_number == cf->count + 1) {
@@ -3580,17 +3744,297 @@ typedef enum {
     PASS_INTERRUPTED
 } pass_status_t;
 
+/*
+ * Read-ahead of records from the capture file.
+ *
+ * Dissection state is global to libwireshark, so records still have to
+ * be dissected one at a time and in order; what can be taken off the
+ * dissection thread is the work done by libwiretap (reading, decompressing
+ * and parsing the file).  A reader thread fills a fixed set of wtap_rec
+ * slots, which are handed to the dissection thread in file order and
+ * returned to the reader once they've been processed.
+ *
+ * The callbacks that libwiretap invokes while reading (name resolution
+ * and decryption secrets) update libwireshark state, so the reader thread
+ * queues them in file order along with the records and they're delivered
+ * on the dissection thread.  Anything else that looks at the wtap while
+ * the reader thread is running must hold read_ahead_wth_mtx.
+ */
+typedef enum {
+    READ_AHEAD_RECORD,
+    READ_AHEAD_IPV4_NAME,
+    READ_AHEAD_IPV6_NAME,
+    READ_AHEAD_SECRETS,
+    READ_AHEAD_END
+} read_ahead_item_type_e;
+
+typedef struct {
+    wtap_rec    rec;
+    int64_t     data_offset;
+} read_ahead_slot_t;
+
+typedef struct {
+    read_ahead_item_type_e type;
+    read_ahead_slot_t     *slot;        /* READ_AHEAD_RECORD */
+    unsigned               ipv4_addr;   /* READ_AHEAD_IPV4_NAME */
+    ws_in6_addr            ipv6_addr;   /* READ_AHEAD_IPV6_NAME */
+    uint32_t               secrets_type;/* READ_AHEAD_SECRETS */
+    void                  *data;        /* name or secrets */
+    unsigned               size;
+    bool                   static_entry;
+    int                    err;         /* READ_AHEAD_END */
+    char                  *err_info;
+} read_ahead_item_t;
+
+typedef struct {
+    wtap               *wth;
+    GThread            *thread;
+    read_ahead_slot_t  *slots;
+    unsigned            num_slots;
+    GAsyncQueue        *free_slots;     /* slots the reader may fill */
+    GAsyncQueue        *items;          /* read_ahead_item_t, in file order */
+    read_ahead_slot_t  *current;        /* slot being dissected */
+    int                 stop;
+} read_ahead_t;
+
+/* The active reader, for the libwiretap callbacks. */
+static read_ahead_t *read_ahead;
+
+static void
+read_ahead_queue_ipv4_name(const unsigned addr, const char *name, const bool static_entry)
+{
+    read_ahead_item_t *item = g_new0(read_ahead_item_t, 1);
+
+    item->type = READ_AHEAD_IPV4_NAME;
+    item->ipv4_addr = addr;
+    item->data = g_strdup(name);
+    item->static_entry = static_entry;
+    g_async_queue_push(read_ahead->items, item);
+}
+
+static void
+read_ahead_queue_ipv6_name(const ws_in6_addr *addrp, const char *name, const bool static_entry)
+{
+    read_ahead_item_t *item = g_new0(read_ahead_item_t, 1);
+
+    item->type = READ_AHEAD_IPV6_NAME;
+    item->ipv6_addr = *addrp;
+    item->data = g_strdup(name);
+    item->static_entry = static_entry;
+    g_async_queue_push(read_ahead->items, item);
+}
+
+static void
+read_ahead_queue_secrets(uint32_t secrets_type, const void *secrets, unsigned size)
+{
+    read_ahead_item_t *item = g_new0(read_ahead_item_t, 1);
+
+    item->type = READ_AHEAD_SECRETS;
+    item->secrets_type = secrets_type;
+    item->data = g_memdup2(secrets, size);
+    item->size = size;
+    g_async_queue_push(read_ahead->items, item);
+}
+
+static void
+read_ahead_item_free(read_ahead_item_t *item)
+{
+    g_free(item->data);
+    g_free(item->err_info);
+    g_free(item);
+}
+
+static void *
+read_ahead_worker(void *data)
+{
+    read_ahead_t       *ra = (read_ahead_t *)data;
+    read_ahead_slot_t  *slot;
+    read_ahead_item_t  *item;
+    int                 err = 0;
+    char               *err_info = NULL;
+    bool                ok;
+
+    for (;;) {
+        slot = (read_ahead_slot_t *)g_async_queue_pop(ra->free_slots);
+        if (g_atomic_int_get(&ra->stop))
+            return NULL;
+
+        g_mutex_lock(&read_ahead_wth_mtx);
+        ok = wtap_read(ra->wth, &slot->rec, &err, &err_info, &slot->data_offset);
+        g_mutex_unlock(&read_ahead_wth_mtx);
+        if (!ok)
+            break;
+
+        item = g_new0(read_ahead_item_t, 1);
+        item->type = READ_AHEAD_RECORD;
+        item->slot = slot;
+        g_async_queue_push(ra->items, item);
+    }
+
+    item = g_new0(read_ahead_item_t, 1);
+    item->type = READ_AHEAD_END;
+    item->err = err;
+    item->err_info = err_info;
+    g_async_queue_push(ra->items, item);
+    return NULL;
+}
+
+static read_ahead_t *
+read_ahead_start(capture_file *cf, unsigned num_slots)
+{
+    read_ahead_t *ra;
+
+    /* The reader holds one slot while the dissector holds another. */
+    if (num_slots < 2)
+        num_slots = 2;
+
+    ra = g_new0(read_ahead_t, 1);
+    ra->wth = cf->provider.wth;
+    ra->num_slots = num_slots;
+    ra->slots = g_new0(read_ahead_slot_t, num_slots);
+    ra->free_slots = g_async_queue_new();
+    ra->items = g_async_queue_new();
+    for (unsigned i = 0; i < num_slots; i++) {
+        wtap_rec_init(&ra->slots[i].rec, 1514);
+        g_async_queue_push(ra->free_slots, &ra->slots[i]);
+    }
+
+    read_ahead = ra;
+    wtap_set_cb_new_ipv4(ra->wth, read_ahead_queue_ipv4_name);
+    wtap_set_cb_new_ipv6(ra->wth, read_ahead_queue_ipv6_name);
+    wtap_set_cb_new_secrets(ra->wth, read_ahead_queue_secrets);
+
+    ra->thread = g_thread_new("Read ahead", read_ahead_worker, ra);
+    ws_debug("tshark: reading up to %u records ahead", num_slots);
+    return ra;
+}
+
+/*
+ * Get the next record from the reader thread, delivering any callbacks
+ * queued before it.  The record remains valid until the next call.
+ */
+static bool
+read_ahead_next(read_ahead_t *ra, wtap_rec **rec, int64_t *data_offset,
+        int *err, char **err_info)
+{
+    read_ahead_item_t *item;
+    read_ahead_slot_t *slot;
+
+    if (ra->current) {
+        wtap_rec_reset(&ra->current->rec);
+        g_async_queue_push(ra->free_slots, ra->current);
+        ra->current = NULL;
+    }
+
+    for (;;) {
+        item = (read_ahead_item_t *)g_async_queue_pop(ra->items);
+        switch (item->type) {
+
+        case READ_AHEAD_RECORD:
+            slot = item->slot;
+            g_free(item);
+            ra->current = slot;
+            *rec = &slot->rec;
+            *data_offset = slot->data_offset;
+            return true;
+
+        case READ_AHEAD_IPV4_NAME:
+            add_ipv4_name(item->ipv4_addr, (const char *)item->data, item->static_entry);
+            break;
+
+        case READ_AHEAD_IPV6_NAME:
+            add_ipv6_name(&item->ipv6_addr, (const char *)item->data, item->static_entry);
+            break;
+
+        case READ_AHEAD_SECRETS:
+            secrets_wtap_callback(item->secrets_type, item->data, item->size);
+            break;
+
+        case READ_AHEAD_END:
+            *err = item->err;
+            *err_info = item->err_info;
+            item->err_info = NULL;
+            /* Leave it queued for any further calls. */
+            g_async_queue_push_front(ra->items, item);
+            return false;
+        }
+        read_ahead_item_free(item);
+    }
+}
+
+static void
+read_ahead_drain(read_ahead_t *ra)
+{
+    read_ahead_item_t *item;
+
+    while ((item = (read_ahead_item_t *)g_async_queue_try_pop(ra->items)) != NULL) {
+        if (item->type == READ_AHEAD_RECORD) {
+            wtap_rec_reset(&item->slot->rec);
+            g_async_queue_push(ra->free_slots, item->slot);
+        }
+        read_ahead_item_free(item);
+    }
+}
+
+static void
+read_ahead_finish(read_ahead_t *ra)
+{
+    /*
+     * Tell the reader to stop, and make sure it has a free slot to
+     * wake up on; the reader holds at most one slot, so returning
+     * everything else to it guarantees that.
+     */
+    g_atomic_int_set(&ra->stop, 1);
+    if (ra->current) {
+        wtap_rec_reset(&ra->current->rec);
+        g_async_queue_push(ra->free_slots, ra->current);
+        ra->current = NULL;
+    }
+    read_ahead_drain(ra);
+    g_thread_join(ra->thread);
+    read_ahead_drain(ra);
+
+    wtap_set_cb_new_ipv4(ra->wth, add_ipv4_name);
+    wtap_set_cb_new_ipv6(ra->wth, (wtap_new_ipv6_callback_t) add_ipv6_name);
+    wtap_set_cb_new_secrets(ra->wth, secrets_wtap_callback);
+    read_ahead = NULL;
+
+    for (unsigned i = 0; i < ra->num_slots; i++)
+        wtap_rec_cleanup(&ra->slots[i].rec);
+    g_async_queue_unref(ra->free_slots);
+    g_async_queue_unref(ra->items);
+    g_free(ra->slots);
+    g_free(ra);
+}
+
+/*
+ * Read the next record, either directly or from the read-ahead thread.
+ * On success, *rec points either to rec_buf or to a read-ahead slot.
+ */
+static bool
+read_next_record(capture_file *cf, read_ahead_t *ra, wtap_rec *rec_buf,
+        wtap_rec **rec, int *err, char **err_info, int64_t *data_offset)
+{
+    if (ra != NULL)
+        return read_ahead_next(ra, rec, data_offset, err, err_info);
+
+    *rec = rec_buf;
+    return wtap_read(cf->provider.wth, rec_buf, err, err_info, data_offset);
+}
+
 static pass_status_t
 process_cap_file_first_pass(capture_file *cf, int max_packet_count,
         int64_t max_byte_count, int *err, char **err_info)
 {
-    wtap_rec        rec;
+    wtap_rec        rec_buf;
+    wtap_rec       *rec;
     epan_dissect_t *edt = NULL;
+    read_ahead_t   *ra = NULL;
     int64_t         data_offset;
     pass_status_t   status = PASS_SUCCEEDED;
     int             framenum = 0;
 
-    wtap_rec_init(&rec, 1514);
+    wtap_rec_init(&rec_buf, 1514);
 
     /* Allocate a frame_data_sequence for all the frames. */
     cf->provider.frames = new_frame_data_sequence();
@@ -3619,16 +4063,19 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
         edt = epan_dissect_new(cf->epan, create_proto_tree, false);
     }
 
+    if (read_ahead_records > 0)
+        ra = read_ahead_start(cf, read_ahead_records);
+
     ws_debug("tshark: reading records for first pass");
     *err = 0;
-    while (wtap_read(cf->provider.wth, &rec, err, err_info, &data_offset)) {
+    while (read_next_record(cf, ra, &rec_buf, &rec, err, err_info, &data_offset)) {
         if (read_interrupted) {
             status = PASS_INTERRUPTED;
             break;
         }
         framenum++;
 
-        if (process_packet_first_pass(cf, edt, data_offset, &rec)) {
+        if (process_packet_first_pass(cf, edt, data_offset, rec)) {
             /* Stop reading if we hit a stop condition */
             if (max_packet_count > 0 && framenum >= max_packet_count) {
                 ws_debug("tshark: max_packet_count (%d) reached", max_packet_count);
@@ -3642,11 +4089,14 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
                 break;
             }
         }
-        wtap_rec_reset(&rec);
+        wtap_rec_reset(rec);
     }
     if (*err != 0)
         status = PASS_READ_ERROR;
 
+    if (ra)
+        read_ahead_finish(ra);
+
     if (edt)
         epan_dissect_free(edt);
 
@@ -3660,7 +4110,7 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
     cf->provider.prev_dis = NULL;
     cf->provider.prev_cap = NULL;
 
-    wtap_rec_cleanup(&rec);
+    wtap_rec_cleanup(&rec_buf);
 
     return status;
 }
@@ -3776,7 +4226,12 @@ process_new_idbs(wtap *wth, wtap_dumper *pdh, int *err, char **err_info)
 {
     wtap_block_t if_data;
 
-    while ((if_data = wtap_get_next_interface_description(wth)) != NULL) {
+    for (;;) {
+        g_mutex_lock(&read_ahead_wth_mtx);
+        if_data = wtap_get_next_interface_description(wth);
+        g_mutex_unlock(&read_ahead_wth_mtx);
+        if (if_data == NULL)
+            break;
         /*
          * Only add interface blocks if the output file supports (meaning
          * *requires*) them.
@@ -3917,18 +4372,20 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
         int *err, char **err_info,
         volatile uint32_t *err_framenum)
 {
-    wtap_rec        rec;
+    wtap_rec        rec_buf;
+    wtap_rec       *rec;
     bool create_proto_tree = false;
     bool            filtering_tap_listeners;
     unsigned        tap_flags;
     int             framenum = 0;
     int             write_framenum = 0;
     epan_dissect_t *edt = NULL;
+    read_ahead_t   *ra = NULL;
     int64_t         data_offset;
     pass_status_t   status = PASS_SUCCEEDED;
     bool            visible = false;
 
-    wtap_rec_init(&rec, 1514);
+    wtap_rec_init(&rec_buf, 1514);
 
     /* Do we have any tap listeners with filters? */
     filtering_tap_listeners = have_filtering_tap_listeners();
@@ -3980,8 +4437,11 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
      */
     set_resolution_synchrony(true);
 
+    if (read_ahead_records > 0)
+        ra = read_ahead_start(cf, read_ahead_records);
+
     *err = 0;
-    while (wtap_read(cf->provider.wth, &rec, err, err_info, &data_offset)) {
+    while (read_next_record(cf, ra, &rec_buf, &rec, err, err_info, &data_offset)) {
         if (read_interrupted) {
             status = PASS_INTERRUPTED;
             break;
@@ -4001,7 +4461,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
 
         reset_epan_mem(cf, edt, create_proto_tree, visible);
 
-        if (process_packet_single_pass(cf, edt, data_offset, &rec, tap_flags)) {
+        if (process_packet_single_pass(cf, edt, data_offset, rec, tap_flags)) {
             /* Either there's no read filtering or this packet passed the
                filter, so, if we're writing to a capture file, write
                this packet out. */
@@ -4009,7 +4469,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
             if (pdh != NULL) {
                 ws_debug("tshark: writing packet #%d to outfile as #%d",
                         framenum, write_framenum);
-                if (!wtap_dump(pdh, &rec, err, err_info)) {
+                if (!wtap_dump(pdh, rec, err, err_info)) {
                     /* Error writing to the output file. */
                     ws_debug("tshark: error writing to a capture file (%d)", *err);
                     *err_framenum = framenum;
@@ -4035,8 +4495,10 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
             *err = 0; /* This is not an error */
             break;
         }
-        wtap_rec_reset(&rec);
+        wtap_rec_reset(rec);
     }
+    if (ra)
+        read_ahead_finish(ra);
     if (status == PASS_SUCCEEDED) {
         if (*err != 0) {
             /* Error reading from the input file. */
@@ -4055,7 +4517,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
     if (edt)
         epan_dissect_free(edt);
 
-    wtap_rec_cleanup(&rec);
+    wtap_rec_cleanup(&rec_buf);
 
     return status;
 }
@@ -4358,6 +4820,8 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, int64_t offset
     /* Count this packet. */
     cf->count++;
 
+    evict_idle_state(cf, rec);
+
     /* If we're not running a display filter and we're not printing any
        packet information, we don't need to do a dissection. This means
        that all packets can be marked as 'passed'. */
@@ -5078,4 +5542,61 @@ reset_epan_mem(capture_file *cf,epan_dissect_t *edt, bool tree, bool visual)
     cf->epan = tshark_epan_new(cf);
     epan_dissect_init(edt, cf->epan, tree, visual);
     cf->count = 0;
+
+    /* Frame numbers start over. */
+    if (evict_checkpoints != NULL)
+        g_array_set_size(evict_checkpoints, 0);
+}
+
+/*
+ * In single-pass mode, forget the conversations and reassemblies that
+ * haven't seen a packet for evict_idle_secs, so that idle reassemblies
+ * are freed and lookups stay fast on long-running captures without
+ * resetting the whole session (and with it the state of active
+ * conversations) as -M does. Conversations themselves are file-scoped
+ * and are only freed by a session reset.
+ *
+ * Packet time, not wall-clock time, is used, and it's mapped to frame
+ * numbers with one checkpoint per second of packet time.
+ */
+static void
+evict_idle_state(capture_file *cf, const wtap_rec *rec)
+{
+    const evict_checkpoint_t *cp;
+    time_t cutoff;
+    unsigned i;
+
+    if (evict_idle_secs == 0 || !(rec->presence_flags & WTAP_HAS_TS))
+        return;
+
+    if (evict_checkpoints == NULL)
+        evict_checkpoints = g_array_new(FALSE, FALSE, sizeof(evict_checkpoint_t));
+
+    cp = &g_array_index(evict_checkpoints, evict_checkpoint_t, 0);
+    if (evict_checkpoints->len == 0 || cp[evict_checkpoints->len - 1].secs < rec->ts.secs) {
+        evict_checkpoint_t new_cp = { cf->count, rec->ts.secs };
+        g_array_append_val(evict_checkpoints, new_cp);
+        cp = &g_array_index(evict_checkpoints, evict_checkpoint_t, 0);
+    }
+
+    /* Sweep a few times per idle period. */
+    if (rec->ts.secs < evict_next_sweep)
+        return;
+    evict_next_sweep = rec->ts.secs + MAX(evict_idle_secs / 4, 1);
+
+    /*
+     * Find the newest checkpoint that's at least evict_idle_secs old;
+     * everything before its frame has been idle for longer than that.
+     */
+    cutoff = rec->ts.secs - evict_idle_secs;
+    for (i = 0; i < evict_checkpoints->len && cp[i].secs <= cutoff; i++)
+        ;
+    if (i == 0)
+        return;
+
+    ws_debug("evicting state idle since before frame %u", cp[i - 1].frame);
+    epan_evict_idle_state(cf->epan, cp[i - 1].frame);
+
+    /* Keep the checkpoint we used; it's the oldest one still needed. */
+    g_array_remove_range(evict_checkpoints, 0, i - 1);
 }
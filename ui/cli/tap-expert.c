@@ -130,6 +130,39 @@ expert_stat_packet(void *tapdata, packet_info *pinfo _U_, epan_dissect_t *edt _U
     return TAP_PACKET_REDRAW;
 }
 
+/* Copy what expert_stat_packet() needs from an expert frame, so that it
+   can run on the tap listener thread */
+static void *
+expert_stat_copy(void *tapdata _U_, packet_info *pinfo _U_, epan_dissect_t *edt _U_,
+                 const void *pointer, tap_flags_t flags _U_)
+{
+    const expert_info_t *ei = (const expert_info_t *)pointer;
+    expert_info_t       *copy;
+
+    copy = g_new0(expert_info_t, 1);
+    copy->group = ei->group;
+    copy->severity = ei->severity;
+    /* The protocol name is a registered, static string */
+    copy->protocol = ei->protocol;
+    copy->summary = g_strdup(ei->summary);
+    return copy;
+}
+
+static tap_packet_status
+expert_stat_copied_packet(void *tapdata, void *copy)
+{
+    return expert_stat_packet(tapdata, NULL, NULL, copy, 0);
+}
+
+static void
+expert_stat_free_copy(void *copy)
+{
+    expert_info_t *ei = (expert_info_t *)copy;
+
+    g_free(ei->summary);
+    g_free(ei);
+}
+
 /* Output for all of the items of one severity */
 static void draw_items_for_severity(GArray *items, const char *label)
 {
@@ -270,6 +303,17 @@ static bool expert_stat_init(const char *opt_arg, void *userdata _U_)
         return false;
     }
 
+    /* Tally the items off the dissection thread */
+    error_string = set_tap_threaded(hs, expert_stat_copy,
+                                    expert_stat_copied_packet,
+                                    expert_stat_free_copy);
+    if (error_string) {
+        cmdarg_err("Expert tap error (%s)!\n", error_string->str);
+        g_string_free(error_string, TRUE);
+        remove_tap_listener(hs);
+        return false;
+    }
+
     return true;
 }
 
@@ -31,11 +31,11 @@ depended_frames_add(GHashTable* depended_table, frame_data_sequence *frames, fra
     if (depth > prefs.gui_max_tree_depth) {
         return;
     }
-    if (g_hash_table_add(depended_table, GUINT_TO_POINTER(frame->num)) && frame->dependent_frames) {
+    if (g_hash_table_add(depended_table, GUINT_TO_POINTER(frame->num)) && FRAME_DATA_DEPENDENT_FRAMES(frame)) {
         GHashTableIter iter;
         void *key;
         frame_data *depended_fd;
-        g_hash_table_iter_init(&iter, frame->dependent_frames);
+        g_hash_table_iter_init(&iter, frame->extra->dependent_frames);
         while (g_hash_table_iter_next(&iter, &key, NULL)) {
             depended_fd = frame_data_sequence_find(frames, GPOINTER_TO_UINT(key));
             depended_frames_add(depended_table, frames, depended_fd, depth + 1);
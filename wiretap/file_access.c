@@ -1090,8 +1090,18 @@ wtap_open_offline(const char *filename, unsigned int type, int *err, char **err_
 	case WTAP_OPEN_ERROR:
 		wtap_close(wth);
 		wth = NULL;
+		return NULL;
 	}
 
+	/*
+	 * If we're reading a regular file, read the sequential stream
+	 * ahead of the caller, so that I/O latency overlaps with
+	 * dissection; we're done probing the file format, so seeks on
+	 * it should be rare from now on.
+	 */
+	if (wth->random_fh)
+		file_set_read_ahead(wth->fh);
+
 	return wth;
 }
 
@@ -2188,8 +2198,8 @@ wtap_dump_can_compress(int file_type_subtype _U_)
 static bool wtap_dump_open_finish(wtap_dumper *wdh, int *err,
 				      char **err_info);
 
-static WFILE_T wtap_dump_file_open(const wtap_dumper *wdh, const char *filename);
-static WFILE_T wtap_dump_file_fdopen(const wtap_dumper *wdh, int fd);
+static WFILE_T wtap_dump_file_open(wtap_dumper *wdh, const char *filename);
+static WFILE_T wtap_dump_file_fdopen(wtap_dumper *wdh, int fd);
 static int wtap_dump_file_close(wtap_dumper *wdh);
 static bool wtap_dump_fix_idb(wtap_dumper *wdh, wtap_block_t idb, int *err);
 
@@ -2771,10 +2781,41 @@ wtap_dump_discard_sysdig_meta_events(wtap_dumper *wdh)
 	}
 }
 
+/*
+ * Give an uncompressed output file a buffer of at least IO_BUF_SIZE
+ * bytes, or the file system's preferred I/O size if that's bigger, as
+ * writecap does for its streams.  Most writers hand us a record a few
+ * bytes at a time, and with the default stdio buffer that turns into a
+ * write() call every few records.
+ *
+ * Pipes and terminals keep the default buffering, so that someone
+ * reading the capture as it's written doesn't wait for 64K of it.
+ */
+static void
+wtap_dump_file_set_buffer(wtap_dumper *wdh, FILE *fh)
+{
+	ws_statb64 statb;
+	size_t buffsize = IO_BUF_SIZE;
+
+	if (ws_fstat64(ws_fileno(fh), &statb) != 0 || !S_ISREG(statb.st_mode))
+		return;
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+	if (statb.st_blksize > IO_BUF_SIZE)
+		buffsize = statb.st_blksize;
+#endif
+	wdh->io_buffer = (char *)g_malloc(buffsize);
+	if (setvbuf(fh, wdh->io_buffer, _IOFBF, buffsize) != 0) {
+		g_free(wdh->io_buffer);
+		wdh->io_buffer = NULL;
+	}
+}
+
 /* internally open a file for writing (compressed or not) */
 static WFILE_T
-wtap_dump_file_open(const wtap_dumper *wdh, const char *filename)
+wtap_dump_file_open(wtap_dumper *wdh, const char *filename)
 {
+	FILE *fh;
+
 	switch (wdh->compression_type) {
 #if defined (HAVE_ZLIB) || defined (HAVE_ZLIBNG)
 	case WS_FILE_GZIP_COMPRESSED:
@@ -2785,14 +2826,19 @@ wtap_dump_file_open(const wtap_dumper *wdh, const char *filename)
 		return lz4wfile_open(filename);
 #endif /* HAVE_LZ4FRAME_H */
 	default:
-		return ws_fopen(filename, "wb");
+		fh = ws_fopen(filename, "wb");
+		if (fh != NULL)
+			wtap_dump_file_set_buffer(wdh, fh);
+		return fh;
 	}
 }
 
 /* internally open a file for writing (compressed or not) */
 static WFILE_T
-wtap_dump_file_fdopen(const wtap_dumper *wdh, int fd)
+wtap_dump_file_fdopen(wtap_dumper *wdh, int fd)
 {
+	FILE *fh;
+
 	switch (wdh->compression_type) {
 #if defined (HAVE_ZLIB) || defined (HAVE_ZLIBNG)
 	case WS_FILE_GZIP_COMPRESSED:
@@ -2803,7 +2849,10 @@ wtap_dump_file_fdopen(const wtap_dumper *wdh, int fd)
 		return lz4wfile_fdopen(fd);
 #endif /* HAVE_LZ4FRAME_H */
 	default:
-		return ws_fdopen(fd, "wb");
+		fh = ws_fdopen(fd, "wb");
+		if (fh != NULL)
+			wtap_dump_file_set_buffer(wdh, fh);
+		return fh;
 	}
 }
 
@@ -2871,7 +2920,16 @@ wtap_dump_file_close(wtap_dumper *wdh)
 		return lz4wfile_close((LZ4WFILE_T)wdh->fh);
 #endif /* HAVE_LZ4FRAME_H */
 	default:
-		return fclose((FILE *)wdh->fh);
+	{
+		int ret = fclose((FILE *)wdh->fh);
+		int save_errno = errno;
+
+		/* The stream may have been using it right up to the fclose(). */
+		g_free(wdh->io_buffer);
+		wdh->io_buffer = NULL;
+		errno = save_errno;
+		return ret;
+	}
 	}
 }
 
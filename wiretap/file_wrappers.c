@@ -26,6 +26,7 @@
 #include "wtap-int.h"
 
 #include <wsutil/file_util.h>
+#include <wsutil/pint.h>
 #include <wsutil/zlib_compat.h>
 #include <wsutil/file_compressed.h>
 
@@ -88,6 +89,11 @@ typedef enum {
  */
 #define MAX_READ_BUF_SIZE	(1U << 30)
 
+/*
+ * The largest file we'll map into memory in a 32-bit process.
+ */
+#define MAX_MAP_SIZE_32	(INT64_C(256) * 1024 * 1024)
+
 struct wtap_reader_buf {
     uint8_t *buf;  /* buffer */
     uint8_t *next; /* next byte to deliver from buffer */
@@ -140,6 +146,16 @@ struct wtap_reader {
     /* fast seeking */
     GPtrArray *fast_seek;
     void *fast_seek_cur;
+
+    /* read-ahead of the raw input, if enabled */
+    struct read_ahead *read_ahead;
+
+    /* memory-mapped view of the file, for random access */
+    bool use_map;               /* true if we should map the file */
+    GMappedFile *map;           /* the mapping, if any */
+    const uint8_t *map_data;    /* start of the mapped data */
+    int64_t map_len;            /* length of the mapped data */
+    bool fd_stale;              /* true if fd isn't positioned at raw_pos */
 };
 
 /* Current read offset within a buffer. */
@@ -178,6 +194,185 @@ buf_reset(struct wtap_reader_buf *buf)
     buf->avail = 0;
 }
 
+/*
+ * Read-ahead of the raw input on a helper thread.
+ *
+ * While the caller decompresses and dissects one chunk of the file,
+ * the helper thread reads the next chunk into a second buffer, so
+ * that the latency of slow storage (network file systems, spinning
+ * disks) overlaps with the work done on the data already read.
+ *
+ * The helper thread only ever does ws_read() into the back buffer;
+ * everything else, including seeking and closing the descriptor,
+ * happens on the caller's thread after read_ahead_reset() has waited
+ * for any outstanding read to complete.  The descriptor's position is
+ * thus always raw_pos plus whatever is buffered here, and raw_pos
+ * is what's used when seeking.
+ */
+struct read_ahead {
+    GThread *thread;
+    GMutex mtx;
+    GCond cond;
+    int fd;
+    unsigned size;
+    unsigned char *front;       /* buffer being consumed */
+    unsigned char *front_next;  /* next byte to deliver from it */
+    unsigned front_avail;       /* number of bytes available at front_next */
+    unsigned char *back;        /* buffer being filled by the helper */
+    bool pending;               /* true if a read into back was requested */
+    bool done;                  /* true if that read has completed */
+    ssize_t ret;                /* result of that read */
+    int err;                    /* errno from that read, if it failed */
+    bool stop;                  /* true if the helper should exit */
+};
+
+static void *
+read_ahead_thread(void *data)
+{
+    struct read_ahead *ra = (struct read_ahead *)data;
+    ssize_t ret;
+    int err;
+
+    g_mutex_lock(&ra->mtx);
+    for (;;) {
+        while (!ra->stop && !(ra->pending && !ra->done))
+            g_cond_wait(&ra->cond, &ra->mtx);
+        if (ra->stop)
+            break;
+        g_mutex_unlock(&ra->mtx);
+
+        ret = ws_read(ra->fd, ra->back, ra->size);
+        err = (ret < 0) ? errno : 0;
+
+        g_mutex_lock(&ra->mtx);
+        ra->ret = ret;
+        ra->err = err;
+        ra->done = true;
+        g_cond_broadcast(&ra->cond);
+    }
+    g_mutex_unlock(&ra->mtx);
+    return NULL;
+}
+
+/* Ask the helper thread to fill the back buffer. */
+static void
+read_ahead_request(struct read_ahead *ra)
+{
+    g_mutex_lock(&ra->mtx);
+    ra->pending = true;
+    ra->done = false;
+    g_cond_broadcast(&ra->cond);
+    g_mutex_unlock(&ra->mtx);
+}
+
+/*
+ * Wait for an outstanding request, if any, to complete, and take its
+ * result.  Returns false if there was no outstanding request.
+ */
+static bool
+read_ahead_collect(struct read_ahead *ra, ssize_t *ret, int *err)
+{
+    bool pending;
+
+    g_mutex_lock(&ra->mtx);
+    pending = ra->pending;
+    while (ra->pending && !ra->done)
+        g_cond_wait(&ra->cond, &ra->mtx);
+    ra->pending = false;
+    *ret = ra->ret;
+    *err = ra->err;
+    g_mutex_unlock(&ra->mtx);
+    return pending;
+}
+
+/*
+ * Discard everything that's been read ahead, after waiting for the
+ * helper thread to go idle, so that the caller can use the descriptor
+ * directly.  The caller must then position the descriptor explicitly,
+ * as it's no longer at raw_pos.
+ */
+static void
+read_ahead_reset(struct read_ahead *ra)
+{
+    ssize_t ret;
+    int err;
+
+    if (ra == NULL)
+        return;
+    read_ahead_collect(ra, &ret, &err);
+    ra->front_avail = 0;
+}
+
+/*
+ * Like ws_read(), but deliver data from the read-ahead buffers,
+ * refilling them as they're consumed.
+ *
+ * The file may be growing, e.g. while it's being tailed during a live
+ * capture, so an end of file seen by a read issued ahead of time may be
+ * stale by the time it's collected.  A read that comes back short isn't
+ * followed by another read ahead, and a read ahead that found nothing
+ * is retried directly, so that EOF is only reported if the file hasn't
+ * grown since.
+ */
+static ssize_t
+read_ahead_read(struct read_ahead *ra, unsigned char *dst, unsigned len)
+{
+    unsigned char *tmp;
+    bool prefetched;
+    ssize_t ret;
+    int err;
+
+    if (ra->front_avail == 0) {
+        prefetched = ra->pending;
+        if (!prefetched)
+            read_ahead_request(ra);
+        read_ahead_collect(ra, &ret, &err);
+        if (prefetched && ret == 0) {
+            /* The helper is idle, so the descriptor is ours. */
+            ret = ws_read(ra->fd, ra->back, ra->size);
+            err = (ret < 0) ? errno : 0;
+        }
+        if (ret <= 0) {
+            if (ret < 0)
+                errno = err;
+            return ret;
+        }
+        tmp = ra->front;
+        ra->front = ra->back;
+        ra->back = tmp;
+        ra->front_next = ra->front;
+        ra->front_avail = (unsigned)ret;
+
+        /* Start reading the next chunk while this one is consumed,
+           unless this one ended at what was then the end of the file. */
+        if ((unsigned)ret == ra->size)
+            read_ahead_request(ra);
+    }
+    if (len > ra->front_avail)
+        len = ra->front_avail;
+    memcpy(dst, ra->front_next, len);
+    ra->front_next += len;
+    ra->front_avail -= len;
+    return len;
+}
+
+static void
+read_ahead_free(struct read_ahead *ra)
+{
+    if (ra == NULL)
+        return;
+    g_mutex_lock(&ra->mtx);
+    ra->stop = true;
+    g_cond_broadcast(&ra->cond);
+    g_mutex_unlock(&ra->mtx);
+    g_thread_join(ra->thread);
+    g_mutex_clear(&ra->mtx);
+    g_cond_clear(&ra->cond);
+    g_free(ra->front);
+    g_free(ra->back);
+    g_free(ra);
+}
+
 static int
 buf_read(FILE_T state, struct wtap_reader_buf *buf)
 {
@@ -203,11 +398,35 @@ buf_read(FILE_T state, struct wtap_reader_buf *buf)
         to_read = space_left;
     }
 
-    ret = ws_read(state->fd, read_ptr, to_read);
-    if (ret < 0) {
-        state->err = errno;
-        state->err_info = NULL;
-        return -1;
+    if (state->map != NULL && state->raw_pos < state->map_len) {
+        /* The data is in the mapped part of the file; just copy it. */
+        if ((int64_t)to_read > state->map_len - state->raw_pos)
+            to_read = (unsigned)(state->map_len - state->raw_pos);
+        memcpy(read_ptr, state->map_data + state->raw_pos, to_read);
+        state->fd_stale = true;
+        ret = to_read;
+    } else {
+        /*
+         * If we've been reading from the mapping, or the file has
+         * been reopened, the descriptor isn't where we think we are.
+         */
+        if (state->fd_stale) {
+            if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1) {
+                state->err = errno;
+                state->err_info = NULL;
+                return -1;
+            }
+            state->fd_stale = false;
+        }
+        if (state->read_ahead != NULL)
+            ret = read_ahead_read(state->read_ahead, read_ptr, to_read);
+        else
+            ret = ws_read(state->fd, read_ptr, to_read);
+        if (ret < 0) {
+            state->err = errno;
+            state->err_info = NULL;
+            return -1;
+        }
     }
     if (ret == 0)
         state->eof = true;
@@ -920,12 +1139,158 @@ zstd_fill_out_buffer(FILE_T state)
 }
 #endif /* HAVE_ZSTD */
 
+/*
+ * Seekable Zstandard format: independently compressed frames, followed
+ * by a skippable frame with a table of their compressed and decompressed
+ * sizes.
+ *
+ * https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+ */
+#define ZSTD_MAGIC                      0xFD2FB528
+#define ZSTD_SKIPPABLE_MAGIC            0x184D2A50  /* low 4 bits are free */
+#define ZSTD_SKIPPABLE_HEADER_SIZE      8
+#define ZSTD_SEEKABLE_MAGIC             0x8F92EAB1
+#define ZSTD_SEEKABLE_FOOTER_SIZE       9
+#define ZSTD_SEEKABLE_MAX_FRAMES        0x8000000
+#define ZSTD_SEEKABLE_CHECKSUM_FLAG     0x80
+#define ZSTD_SEEKABLE_RESERVED_BITS     0x7C
+
+#ifdef HAVE_ZSTD
+static bool
+read_raw_at(int fd, int64_t offset, void *buf, unsigned len)
+{
+    ssize_t n;
+
+    if (ws_lseek64(fd, offset, SEEK_SET) == -1)
+        return false;
+    while (len != 0) {
+        n = ws_read(fd, buf, len);
+        if (n <= 0)
+            return false;
+        buf = (uint8_t *)buf + n;
+        len -= (unsigned)n;
+    }
+    return true;
+}
+
+/*
+ * If the file is in the seekable Zstandard format, add a fast seek point
+ * for the start of every frame from the seek table at the end of the
+ * file, so that random access doesn't need to decompress anything that
+ * precedes the frame with the record, not even on the first pass.
+ *
+ * Anything that doesn't look like a valid seek table is ignored; the
+ * frames then get their fast seek points as they are read.
+ */
+static void
+zstd_load_seek_table(FILE_T state)
+{
+    uint8_t footer[ZSTD_SEEKABLE_FOOTER_SIZE];
+    uint8_t header[ZSTD_SKIPPABLE_HEADER_SIZE];
+    uint8_t *table = NULL;
+    GPtrArray *points = NULL;
+    struct fast_seek_point *val;
+    int64_t end, table_start, in_pos, out_pos;
+    uint32_t num_frames, entry_size, frame_size;
+
+    if (state->fast_seek == NULL || state->fast_seek->len != 0)
+        return;
+
+    end = ws_lseek64(state->fd, 0, SEEK_END);
+    if (end == -1)
+        goto done;
+    if (end - state->start < ZSTD_SKIPPABLE_HEADER_SIZE + ZSTD_SEEKABLE_FOOTER_SIZE)
+        goto done;
+
+    if (!read_raw_at(state->fd, end - ZSTD_SEEKABLE_FOOTER_SIZE, footer, sizeof footer))
+        goto done;
+    if (pletohu32(&footer[5]) != ZSTD_SEEKABLE_MAGIC ||
+        (footer[4] & ZSTD_SEEKABLE_RESERVED_BITS) != 0)
+        goto done;
+    num_frames = pletohu32(&footer[0]);
+    if (num_frames == 0 || num_frames > ZSTD_SEEKABLE_MAX_FRAMES)
+        goto done;
+    entry_size = (footer[4] & ZSTD_SEEKABLE_CHECKSUM_FLAG) ? 12 : 8;
+    frame_size = num_frames * entry_size + ZSTD_SEEKABLE_FOOTER_SIZE;
+
+    table_start = end - frame_size - ZSTD_SKIPPABLE_HEADER_SIZE;
+    if (table_start < state->start)
+        goto done;
+    if (!read_raw_at(state->fd, table_start, header, sizeof header))
+        goto done;
+    if ((pletohu32(&header[0]) & 0xFFFFFFF0) != ZSTD_SKIPPABLE_MAGIC ||
+        pletohu32(&header[4]) != frame_size)
+        goto done;
+
+    /* The frames must start right at the beginning. */
+    if (!read_raw_at(state->fd, state->start, header, 4) ||
+        pletohu32(&header[0]) != ZSTD_MAGIC)
+        goto done;
+
+    table = (uint8_t *)g_try_malloc(frame_size - ZSTD_SEEKABLE_FOOTER_SIZE);
+    if (table == NULL)
+        goto done;
+    if (!read_raw_at(state->fd, table_start + ZSTD_SKIPPABLE_HEADER_SIZE,
+                     table, frame_size - ZSTD_SEEKABLE_FOOTER_SIZE))
+        goto done;
+
+    points = g_ptr_array_new_full(num_frames, g_free);
+    in_pos = state->start;
+    out_pos = 0;
+    for (uint32_t i = 0; i < num_frames; i++) {
+        const uint8_t *entry = table + i * entry_size;
+
+        val = g_new(struct fast_seek_point, 1);
+        val->in = in_pos;
+        val->out = out_pos;
+        val->compression = ZSTD;
+        g_ptr_array_add(points, val);
+
+        in_pos += pletohu32(&entry[0]);
+        out_pos += pletohu32(&entry[4]);
+        if (in_pos > table_start)
+            goto done;
+    }
+    if (in_pos != table_start)
+        goto done;
+
+    for (unsigned i = 0; i < points->len; i++)
+        g_ptr_array_add(state->fast_seek, points->pdata[i]);
+    g_ptr_array_set_free_func(points, NULL);
+    ws_debug("%u fast seek points from the zstd seek table", num_frames);
+
+done:
+    if (points != NULL)
+        g_ptr_array_free(points, true);
+    g_free(table);
+    ws_lseek64(state->fd, state->raw_pos, SEEK_SET);
+}
+#endif /* HAVE_ZSTD */
+
 /*
  * Check for a Zstandard header.
  */
 static int
 check_for_zstd_compression(FILE_T state)
 {
+    /*
+     * Skippable frames, such as the seek table of the seekable format,
+     * don't produce any data; skip them and look for the next header.
+     * Only do so after a Zstandard frame, so as not to mistake the
+     * start of an uncompressed file for one.
+     */
+    if (state->last_compression == ZSTD && state->in.avail >= 4
+        && (state->in.next[0] & 0xF0) == 0x50 && state->in.next[1] == 0x2a
+        && state->in.next[2] == 0x4d && state->in.next[3] == 0x18) {
+        uint32_t frame_size;
+
+        if (gz_skipn(state, 4) == -1 || gz_next4(state, &frame_size) == -1 ||
+            gz_skipn(state, frame_size) == -1)
+            return -1;
+        state->compression = UNKNOWN;
+        return 1;
+    }
+
     /*
      * Look for the Zstandard header, and, if we find it, return
      * success if we support Zstandard and an error if we don't.
@@ -1715,10 +2080,94 @@ file_open(const char *path)
     return ft;
 }
 
+/*
+ * Map the file into memory, so that random access to it doesn't need
+ * a seek and a read of a whole buffer for every record.
+ *
+ * This is only done for regular files; if the file can't be mapped,
+ * we silently fall back on reading it.  The mapping covers the file as
+ * it was when it was mapped; if it's growing, as it is during a live
+ * capture, anything added later is read as usual.
+ */
+static void
+file_map(FILE_T stream)
+{
+    ws_statb64 st;
+    GMappedFile *map;
+
+    if (stream->map != NULL || stream->fd == -1)
+        return;
+    if (ws_fstat64(stream->fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0)
+        return;
+    /* Don't use up the address space of a 32-bit process. */
+    if (sizeof (void *) < 8 && st.st_size > MAX_MAP_SIZE_32)
+        return;
+    map = g_mapped_file_new_from_fd(stream->fd, false, NULL);
+    if (map == NULL)
+        return;
+    stream->map = map;
+    stream->map_data = (const uint8_t *)g_mapped_file_get_contents(map);
+    stream->map_len = (int64_t)g_mapped_file_get_length(map);
+}
+
+static void
+file_unmap(FILE_T stream)
+{
+    if (stream->map == NULL)
+        return;
+    g_mapped_file_unref(stream->map);
+    stream->map = NULL;
+    stream->map_data = NULL;
+    stream->map_len = 0;
+    stream->fd_stale = true;
+}
+
 void
-file_set_random_access(FILE_T stream, bool random_flag _U_, GPtrArray *seek)
+file_set_random_access(FILE_T stream, bool random_flag, GPtrArray *seek)
 {
     stream->fast_seek = seek;
+#ifdef HAVE_ZSTD
+    if (random_flag)
+        zstd_load_seek_table(stream);
+#endif /* HAVE_ZSTD */
+    if (random_flag) {
+        stream->use_map = true;
+        file_map(stream);
+    }
+}
+
+/*
+ * Start reading the raw input ahead of the caller on a helper thread.
+ *
+ * This is only worth doing for a stream that's read sequentially from
+ * a regular file; it's a no-op if read-ahead is already enabled or the
+ * buffers can't be allocated, in which case reads are done directly.
+ */
+void
+file_set_read_ahead(FILE_T stream)
+{
+    struct read_ahead *ra;
+
+    if (stream->read_ahead != NULL || stream->fd == -1 || stream->size == 0)
+        return;
+
+    ra = g_new0(struct read_ahead, 1);
+    ra->fd = stream->fd;
+    ra->size = stream->size;
+    ra->front = (unsigned char *)g_try_malloc(ra->size);
+    ra->back = (unsigned char *)g_try_malloc(ra->size);
+    if (ra->front == NULL || ra->back == NULL) {
+        g_free(ra->front);
+        g_free(ra->back);
+        g_free(ra);
+        return;
+    }
+    ra->front_next = ra->front;
+    g_mutex_init(&ra->mtx);
+    g_cond_init(&ra->cond);
+    ra->thread = g_thread_new("File read-ahead", read_ahead_thread, ra);
+    stream->read_ahead = ra;
 }
 
 int64_t
@@ -1889,6 +2338,7 @@ file_seek(FILE_T file, int64_t offset, int whence, int *err)
             break;
         }
 
+        read_ahead_reset(file->read_ahead);
         if (ws_lseek64(file->fd, off, SEEK_SET) == -1) {
             *err = errno;
             return -1;
@@ -2018,7 +2468,8 @@ file_seek(FILE_T file, int64_t offset, int whence, int *err)
         /*
          * Yes.  Just seek there within the file.
          */
-        if (ws_lseek64(file->fd, offset - file->out.avail, SEEK_CUR) == -1) {
+        read_ahead_reset(file->read_ahead);
+        if (ws_lseek64(file->fd, file->raw_pos + (offset - file->out.avail), SEEK_SET) == -1) {
             *err = errno;
             return -1;
         }
@@ -2052,6 +2503,7 @@ file_seek(FILE_T file, int64_t offset, int whence, int *err)
         /* rewind, then skip to offset */
 
         /* back up and start over */
+        read_ahead_reset(file->read_ahead);
         if (ws_lseek64(file->fd, file->start, SEEK_SET) == -1) {
             *err = errno;
             return -1;
@@ -2194,6 +2646,24 @@ file_read(void *buf, unsigned int len, FILE_T file)
                we're at the end of the input; just return
                with what we've gotten so far. */
             break;
+        } else if (file->compression == UNCOMPRESSED &&
+                   file->map != NULL && file->in.avail == 0 &&
+                   file->raw_pos < file->map_len) {
+            /* We have nothing in the output buffer, and the
+               data is uncompressed and in the mapped part of
+               the file; copy it straight from the mapping,
+               without going through the output buffer. */
+            n = (int64_t)len > file->map_len - file->raw_pos ?
+                (unsigned)(file->map_len - file->raw_pos) : len;
+            if (buf != NULL) {
+                memcpy(buf, file->map_data + file->raw_pos, n);
+                buf = (char *)buf + n;
+            }
+            file->raw_pos += n;
+            file->fd_stale = true;
+            len -= n;
+            got += n;
+            file->pos += n;
         } else {
             /* We have nothing in the output buffer, and
                we can generate more data; get more output,
@@ -2397,6 +2867,9 @@ file_clearerr(FILE_T stream)
 void
 file_fdclose(FILE_T file)
 {
+    read_ahead_free(file->read_ahead);
+    file->read_ahead = NULL;
+    file_unmap(file);
     if (file->fd != -1)
         ws_close(file->fd);
     file->fd = -1;
@@ -2410,6 +2883,9 @@ file_fdreopen(FILE_T file, const char *path)
     if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
         return false;
     file->fd = fd;
+    file->fd_stale = true;
+    if (file->use_map)
+        file_map(file);
     return true;
 }
 
@@ -2419,6 +2895,8 @@ file_close(FILE_T file)
     int fd = file->fd;
 
     /* free memory and close file */
+    read_ahead_free(file->read_ahead);
+    file_unmap(file);
     if (file->size) {
 #ifdef USE_ZLIB_OR_ZLIBNG
         ZLIB_PREFIX(inflateEnd)(&(file->strm));
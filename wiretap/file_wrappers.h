@@ -16,6 +16,7 @@
 extern FILE_T file_open(const char *path);
 extern FILE_T file_fdopen(int fildes);
 extern void file_set_random_access(FILE_T stream, bool random_flag, GPtrArray *seek);
+extern void file_set_read_ahead(FILE_T stream);
 WS_DLL_PUBLIC int64_t file_seek(FILE_T stream, int64_t offset, int whence, int *err);
 WS_DLL_PUBLIC int64_t file_tell(FILE_T stream);
 extern int64_t file_tell_raw(FILE_T stream);
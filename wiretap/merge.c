@@ -303,22 +303,113 @@ merge_select_frame_type(const int file_type, int in_file_count, merge_in_file_t
 }
 
 /*
- * returns true if first argument is earlier than second
+ * The files that have a record available, kept in a binary min-heap
+ * ordered by the time stamp of that record, so that picking the next
+ * record to write doesn't require looking at every input file; that
+ * matters when merging thousands of files.
+ *
+ * Files whose record has just been written, or that haven't been read
+ * yet, are on the refill stack; they're read, and put back into the
+ * heap, the next time we're asked for a record.  We can't read them
+ * any earlier, as the record buffer is still being used by the caller.
+ */
+typedef struct {
+    merge_in_file_t *in_files;
+    unsigned *heap;         /* indices of files with a record present */
+    unsigned heap_count;
+    unsigned *refill;       /* indices of files to read a record from */
+    unsigned refill_count;
+} merge_heap_t;
+
+static void
+merge_heap_init(merge_heap_t *mh, merge_in_file_t in_files[], unsigned in_file_count)
+{
+    unsigned i;
+
+    mh->in_files = in_files;
+    mh->heap = g_new(unsigned, in_file_count);
+    mh->heap_count = 0;
+    mh->refill = g_new(unsigned, in_file_count);
+    /* Read the files in order, so errors are reported in that order. */
+    for (i = 0; i < in_file_count; i++)
+        mh->refill[i] = in_file_count - 1 - i;
+    mh->refill_count = in_file_count;
+}
+
+static void
+merge_heap_free(merge_heap_t *mh)
+{
+    g_free(mh->heap);
+    g_free(mh->refill);
+}
+
+/*
+ * Returns true if the record from file a should be written before the
+ * record from file b.
+ *
+ * Records with no time stamp are treated as earlier than all other
+ * records.  Yes, this means you won't get a chronological merge of
+ * those records, but you obviously *can't* get that.  Ties go to the
+ * lower-numbered file for records with no time stamp, and to the
+ * higher-numbered file for records with equal time stamps, as they
+ * always have.
  */
 static bool
-is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
+merge_heap_before(const merge_heap_t *mh, unsigned a, unsigned b)
 {
-    if (l->secs > r->secs) {  /* left is later */
-        return false;
-    } else if (l->secs < r->secs) { /* left is earlier */
-        return true;
-    } else if (l->nsecs > r->nsecs) { /* tv_sec equal, l.usec later */
-        return false;
+    const wtap_rec *ra = &mh->in_files[a].rec;
+    const wtap_rec *rb = &mh->in_files[b].rec;
+    bool a_has_ts = (ra->presence_flags & WTAP_HAS_TS) != 0;
+    bool b_has_ts = (rb->presence_flags & WTAP_HAS_TS) != 0;
+    int cmp;
+
+    if (!a_has_ts || !b_has_ts) {
+        if (a_has_ts != b_has_ts)
+            return !a_has_ts;
+        return a < b;
     }
-    /* either one < two or one == two
-     * either way, return one
-     */
-    return true;
+    cmp = nstime_cmp(&ra->ts, &rb->ts);
+    if (cmp != 0)
+        return cmp < 0;
+    return a > b;
+}
+
+static void
+merge_heap_push(merge_heap_t *mh, unsigned file_index)
+{
+    unsigned pos = mh->heap_count++;
+    unsigned parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (!merge_heap_before(mh, file_index, mh->heap[parent]))
+            break;
+        mh->heap[pos] = mh->heap[parent];
+        pos = parent;
+    }
+    mh->heap[pos] = file_index;
+}
+
+static unsigned
+merge_heap_pop(merge_heap_t *mh)
+{
+    unsigned top = mh->heap[0];
+    unsigned last = mh->heap[--mh->heap_count];
+    unsigned pos = 0;
+    unsigned child;
+
+    while ((child = 2 * pos + 1) < mh->heap_count) {
+        if (child + 1 < mh->heap_count &&
+            merge_heap_before(mh, mh->heap[child + 1], mh->heap[child]))
+            child++;
+        if (!merge_heap_before(mh, mh->heap[child], last))
+            break;
+        mh->heap[pos] = mh->heap[child];
+        pos = child;
+    }
+    if (mh->heap_count > 0)
+        mh->heap[pos] = last;
+    return top;
 }
 
 /** Read the next packet, in chronological order, from the set of files to
@@ -333,8 +424,7 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
- * @param in_file_count number of entries in in_files
- * @param in_files input file array
+ * @param mh heap of input files
  * @param err wiretap error, if failed
  * @param err_info wiretap error string, if failed
  * @return pointer to merge_in_file_t for file from which that packet
@@ -342,79 +432,54 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * all files
  */
 static merge_in_file_t *
-merge_read_packet(int in_file_count, merge_in_file_t in_files[],
-                  int *err, char **err_info)
+merge_read_packet(merge_heap_t *mh, int *err, char **err_info)
 {
-    int i;
-    int ei = -1;
-    nstime_t tv = NSTIME_INIT_MAX;
-    wtap_rec *rec;
+    merge_in_file_t *in_file;
+    unsigned i;
 
     /*
      * Make sure we have a record available from each file that's not at
-     * EOF, and search for the record with the earliest time stamp or
-     * with no time stamp (those records are treated as earlier than
-     * all other records).  Yes, this means you won't get a chronological
-     * merge of those records, but you obviously *can't* get that.
+     * EOF and hasn't gotten an error.
      */
-    for (i = 0; i < in_file_count; i++) {
+    while (mh->refill_count > 0) {
         int64_t data_offset;
 
-        if (in_files[i].state == RECORD_NOT_PRESENT) {
-            /*
-             * No packet available, and we haven't seen an error or EOF yet,
-             * so try to read the next packet.
-             */
-            if (!wtap_read(in_files[i].wth, &in_files[i].rec, err, err_info,
-                           &data_offset)) {
-                if (*err != 0) {
-                    in_files[i].state = GOT_ERROR;
-                    return &in_files[i];
-                }
-                in_files[i].state = AT_EOF;
-            } else
-                in_files[i].state = RECORD_PRESENT;
-        }
-
-        if (in_files[i].state == RECORD_PRESENT) {
-            rec = &in_files[i].rec;
-            if (!(rec->presence_flags & WTAP_HAS_TS)) {
-                /*
-                 * No time stamp.  Pick this record, and stop looking.
-                 */
-                ei = i;
-                break;
-            }
-            if (is_earlier(&rec->ts, &tv)) {
-                /*
-                 * This record's time stamp is earlier than any of the
-                 * records we've seen so far.  Pick it, for now, but
-                 * keep looking.
-                 */
-                tv = rec->ts;
-                ei = i;
+        i = mh->refill[--mh->refill_count];
+        in_file = &mh->in_files[i];
+        if (!wtap_read(in_file->wth, &in_file->rec, err, err_info,
+                       &data_offset)) {
+            if (*err != 0) {
+                in_file->state = GOT_ERROR;
+                return in_file;
             }
+            in_file->state = AT_EOF;
+        } else {
+            in_file->state = RECORD_PRESENT;
+            merge_heap_push(mh, i);
         }
     }
 
-    if (ei == -1) {
+    if (mh->heap_count == 0) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
     }
 
-    /* We'll need to read another packet from this file. */
-    in_files[ei].state = RECORD_NOT_PRESENT;
+    /* Pick the earliest record; we'll need to read another from its file. */
+    i = merge_heap_pop(mh);
+    in_file = &mh->in_files[i];
+    in_file->state = RECORD_NOT_PRESENT;
+    mh->refill[mh->refill_count++] = i;
 
     /* Count this packet. */
-    in_files[ei].packet_num++;
+    in_file->packet_num++;
 
     /*
      * Return a pointer to the merge_in_file_t of the file from which the
      * packet was read.
      */
     *err = 0;
-    return &in_files[ei];
+    return in_file;
 }
 
 /** Read the next packet, in file sequence order, from the set of files
@@ -1041,9 +1106,12 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
 {
     merge_result        status = MERGE_OK;
     merge_in_file_t    *in_file;
+    merge_heap_t        mh;
     int                 count = 0;
     bool                stop_flag = false;
 
+    merge_heap_init(&mh, in_files, in_file_count);
+
     for (;;) {
         *err = 0;
 
@@ -1052,8 +1120,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
                                                err_info);
         }
         else {
-            in_file = merge_read_packet(in_file_count, in_files, err,
-                                        err_info);
+            in_file = merge_read_packet(&mh, err, err_info);
         }
 
         if (in_file == NULL) {
@@ -1159,6 +1226,8 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
         wtap_rec_reset(&in_file->rec);
     }
 
+    merge_heap_free(&mh);
+
     if (cb)
         cb->callback_func(MERGE_EVENT_DONE, count, in_files, in_file_count, cb->data);
 
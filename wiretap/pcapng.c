@@ -5067,6 +5067,18 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
     const union wtap_pseudo_header *pseudo_header = &rec->rec_header.packet_header.pseudo_header;
     uint32_t block_content_length;
     pcapng_enhanced_packet_block_t epb;
+    /*
+     * The block header and the fixed part of the EPB are written
+     * together, as are the padding and the block footer when there
+     * are no options, to keep the number of separate writes per
+     * packet down; this is the path every captured packet takes.
+     */
+    struct {
+        pcapng_block_header_t bh;
+        pcapng_enhanced_packet_block_t epb;
+    } hdr;
+    uint8_t trailer[3 + sizeof(uint32_t)];
+    uint32_t block_total_length;
     uint32_t options_size = 0;
     uint64_t ts;
     uint32_t pad_len;
@@ -5152,13 +5164,14 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
         return false;
     }
 
-    /* write (enhanced) packet block header */
+    /* fill in (enhanced) packet block header */
     block_content_length = (uint32_t)sizeof(epb) + phdr_len + rec->rec_header.packet_header.caplen + pad_len + options_size;
-    if (!pcapng_write_block_header(wdh, BLOCK_TYPE_EPB, block_content_length,
-                                   err))
-        return false;
+    block_total_length = (uint32_t)sizeof(pcapng_block_header_t) + block_content_length + 4;
+    hdr.bh.block_type = BLOCK_TYPE_EPB;
+    hdr.bh.block_total_length = block_total_length;
+    ws_debug("Total len %u", block_total_length);
 
-    /* write block fixed content */
+    /* fill in block fixed content */
     /* Calculate the time stamp as a 64-bit integer. */
     /* TODO - This can't overflow currently because we don't allow greater
      * than nanosecond resolution, but if and when we do, we need to check for
@@ -5175,7 +5188,9 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
     epb.captured_len        = rec->rec_header.packet_header.caplen + phdr_len;
     epb.packet_len          = rec->rec_header.packet_header.len + phdr_len;
 
-    if (!wtap_dump_file_write(wdh, &epb, sizeof epb, err))
+    /* write block header and fixed content */
+    hdr.epb = epb;
+    if (!wtap_dump_file_write(wdh, &hdr, sizeof hdr, err))
         return false;
 
     /* write pseudo header */
@@ -5187,17 +5202,22 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
     if (!wtap_dump_file_write(wdh, ws_buffer_start_ptr(&rec->data), rec->rec_header.packet_header.caplen, err))
         return false;
 
+    if (options_size == 0) {
+        /* write padding (if any) and block footer */
+        memset(trailer, 0, pad_len);
+        memcpy(&trailer[pad_len], &block_total_length, sizeof block_total_length);
+        return wtap_dump_file_write(wdh, trailer, pad_len + sizeof block_total_length, err);
+    }
+
     /* write padding (if any) */
     if (!pcapng_write_padding(wdh, pad_len, err))
         return false;
 
-    /* Write options, if we have any */
-    if (options_size != 0) {
-        if (!pcapng_write_options(wdh, OPT_SECTION_BYTE_ORDER,
-                                  rec->block, write_wtap_epb_option,
-                                  err, err_info))
-            return false;
-    }
+    /* Write options */
+    if (!pcapng_write_options(wdh, OPT_SECTION_BYTE_ORDER,
+                              rec->block, write_wtap_epb_option,
+                              err, err_info))
+        return false;
 
     /* write block footer */
     return pcapng_write_block_footer(wdh, block_content_length, err);
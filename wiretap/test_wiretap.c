@@ -0,0 +1,165 @@
+/* test_wiretap.c
+ * Wiretap unit tests
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include <wsutil/file_util.h>
+#include <wsutil/wslog.h>
+
+#include "wtap.h"
+#include "libpcap.h"
+
+#define PROGNAME "test_wiretap"
+
+#define TAIL_RECORD_LEN 60
+
+/* Append a pcap record whose data is filled with its number. */
+static void
+tail_append(FILE *fh, unsigned num, size_t from, size_t to)
+{
+    struct pcaprec_hdr hdr;
+    uint8_t rec[sizeof hdr + TAIL_RECORD_LEN];
+
+    hdr.ts_sec = num;
+    hdr.ts_usec = 0;
+    hdr.incl_len = TAIL_RECORD_LEN;
+    hdr.orig_len = TAIL_RECORD_LEN;
+    memcpy(rec, &hdr, sizeof hdr);
+    memset(rec + sizeof hdr, (int)num, TAIL_RECORD_LEN);
+    if (to > sizeof rec)
+        to = sizeof rec;
+
+    g_assert_cmpuint(fwrite(rec + from, 1, to - from, fh), ==, to - from);
+    g_assert_cmpint(fflush(fh), ==, 0);
+}
+
+static void
+tail_read(wtap *wth, wtap_rec *rec, unsigned num)
+{
+    int err;
+    char *err_info = NULL;
+    int64_t data_offset;
+    const uint8_t *pd;
+
+    /* As cf_continue_tail() does before each read. */
+    wtap_cleareof(wth);
+    if (!wtap_read(wth, rec, &err, &err_info, &data_offset)) {
+        g_error("record %u: %s (%s)", num, wtap_strerror(err),
+                err_info ? err_info : "no details");
+    }
+    g_assert_cmpuint(rec->rec_header.packet_header.caplen, ==, TAIL_RECORD_LEN);
+    g_assert_cmpint(rec->ts.secs, ==, num);
+    pd = ws_buffer_start_ptr(&rec->data);
+    for (unsigned i = 0; i < TAIL_RECORD_LEN; i++)
+        g_assert_cmpuint(pd[i], ==, num);
+    wtap_rec_reset(rec);
+}
+
+/*
+ * Read a file that's being written to while it's read, as Wireshark
+ * does with the file dumpcap writes during a live capture: records are
+ * appended between reads, some of them only partially at first.
+ */
+static void
+test_read_growing_file(void)
+{
+    struct pcap_hdr file_hdr;
+    uint32_t magic = PCAP_NSEC_MAGIC;
+    char *path = NULL;
+    FILE *fh;
+    int fd;
+    wtap *wth;
+    wtap_rec rec;
+    int err;
+    char *err_info = NULL;
+    int64_t data_offset;
+    const size_t half = sizeof (struct pcaprec_hdr) + TAIL_RECORD_LEN / 2;
+
+    fd = g_file_open_tmp("test_wiretap_XXXXXX.pcap", &path, NULL);
+    g_assert_cmpint(fd, !=, -1);
+    fh = ws_fdopen(fd, "wb");
+    g_assert_nonnull(fh);
+
+    memset(&file_hdr, 0, sizeof file_hdr);
+    file_hdr.version_major = 2;
+    file_hdr.version_minor = 4;
+    file_hdr.snaplen = 65535;
+    file_hdr.network = 1;   /* LINKTYPE_ETHERNET */
+    g_assert_cmpuint(fwrite(&magic, 1, sizeof magic, fh), ==, sizeof magic);
+    g_assert_cmpuint(fwrite(&file_hdr, 1, sizeof file_hdr, fh), ==, sizeof file_hdr);
+    tail_append(fh, 1, 0, SIZE_MAX);
+    tail_append(fh, 2, 0, half);
+
+    wth = wtap_open_offline(path, WTAP_TYPE_AUTO, &err, &err_info, true);
+    g_assert_nonnull(wth);
+    wtap_rec_init(&rec, 1514);
+
+    tail_read(wth, &rec, 1);
+
+    /* The rest of record 2, which had been read only in part, and more. */
+    tail_append(fh, 2, half, SIZE_MAX);
+    tail_append(fh, 3, 0, SIZE_MAX);
+    tail_read(wth, &rec, 2);
+    tail_read(wth, &rec, 3);
+
+    /* Nothing more yet. */
+    wtap_cleareof(wth);
+    g_assert_false(wtap_read(wth, &rec, &err, &err_info, &data_offset));
+    g_assert_cmpint(err, ==, 0);
+
+    /* A record appended after the end of the file was seen. */
+    tail_append(fh, 4, 0, SIZE_MAX);
+    tail_read(wth, &rec, 4);
+
+    wtap_rec_cleanup(&rec);
+    wtap_close(wth);
+    fclose(fh);
+    ws_unlink(path);
+    g_free(path);
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    /* Set the program name. */
+    g_set_prgname(PROGNAME);
+
+    ws_log_init(NULL);
+
+    g_test_init(&argc, &argv, NULL);
+
+    wtap_init(false);
+
+    g_test_add_func("/file_wrappers/read_growing_file", test_read_growing_file);
+
+    ret = g_test_run();
+
+    wtap_cleanup();
+
+    return ret;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -109,6 +109,7 @@ typedef bool (*subtype_finish_func)(struct wtap_dumper*, int*, char**);
 
 struct wtap_dumper {
     WFILE_T                 fh;
+    char                   *io_buffer;       /* stdio buffer for uncompressed output, or NULL */
     int                     file_type_subtype;
     int                     snaplen;
     int                     file_encap;      /* per-file, for those
@@ -10,6 +10,8 @@
  */
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
 
 #ifdef HAVE_XXHASH
@@ -25,6 +27,12 @@
 #include "wsutil/ws_assert.h"
 #include "wsutil/bits_ctz.h"
 
+/* SSE2 is part of the x86-64 baseline, so it needs no run-time check. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WMEM_MAP_USE_SSE2
+#endif
+
 static uint32_t x; /* Used for universal integer hashing (see the HASH macro) */
 
 /* Used for the wmem_strong_hash() function */
@@ -57,6 +65,13 @@ typedef struct _wmem_map_item_t {
     uint32_t hash;
 } wmem_map_item_t;
 
+/* A slot of an open addressing ("flat") map; see wmem_map_new_flat(). */
+typedef struct _wmem_map_slot_t {
+    const void *key;
+    void *value;
+    uint32_t hash;
+} wmem_map_slot_t;
+
 struct _wmem_map_t {
     /* Number of items stored. */
     size_t count;
@@ -85,6 +100,14 @@ struct _wmem_map_t {
      */
     wmem_stack_t *deleted_items;
 
+    /* Open addressing maps use these instead of the table, items and
+     * deleted_items above: a control byte per slot, then the slots, and
+     * the number of slots holding a tombstone. */
+    bool flat;
+    uint8_t *ctrl;
+    wmem_map_slot_t *slots;
+    size_t tombstones;
+
     GHashFunc  hash_func;
     GEqualFunc eql_func;
 
@@ -153,6 +176,10 @@ wmem_map_new(wmem_allocator_t *allocator,
     map->items = NULL;
     map->next_item = NULL;
     map->deleted_items = wmem_stack_new(allocator);
+    map->flat = false;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->tombstones = 0;
 
     // The first callback ID wmem_register_callback assigns is 1, so
     // 0 means unused.
@@ -172,6 +199,9 @@ wmem_map_reset_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event,
     map->table = NULL;
     map->items = NULL;
     map->next_item = NULL;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->tombstones = 0;
     while (wmem_stack_count(map->deleted_items))
         wmem_stack_pop(map->deleted_items);
 
@@ -202,6 +232,10 @@ wmem_map_new_autoreset(wmem_allocator_t *metadata_scope, wmem_allocator_t *data_
     map->items = NULL;
     map->next_item = NULL;
     map->deleted_items = wmem_stack_new(metadata_scope);
+    map->flat = false;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->tombstones = 0;
 
     map->metadata_scope_cb_id = wmem_register_callback(metadata_scope, wmem_map_destroy_cb, map);
     map->data_scope_cb_id  = wmem_register_callback(data_scope, wmem_map_reset_cb, map);
@@ -263,6 +297,268 @@ wmem_map_grow(wmem_map_t *map, unsigned new_capacity)
     wmem_free(map->data_allocator, old_table);
 }
 
+wmem_map_t *
+wmem_map_new_flat(wmem_allocator_t *allocator,
+        GHashFunc hash_func, GEqualFunc eql_func)
+{
+    wmem_map_t *map = wmem_map_new(allocator, hash_func, eql_func);
+
+    map->flat = true;
+
+    return map;
+}
+
+wmem_map_t *
+wmem_map_new_flat_autoreset(wmem_allocator_t *metadata_scope, wmem_allocator_t *data_scope,
+        GHashFunc hash_func, GEqualFunc eql_func)
+{
+    wmem_map_t *map = wmem_map_new_autoreset(metadata_scope, data_scope, hash_func, eql_func);
+
+    map->flat = true;
+
+    return map;
+}
+
+/*
+ * Open addressing maps, laid out in the manner of Swiss tables: the slots
+ * are split into groups of 16, and each slot has a control byte saying
+ * whether it is empty, holds a tombstone left by a removal, or is full, in
+ * which case the byte holds 7 bits of the key's hash. A lookup compares
+ * the control bytes of a whole group against those 7 bits at once (with
+ * SSE2 where available), and only calls the equality function for the
+ * slots that match, so that most probes touch one cache line of control
+ * bytes and no pointers. Groups are probed in triangular order, which
+ * visits every group because their number is a power of two, and a
+ * lookup stops at the first group with an empty slot.
+ */
+#define FLAT_GROUP_WIDTH    16
+#define FLAT_CTRL_EMPTY     ((uint8_t)0x80)
+#define FLAT_CTRL_DELETED   ((uint8_t)0xFE)
+
+/* Maximum load, counting tombstones, before the table is rebuilt: 7/8. */
+#define FLAT_MAX_LOAD(CAP)  ((CAP) - (CAP) / 8)
+
+/* The 7 bits of the hash kept in the control byte. They are taken after
+ * further mixing, as the low bits of the multiplicative hash are weak and
+ * its high bits already choose the group. */
+static inline uint8_t
+flat_h2(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    return (uint8_t)(hash & 0x7f);
+}
+
+static inline size_t
+flat_first_group(const wmem_map_t *map, uint32_t hash)
+{
+    unsigned group_bits = map->capacity - 4; /* FLAT_GROUP_WIDTH is 2^4 */
+
+    return group_bits ? (size_t)(hash >> (32 - group_bits)) : 0;
+}
+
+/* Returns a bit mask of the slots in the group whose control byte is h2. */
+static inline uint32_t
+flat_group_match(const uint8_t *group, uint8_t h2)
+{
+#ifdef WMEM_MAP_USE_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h2)));
+#else
+    uint32_t mask = 0;
+    unsigned i;
+
+    for (i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        if (group[i] == h2)
+            mask |= 1U << i;
+    }
+    return mask;
+#endif
+}
+
+/* Returns a bit mask of the slots in the group that are empty or hold a
+ * tombstone, i.e. whose control byte has the top bit set. */
+static inline uint32_t
+flat_group_match_free(const uint8_t *group)
+{
+#ifdef WMEM_MAP_USE_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t mask = 0;
+    unsigned i;
+
+    for (i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        if (group[i] & 0x80)
+            mask |= 1U << i;
+    }
+    return mask;
+#endif
+}
+
+static inline uint32_t
+flat_group_match_empty(const uint8_t *group)
+{
+    return flat_group_match(group, FLAT_CTRL_EMPTY);
+}
+
+static void
+wmem_map_flat_alloc(wmem_map_t *map, unsigned capacity)
+{
+    map->capacity   = capacity;
+    map->ctrl       = (uint8_t *)wmem_alloc(map->data_allocator, CAPACITY(map));
+    memset(map->ctrl, FLAT_CTRL_EMPTY, CAPACITY(map));
+    /* We do *not* need to 0 the slots, unlike the control bytes. */
+    map->slots      = wmem_alloc_array(map->data_allocator, wmem_map_slot_t, CAPACITY(map));
+    map->tombstones = 0;
+}
+
+/* Returns the index of the slot holding key, or -1 if there is none. */
+static inline ptrdiff_t
+wmem_map_flat_find(const wmem_map_t *map, const void *key, uint32_t hash)
+{
+    size_t   group_mask = (CAPACITY(map) / FLAT_GROUP_WIDTH) - 1;
+    size_t   group = flat_first_group(map, hash);
+    size_t   step = 0, slot;
+    uint8_t  h2 = flat_h2(hash);
+    uint32_t mask;
+
+    for (;;) {
+        const uint8_t *ctrl = &map->ctrl[group * FLAT_GROUP_WIDTH];
+
+        for (mask = flat_group_match(ctrl, h2); mask; mask &= mask - 1) {
+            slot = group * FLAT_GROUP_WIDTH + ws_ctz(mask);
+            if (map->slots[slot].hash == hash && map->eql_func(key, map->slots[slot].key)) {
+                return (ptrdiff_t)slot;
+            }
+        }
+        if (flat_group_match_empty(ctrl)) {
+            return -1;
+        }
+        step++;
+        if (step > group_mask) {
+            /* Every group has been probed; only possible when the
+             * table holds no empty slots at all. */
+            return -1;
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+/* Returns the index of the first empty or deleted slot on key's probe
+ * sequence; there must be one. */
+static inline size_t
+wmem_map_flat_find_free(const wmem_map_t *map, uint32_t hash)
+{
+    size_t   group_mask = (CAPACITY(map) / FLAT_GROUP_WIDTH) - 1;
+    size_t   group = flat_first_group(map, hash);
+    size_t   step = 0;
+    uint32_t mask;
+
+    for (;;) {
+        mask = flat_group_match_free(&map->ctrl[group * FLAT_GROUP_WIDTH]);
+        if (mask) {
+            return group * FLAT_GROUP_WIDTH + ws_ctz(mask);
+        }
+        step++;
+        ws_assert(step <= group_mask);
+        group = (group + step) & group_mask;
+    }
+}
+
+/* Rebuilds the table with 2^new_capacity slots, dropping tombstones. */
+static void
+wmem_map_flat_rehash(wmem_map_t *map, unsigned new_capacity)
+{
+    uint8_t         *old_ctrl  = map->ctrl;
+    wmem_map_slot_t *old_slots = map->slots;
+    size_t           old_cap   = CAPACITY(map);
+    size_t           i, slot;
+
+    if (new_capacity > 32) {
+        // Run time error
+        ws_error("wmem_map does not support more than 2^32 items");
+        return;
+    }
+
+    wmem_map_flat_alloc(map, new_capacity);
+
+    for (i = 0; i < old_cap; i++) {
+        if (old_ctrl[i] & 0x80)
+            continue;
+        slot = wmem_map_flat_find_free(map, old_slots[i].hash);
+        map->ctrl[slot]  = old_ctrl[i];
+        map->slots[slot] = old_slots[i];
+    }
+
+    wmem_free(map->data_allocator, old_ctrl);
+    wmem_free(map->data_allocator, old_slots);
+}
+
+static void *
+wmem_map_flat_insert(wmem_map_t *map, const void *key, void *value)
+{
+    ptrdiff_t found;
+    size_t    slot;
+    void     *old_val;
+
+    /* Make sure we have a table */
+    if (map->ctrl == NULL) {
+        map->count = 0;
+        wmem_map_flat_alloc(map, MAX(map->min_capacity, 4));
+    }
+
+    uint32_t hash = HASH(map, key);
+    found = wmem_map_flat_find(map, key, hash);
+    if (found >= 0) {
+        /* replace and return old value for this key */
+        old_val = map->slots[found].value;
+        map->slots[found].value = value;
+        return old_val;
+    }
+
+    /* make room if we are (about to be) over-full */
+    if (map->count + map->tombstones + 1 > FLAT_MAX_LOAD(CAPACITY(map))) {
+        /* If most of the load is tombstones, rebuilding at the same size
+         * is enough. */
+        if (map->count + 1 <= FLAT_MAX_LOAD(CAPACITY(map)) / 2) {
+            wmem_map_flat_rehash(map, map->capacity);
+        } else {
+            wmem_map_flat_rehash(map, map->capacity + 1);
+        }
+    }
+
+    slot = wmem_map_flat_find_free(map, hash);
+    if (map->ctrl[slot] == FLAT_CTRL_DELETED) {
+        map->tombstones--;
+    }
+    map->ctrl[slot] = flat_h2(hash);
+    map->slots[slot].key   = key;
+    map->slots[slot].value = value;
+    map->slots[slot].hash  = hash;
+    map->count++;
+
+    /* no previous entry, return NULL */
+    return NULL;
+}
+
+static void
+wmem_map_flat_erase(wmem_map_t *map, size_t slot)
+{
+    const uint8_t *group = &map->ctrl[slot - slot % FLAT_GROUP_WIDTH];
+
+    /* A lookup never probes past a group with an empty slot, so if this
+     * group has one already, the slot can simply be emptied too. */
+    if (flat_group_match_empty(group)) {
+        map->ctrl[slot] = FLAT_CTRL_EMPTY;
+    } else {
+        map->ctrl[slot] = FLAT_CTRL_DELETED;
+        map->tombstones++;
+    }
+    map->count--;
+}
+
 void
 wmem_map_destroy(wmem_map_t *map, bool free_keys _U_, bool free_values _U_)
 {
@@ -283,6 +579,8 @@ wmem_map_destroy(wmem_map_t *map, bool free_keys _U_, bool free_values _U_)
         wmem_unregister_callback(map->data_allocator, map->data_scope_cb_id);
     }
     wmem_free(map->data_allocator, map->table);
+    wmem_free(map->data_allocator, map->ctrl);
+    wmem_free(map->data_allocator, map->slots);
     // The arrays of items created before the last time the map grew the map
     // are orphaned and get freed when the data_allocator does.
     wmem_free(map->data_allocator, map->items);
@@ -295,6 +593,10 @@ wmem_map_insert(wmem_map_t *map, const void *key, void *value)
     wmem_map_item_t **item;
     void *old_val;
 
+    if (map->flat) {
+        return wmem_map_flat_insert(map, key, value);
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         wmem_map_init_table(map);
@@ -344,6 +646,10 @@ wmem_map_contains(const wmem_map_t *map, const void *key)
 {
     wmem_map_item_t *item;
 
+    if (map != NULL && map->flat) {
+        return map->ctrl != NULL && wmem_map_flat_find(map, key, HASH(map, key)) >= 0;
+    }
+
     /* Make sure we have map and a table */
     if (map == NULL || map->table == NULL) {
         return false;
@@ -369,6 +675,16 @@ wmem_map_lookup(const wmem_map_t *map, const void *key)
 {
     wmem_map_item_t *item;
 
+    if (map != NULL && map->flat) {
+        ptrdiff_t slot;
+
+        if (map->ctrl == NULL) {
+            return NULL;
+        }
+        slot = wmem_map_flat_find(map, key, HASH(map, key));
+        return slot >= 0 ? map->slots[slot].value : NULL;
+    }
+
     /* Make sure we have map and a table */
     if (map == NULL || map->table == NULL) {
         return NULL;
@@ -394,6 +710,25 @@ wmem_map_lookup_extended(const wmem_map_t *map, const void *key, const void **or
 {
     wmem_map_item_t *item;
 
+    if (map != NULL && map->flat) {
+        ptrdiff_t slot;
+
+        if (map->ctrl == NULL) {
+            return false;
+        }
+        slot = wmem_map_flat_find(map, key, HASH(map, key));
+        if (slot < 0) {
+            return false;
+        }
+        if (orig_key) {
+            *orig_key = map->slots[slot].key;
+        }
+        if (value) {
+            *value = map->slots[slot].value;
+        }
+        return true;
+    }
+
     /* Make sure we have map and a table */
     if (map == NULL || map->table == NULL) {
         return false;
@@ -426,6 +761,21 @@ wmem_map_remove(wmem_map_t *map, const void *key)
     wmem_map_item_t **item, *tmp;
     void *value;
 
+    if (map != NULL && map->flat) {
+        ptrdiff_t slot;
+
+        if (map->ctrl == NULL) {
+            return NULL;
+        }
+        slot = wmem_map_flat_find(map, key, HASH(map, key));
+        if (slot < 0) {
+            return NULL;
+        }
+        value = map->slots[slot].value;
+        wmem_map_flat_erase(map, slot);
+        return value;
+    }
+
     /* Make sure we have map and a table */
     if (map == NULL || map->table == NULL) {
         return NULL;
@@ -458,6 +808,20 @@ wmem_map_steal(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t **item, *tmp;
 
+    if (map != NULL && map->flat) {
+        ptrdiff_t slot;
+
+        if (map->ctrl == NULL) {
+            return false;
+        }
+        slot = wmem_map_flat_find(map, key, HASH(map, key));
+        if (slot < 0) {
+            return false;
+        }
+        wmem_map_flat_erase(map, slot);
+        return true;
+    }
+
     /* Make sure we have map and a table */
     if (map == NULL || map->table == NULL) {
         return false;
@@ -491,6 +855,17 @@ wmem_map_get_keys(wmem_allocator_t *list_allocator, const wmem_map_t *map)
     wmem_map_item_t *cur;
     wmem_list_t* list = wmem_list_new(list_allocator);
 
+    if (map->flat) {
+        if (map->ctrl != NULL) {
+            capacity = CAPACITY(map);
+            for (i=0; i<capacity; i++) {
+                if (!(map->ctrl[i] & 0x80))
+                    wmem_list_prepend(list, (void*)map->slots[i].key);
+            }
+        }
+        return list;
+    }
+
     if (map->table != NULL) {
         capacity = CAPACITY(map);
 
@@ -513,6 +888,17 @@ wmem_map_foreach(const wmem_map_t *map, GHFunc foreach_func, void * user_data)
     wmem_map_item_t *cur;
     unsigned i;
 
+    if (map != NULL && map->flat) {
+        if (map->ctrl == NULL) {
+            return;
+        }
+        for (i = 0; i < CAPACITY(map); i++) {
+            if (!(map->ctrl[i] & 0x80))
+                foreach_func((void *)map->slots[i].key, map->slots[i].value, user_data);
+        }
+        return;
+    }
+
     /* Make sure we have a table */
     if (map == NULL || map->table == NULL) {
         return;
@@ -533,6 +919,19 @@ wmem_map_find(const wmem_map_t *map, GHRFunc foreach_func, void * user_data)
     wmem_map_item_t **item;
     unsigned i;
 
+    if (map != NULL && map->flat) {
+        if (map->ctrl == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < CAPACITY(map); i++) {
+            if (!(map->ctrl[i] & 0x80) &&
+                    foreach_func((void *)map->slots[i].key, map->slots[i].value, user_data)) {
+                return map->slots[i].value;
+            }
+        }
+        return NULL;
+    }
+
     /* Make sure we have a table */
     if (map == NULL || map->table == NULL) {
         return 0;
@@ -557,6 +956,20 @@ wmem_map_foreach_remove(wmem_map_t *map, GHRFunc foreach_func, void * user_data)
     wmem_map_item_t **item, *tmp;
     unsigned i, deleted = 0;
 
+    if (map != NULL && map->flat) {
+        if (map->ctrl == NULL) {
+            return 0;
+        }
+        for (i = 0; i < CAPACITY(map); i++) {
+            if (!(map->ctrl[i] & 0x80) &&
+                    foreach_func((void *)map->slots[i].key, map->slots[i].value, user_data)) {
+                wmem_map_flat_erase(map, i);
+                deleted++;
+            }
+        }
+        return deleted;
+    }
+
     /* Make sure we have a table */
     if (map == NULL || map->table == NULL) {
         return 0;
@@ -595,6 +1008,16 @@ wmem_map_reserve(wmem_map_t *map, uint64_t capacity)
 
     map->min_capacity = MAX(map->min_capacity, WMEM_MAP_DEFAULT_CAPACITY);
 
+    if (map->flat) {
+        map->min_capacity = MIN(map->min_capacity, 32);
+        /* Leave room for the maximum load factor. */
+        if (map->min_capacity < 32 && capacity > FLAT_MAX_LOAD(((uint64_t)1) << map->min_capacity))
+            map->min_capacity++;
+        if (map->ctrl && map->min_capacity > map->capacity)
+            wmem_map_flat_rehash(map, map->min_capacity);
+        return ((size_t)1) << map->min_capacity;
+    }
+
     if (map->table) {
         /* XXX - Should reserving after an item has been inserted be allowed?
          * Either we orphan some items in the old array or have to do a more
@@ -89,6 +89,43 @@ wmem_map_new_autoreset(wmem_allocator_t *metadata_scope, wmem_allocator_t *data_
         GHashFunc hash_func, GEqualFunc eql_func)
 G_GNUC_MALLOC;
 
+/**
+ * @brief Creates an open addressing map with the given allocator scope.
+ *
+ * Behaves exactly like a map created with wmem_map_new(), and is used with
+ * the same functions, but stores its items in a flat array probed with the
+ * help of a byte of hash bits per item, Swiss table style, rather than in
+ * chains of separately allocated items. Lookups touch fewer cache lines
+ * and follow no pointers, which makes this the better choice for large
+ * maps that are looked up far more often than they are modified, such as
+ * per-packet lookup tables. The order in which items are visited by
+ * wmem_map_foreach() and friends differs from that of a chained map.
+ *
+ * @param allocator The allocator scope with which to create the map.
+ * @param hash_func The hash function used to place inserted keys.
+ * @param eql_func  The equality function used to compare inserted keys.
+ * @return The newly-allocated map.
+ */
+WS_DLL_PUBLIC
+wmem_map_t *
+wmem_map_new_flat(wmem_allocator_t *allocator,
+        GHashFunc hash_func, GEqualFunc eql_func)
+G_GNUC_MALLOC;
+
+/**
+ * @brief Creates an open addressing map with two allocator scopes.
+ *
+ * The open addressing equivalent of wmem_map_new_autoreset(); see
+ * wmem_map_new_flat().
+ *
+ * @warning This cannot be used with either allocator scope being NULL.
+ */
+WS_DLL_PUBLIC
+wmem_map_t *
+wmem_map_new_flat_autoreset(wmem_allocator_t *metadata_scope, wmem_allocator_t *data_scope,
+        GHashFunc hash_func, GEqualFunc eql_func)
+G_GNUC_MALLOC;
+
 /**
  * @brief Inserts a value into the map.
  *
@@ -1019,6 +1019,188 @@ wmem_test_map(void)
     wmem_destroy_allocator(allocator);
 }
 
+static void
+wmem_test_map_flat(void)
+{
+    wmem_allocator_t   *allocator, *extra_allocator;
+    wmem_map_t       *map;
+    char             *str_key;
+    const void       *str_key_ret;
+    unsigned int      i, j;
+    unsigned int     *value_ret;
+    void             *ret;
+
+    allocator = wmem_allocator_new(WMEM_ALLOCATOR_STRICT);
+    extra_allocator = wmem_allocator_new(WMEM_ALLOCATOR_STRICT);
+
+    /* insertion, lookup and removal of simple integer keys */
+    map = wmem_map_new_flat(allocator, g_direct_hash, g_direct_equal);
+    g_assert_true(map);
+    g_assert_true(wmem_map_lookup(map, GINT_TO_POINTER(1)) == NULL);
+    g_assert_true(wmem_map_remove(map, GINT_TO_POINTER(1)) == NULL);
+
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        ret = wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(777777));
+        g_assert_true(ret == NULL);
+        ret = wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(i));
+        g_assert_true(ret == GINT_TO_POINTER(777777));
+    }
+    g_assert_true(wmem_map_size(map) == CONTAINER_ITERS);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        ret = wmem_map_lookup(map, GINT_TO_POINTER(i));
+        g_assert_true(ret == GINT_TO_POINTER(i));
+        g_assert_true(wmem_map_contains(map, GINT_TO_POINTER(i)) == true);
+        ret = wmem_map_remove(map, GINT_TO_POINTER(i));
+        g_assert_true(ret == GINT_TO_POINTER(i));
+        g_assert_true(wmem_map_contains(map, GINT_TO_POINTER(i)) == false);
+        ret = wmem_map_remove(map, GINT_TO_POINTER(i));
+        g_assert_true(ret == NULL);
+    }
+    g_assert_true(wmem_map_size(map) == 0);
+
+    /* churn: removals leave tombstones, which must not hide other keys
+     * and must eventually be reclaimed */
+    for (j=0; j<8; j++) {
+        for (i=0; i<CONTAINER_ITERS; i++) {
+            wmem_map_insert(map, GINT_TO_POINTER(j*CONTAINER_ITERS + i), GINT_TO_POINTER(i));
+        }
+        for (i=0; i<CONTAINER_ITERS; i+=2) {
+            g_assert_true(wmem_map_steal(map, GINT_TO_POINTER(j*CONTAINER_ITERS + i)));
+        }
+        for (i=1; i<CONTAINER_ITERS; i+=2) {
+            ret = wmem_map_lookup(map, GINT_TO_POINTER(j*CONTAINER_ITERS + i));
+            g_assert_true(ret == GINT_TO_POINTER(i));
+        }
+        for (i=1; i<CONTAINER_ITERS; i+=2) {
+            g_assert_true(wmem_map_steal(map, GINT_TO_POINTER(j*CONTAINER_ITERS + i)));
+        }
+        g_assert_true(wmem_map_size(map) == 0);
+    }
+    wmem_free_all(allocator);
+
+    /* test auto-reset functionality */
+    map = wmem_map_new_flat_autoreset(allocator, extra_allocator, g_direct_hash, g_direct_equal);
+    g_assert_true(map);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        ret = wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(i));
+        g_assert_true(ret == NULL);
+    }
+    wmem_free_all(extra_allocator);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        g_assert_true(wmem_map_lookup(map, GINT_TO_POINTER(i)) == NULL);
+    }
+    g_assert_true(wmem_map_size(map) == 0);
+    wmem_map_insert(map, GINT_TO_POINTER(1), GINT_TO_POINTER(1));
+    g_assert_true(wmem_map_lookup(map, GINT_TO_POINTER(1)) == GINT_TO_POINTER(1));
+    wmem_free_all(allocator);
+
+    /* string keys */
+    map = wmem_map_new_flat(allocator, wmem_str_hash, g_str_equal);
+    g_assert_true(map);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        str_key = wmem_test_rand_string(allocator, 1, 64);
+        wmem_map_insert(map, str_key, GINT_TO_POINTER(i));
+        str_key_ret = NULL;
+        value_ret = NULL;
+        g_assert_true(wmem_map_lookup_extended(map, str_key, &str_key_ret, GINT_TO_POINTER(&value_ret)) == true);
+        g_assert_true(g_str_equal(str_key_ret, str_key));
+        g_assert_true(value_ret == GINT_TO_POINTER(i));
+    }
+
+    /* test foreach, find and foreach_remove */
+    map = wmem_map_new_flat(allocator, wmem_str_hash, g_str_equal);
+    g_assert_true(map);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        str_key = wmem_test_rand_string(allocator, 1, 64);
+        wmem_map_insert(map, str_key, GINT_TO_POINTER(2));
+    }
+    wmem_map_foreach(map, check_val_map, GINT_TO_POINTER(2));
+    g_assert_true(wmem_map_find(map, equal_val_map, GINT_TO_POINTER(2)) == GINT_TO_POINTER(2));
+    wmem_map_foreach_remove(map, equal_val_map, GINT_TO_POINTER(2));
+    g_assert_true(wmem_map_size(map) == 0);
+
+    /* test reserve, keys and size */
+    map = wmem_map_new_flat(allocator, g_direct_hash, g_direct_equal);
+    g_assert_true(map);
+    g_assert_true(wmem_map_reserve(map, CONTAINER_ITERS) >= CONTAINER_ITERS);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(i));
+    }
+    g_assert_true(wmem_map_size(map) == CONTAINER_ITERS);
+    g_assert_true(wmem_list_count(wmem_map_get_keys(allocator, map)) == CONTAINER_ITERS);
+
+    for (i=0; i<CONTAINER_ITERS; i+=2) {
+        wmem_map_foreach_remove(map, equal_val_map, GINT_TO_POINTER(i));
+    }
+    g_assert_true(wmem_map_size(map) == CONTAINER_ITERS/2);
+
+    wmem_destroy_allocator(extra_allocator);
+    wmem_destroy_allocator(allocator);
+}
+
+static void
+wmem_test_mapperf(void)
+{
+#define MAP_PERF_KEYS (1 * 1000 * 1000)
+#define MAP_PERF_LOOKUPS 10
+    wmem_allocator_t   *allocator;
+    wmem_map_t         *map;
+    uint64_t           *keys = g_new(uint64_t, MAP_PERF_KEYS);
+    unsigned            i, j, found;
+    bool                flat;
+    double              start_utime, start_stime, end_utime, end_stime, utime_ms, stime_ms;
+
+    allocator = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK);
+
+    for (i = 0; i < MAP_PERF_KEYS; i++) {
+        keys[i] = ((uint64_t)g_random_int() << 32) | i;
+    }
+
+    for (j = 0; j < 2; j++) {
+        flat = (j == 1);
+
+        RESOURCE_USAGE_START;
+        if (flat)
+            map = wmem_map_new_flat(allocator, g_int64_hash, g_int64_equal);
+        else
+            map = wmem_map_new(allocator, g_int64_hash, g_int64_equal);
+        for (i = 0; i < MAP_PERF_KEYS; i++) {
+            wmem_map_insert(map, &keys[i], GUINT_TO_POINTER(i + 1));
+        }
+        RESOURCE_USAGE_END;
+        g_test_minimized_result(utime_ms + stime_ms,
+            "%s map insert %u keys: u %.3f ms s %.3f ms",
+            flat ? "flat" : "chained", MAP_PERF_KEYS, utime_ms, stime_ms);
+
+        found = 0;
+        RESOURCE_USAGE_START;
+        for (i = 0; i < MAP_PERF_KEYS * MAP_PERF_LOOKUPS; i++) {
+            if (wmem_map_lookup(map, &keys[(i * 7919U) % MAP_PERF_KEYS]))
+                found++;
+        }
+        RESOURCE_USAGE_END;
+        g_test_minimized_result(utime_ms + stime_ms,
+            "%s map lookup hit: u %.3f ms s %.3f ms",
+            flat ? "flat" : "chained", utime_ms, stime_ms);
+        g_assert_true(found == MAP_PERF_KEYS * MAP_PERF_LOOKUPS);
+
+        RESOURCE_USAGE_START;
+        for (i = 0; i < MAP_PERF_KEYS * MAP_PERF_LOOKUPS; i++) {
+            uint64_t missing = keys[i % MAP_PERF_KEYS] ^ ((uint64_t)1 << 63);
+            wmem_map_contains(map, &missing);
+        }
+        RESOURCE_USAGE_END;
+        g_test_minimized_result(utime_ms + stime_ms,
+            "%s map lookup miss: u %.3f ms s %.3f ms",
+            flat ? "flat" : "chained", utime_ms, stime_ms);
+
+        wmem_free_all(allocator);
+    }
+
+    wmem_destroy_allocator(allocator);
+    g_free(keys);
+}
+
 static void
 wmem_test_queue(void)
 {
@@ -1481,6 +1663,10 @@ main(int argc, char **argv)
     g_test_add_func("/wmem/datastruct/array",  wmem_test_array);
     g_test_add_func("/wmem/datastruct/list",   wmem_test_list);
     g_test_add_func("/wmem/datastruct/map",    wmem_test_map);
+    g_test_add_func("/wmem/datastruct/map/flat", wmem_test_map_flat);
+    if (g_test_perf()) {
+        g_test_add_func("/wmem/datastruct/mapperf", wmem_test_mapperf);
+    }
     g_test_add_func("/wmem/datastruct/queue",  wmem_test_queue);
     g_test_add_func("/wmem/datastruct/stack",  wmem_test_stack);
     g_test_add_func("/wmem/datastruct/strbuf", wmem_test_strbuf);